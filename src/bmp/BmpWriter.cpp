@@ -1,26 +1,39 @@
 #include "BmpWriter.hpp"
+#include "memory/BufferPool.hpp"
 
-#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
-#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
 
 std::optional<BmpWriterError> BmpWriter::Save(const char* path) const {
     if (color_table_size_ < 2) {
         return BmpWriterError{"Unable to create a bmp file: color table size must be at least 2"};
     }
 
-    std::ofstream file{path, std::ios::binary};
+    int file = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
 
-    if (file.fail()) {
+    if (file == -1) {
         return BmpWriterError{"Unable to open the output file"};
     }
 
+    // the layout is known beforehand: header, color table, then rows of a fixed size
+    uint64_t pixel_data_offset = kHeadersByteSize + GetColorTableByteSize();
+    uint64_t file_byte_size = pixel_data_offset + static_cast<uint64_t>(GetRowByteSize()) * height_;
+
+    if (ftruncate(file, file_byte_size) != 0) {
+        close(file);
+        return BmpWriterError{"Unable to write to the output file"};
+    }
+
     BitmapHeader header;
     header.bf_type = 0x4D42; // Magic constant indicating the file format
     header.bf_size = GetFileSize();
     header.bf_reserved1 = 0;
     header.bf_reserved2 = 0;
-    header.bf_off_bits = GetColorTableByteSize() + 54; // 54 == 14 (BITMAPFILEHEADER) + 40 (BITMAPINFO)
+    header.bf_off_bits = pixel_data_offset;
 
     header.bi_size = 40;
     header.bi_width = width_;
@@ -34,74 +47,168 @@ std::optional<BmpWriterError> BmpWriter::Save(const char* path) const {
     header.bi_clr_used = color_table_size_;
     header.bi_clr_important = 0;
 
-    WriteHeader(file, header);
+    char* header_data = BufferPool::GetInstance().Allocate<char>(pixel_data_offset);
+    char* current_byte = header_data;
+
+    WriteHeader(current_byte, header);
 
     for (size_t i = 0; i < color_table_size_; ++i) {
-        file << color_table_[i].blue << color_table_[i].green 
-            << color_table_[i].red << uint8_t{0};
+        *current_byte++ = color_table_[i].blue;
+        *current_byte++ = color_table_[i].green;
+        *current_byte++ = color_table_[i].red;
+        *current_byte++ = 0;
+    }
+
+    bool is_written = WriteAt(file, header_data, pixel_data_offset, 0);
+    BufferPool::GetInstance().Release(header_data);
+
+    is_written = is_written && WritePixelData(file, pixel_data_offset);
+
+    if (close(file) != 0 || !is_written) {
+        return BmpWriterError{"Unable to write to the output file"};
+    }
+
+    return std::nullopt;
+}
+
+bool BmpWriter::WritePixelData(int file, uint64_t pixel_data_offset) const {
+    // an empty image has only the header and the color table
+    if (width_ == 0 || height_ == 0) {
+        return true;
+    }
+
+    uint32_t row_byte_size = GetRowByteSize();
+    uint32_t rows_per_block = std::max<uint32_t>(1, kBlockByteSize / row_byte_size);
+
+    // near the memory limit blocks get smaller, a half of the memory left is kept, since buffers are rounded up
+    uint64_t available_byte_size = BufferPool::GetInstance().GetAvailableByteSize();
+    rows_per_block = std::min<uint64_t>({rows_per_block, height_, std::max<uint64_t>(1, available_byte_size / 2 / row_byte_size)});
+    uint64_t blocks_count = (height_ + rows_per_block - 1) / rows_per_block;
+
+    uint64_t block_byte_size = static_cast<uint64_t>(rows_per_block) * row_byte_size;
+    uint64_t affordable_blocks_count = std::max<uint64_t>(1, available_byte_size / BufferPool::GetCapacityFor(block_byte_size));
+
+    uint64_t threads_count = std::max(1u, std::thread::hardware_concurrency());
+    threads_count = std::min({threads_count, blocks_count, affordable_blocks_count});
+
+    // the row source is called by a single thread
+    if (get_row_ != nullptr) {
+        threads_count = 1;
     }
 
-    char* current_row = new char[GetRowByteSize()];
-    uint64_t current_bit_in_row = 0;
-    
-    for (size_t y = 0; y < height_; ++y) {
-        std::fill(current_row, current_row + GetRowByteSize(), 0);
+    std::atomic<uint64_t> next_block{0};
+    std::atomic<bool> is_failed{false};
+
+    // blocks of rows are independent, so each of them is encoded and written right to its place in the file
+    auto write_blocks = [&]() {
+        char* block_data = BufferPool::GetInstance().Allocate<char>(block_byte_size);
+        uint8_t* row_indeces = (pixel_table_indeces_ == nullptr) ? BufferPool::GetInstance().Allocate<uint8_t>(width_) : nullptr;
+
+        for (uint64_t block = next_block++; block < blocks_count && !is_failed; block = next_block++) {
+            uint32_t first_row = block * rows_per_block;
+            uint32_t rows_count = std::min(rows_per_block, height_ - first_row);
 
-        for (size_t x = 0; x < width_; ++x) {
-            uint32_t color_table_index = pixel_table_indeces_[y * width_ + x];
-            
-            for (int32_t shift = GetBitCount() - 1; shift >= 0; --shift) {
-                uint64_t current_byte_in_row = current_bit_in_row / 8;
-                uint8_t current_color_index_bit = (color_table_index >> shift) & 1;
+            for (uint32_t i = 0; i < rows_count; ++i) {
+                EncodeRow(GetRowIndeces(first_row + i, row_indeces), block_data + static_cast<uint64_t>(i) * row_byte_size);
+            }
+
+            uint64_t offset = pixel_data_offset + static_cast<uint64_t>(first_row) * row_byte_size;
 
-                current_row[current_byte_in_row] |= current_color_index_bit << (7 - current_bit_in_row % 8);
-                ++current_bit_in_row;
+            if (!WriteAt(file, block_data, static_cast<uint64_t>(rows_count) * row_byte_size, offset)) {
+                is_failed = true;
             }
         }
 
-        current_bit_in_row = 0;
-        file.write(current_row, GetRowByteSize());
+        BufferPool::GetInstance().Release(block_data);
+        BufferPool::GetInstance().Release(row_indeces);
+    };
+
+    std::thread* workers = new std::thread[threads_count - 1];
+
+    for (uint64_t i = 0; i + 1 < threads_count; ++i) {
+        workers[i] = std::thread{write_blocks};
     }
 
-    delete[] current_row;
-    return std::nullopt;
+    write_blocks();
+
+    for (uint64_t i = 0; i + 1 < threads_count; ++i) {
+        workers[i].join();
+    }
+
+    delete[] workers;
+    return !is_failed;
+}
+
+const uint8_t* BmpWriter::GetRowIndeces(uint32_t y, uint8_t* buffer) const {
+    if (get_row_ != nullptr) {
+        get_row_(get_row_context_, y, buffer);
+        return buffer;
+    } else if (pixel_table_indeces_ == nullptr) {
+        // no pixels are set
+        std::fill(buffer, buffer + width_, 0);
+        return buffer;
+    }
+
+    return pixel_table_indeces_ + static_cast<uint64_t>(y) * width_;
+}
+
+void BmpWriter::EncodeRow(const uint8_t* indeces, char* row) const {
+    uint16_t bit_count = GetBitCount();
+
+    std::fill(row, row + GetRowByteSize(), 0);
+
+    // pixels are packed starting from the most significant bits of each byte
+    for (uint32_t x = 0; x < width_; ++x) {
+        uint64_t bit_in_row = static_cast<uint64_t>(x) * bit_count;
+        row[bit_in_row / 8] |= indeces[x] << (8 - bit_count - bit_in_row % 8);
+    }
 }
 
-void BmpWriter::WriteBytes(std::ofstream& file, uint32_t bytes) const {
-    char byte_data[sizeof(bytes)];
-    byte_data[0] = bytes & 0xff;
-    byte_data[1] = (bytes >> 8) & 0xff;
-    byte_data[2] = (bytes >> 16) & 0xff;
-    byte_data[3] = (bytes >> 24) & 0xff;
+bool BmpWriter::WriteAt(int file, const char* data, uint64_t size, uint64_t offset) const {
+    while (size != 0) {
+        ssize_t written = pwrite(file, data, size, offset);
+
+        if (written <= 0) {
+            return false;
+        }
+
+        data += written;
+        size -= written;
+        offset += written;
+    }
 
-    file.write(byte_data, sizeof(bytes));
+    return true;
 }
 
-void BmpWriter::WriteBytes(std::ofstream& file, uint16_t bytes) const {
-    char byte_data[sizeof(bytes)];
-    byte_data[0] = bytes & 0xff;
-    byte_data[1] = (bytes >> 8) & 0xff;
+void BmpWriter::WriteBytes(char*& destination, uint32_t bytes) const {
+    *destination++ = bytes & 0xff;
+    *destination++ = (bytes >> 8) & 0xff;
+    *destination++ = (bytes >> 16) & 0xff;
+    *destination++ = (bytes >> 24) & 0xff;
+}
 
-    file.write(byte_data, sizeof(bytes));
+void BmpWriter::WriteBytes(char*& destination, uint16_t bytes) const {
+    *destination++ = bytes & 0xff;
+    *destination++ = (bytes >> 8) & 0xff;
 }
 
-void BmpWriter::WriteHeader(std::ofstream& file, const BitmapHeader& header) const {
-    WriteBytes(file, header.bf_type);
-    WriteBytes(file, header.bf_size);
-    WriteBytes(file, header.bf_reserved1);
-    WriteBytes(file, header.bf_reserved2);
-    WriteBytes(file, header.bf_off_bits);
-    WriteBytes(file, header.bi_size);
-    WriteBytes(file, header.bi_width);
-    WriteBytes(file, header.bi_height);
-    WriteBytes(file, header.bi_planes);
-    WriteBytes(file, header.bi_bit_count);
-    WriteBytes(file, header.bi_compression);
-    WriteBytes(file, header.bi_size_image);
-    WriteBytes(file, header.bi_x_pels_per_meter);
-    WriteBytes(file, header.bi_y_pels_per_meter);
-    WriteBytes(file, header.bi_clr_used);
-    WriteBytes(file, header.bi_clr_important);
+void BmpWriter::WriteHeader(char*& destination, const BitmapHeader& header) const {
+    WriteBytes(destination, header.bf_type);
+    WriteBytes(destination, header.bf_size);
+    WriteBytes(destination, header.bf_reserved1);
+    WriteBytes(destination, header.bf_reserved2);
+    WriteBytes(destination, header.bf_off_bits);
+    WriteBytes(destination, header.bi_size);
+    WriteBytes(destination, header.bi_width);
+    WriteBytes(destination, header.bi_height);
+    WriteBytes(destination, header.bi_planes);
+    WriteBytes(destination, header.bi_bit_count);
+    WriteBytes(destination, header.bi_compression);
+    WriteBytes(destination, header.bi_size_image);
+    WriteBytes(destination, header.bi_x_pels_per_meter);
+    WriteBytes(destination, header.bi_y_pels_per_meter);
+    WriteBytes(destination, header.bi_clr_used);
+    WriteBytes(destination, header.bi_clr_important);
 }
 
 uint32_t BmpWriter::GetColorTableByteSize() const {
@@ -141,6 +248,11 @@ std::optional<BmpWriterError> BmpWriter::SetPixel(uint32_t x, uint32_t y, uint8_
         return BmpWriterError{"Color index is out of bounds"};
     }
 
+    if (pixel_table_indeces_ == nullptr) [[unlikely]] {
+        pixel_table_indeces_ = BufferPool::GetInstance().Allocate<uint8_t>(GetPixelDataSize());
+        std::fill(pixel_table_indeces_, pixel_table_indeces_ + GetPixelDataSize(), 0);
+    }
+
     pixel_table_indeces_[pixel_index] = color_table_index;
     return std::nullopt;
 }
@@ -164,20 +276,22 @@ BmpWriter::BmpWriter(uint32_t width, uint32_t height, uint8_t color_table_size)
     color_table_size_ = color_table_size;
 
     color_table_ = new Color[color_table_size];
-    pixel_table_indeces_ = new uint32_t[GetPixelDataSize()];
-    std::fill(pixel_table_indeces_, pixel_table_indeces_ + GetPixelDataSize(), 0);
 }
 
 BmpWriter::BmpWriter(const BmpWriter& other) 
     : width_(other.width_), 
       height_(other.height_), 
       color_table_size_(other.color_table_size_),
-      color_table_(new Color[other.color_table_size_]) {
+      color_table_(new Color[other.color_table_size_]),
+      get_row_(other.get_row_),
+      get_row_context_(other.get_row_context_) {
     std::copy(other.color_table_, other.color_table_ + color_table_size_, color_table_);
 
-    uint64_t pixel_data_size = static_cast<uint64_t>(width_) * height_;
-    pixel_table_indeces_ = new uint32_t[pixel_data_size];
-    std::copy(other.pixel_table_indeces_, other.pixel_table_indeces_ + pixel_data_size, pixel_table_indeces_);
+    if (other.pixel_table_indeces_ != nullptr) {
+        uint64_t pixel_data_size = static_cast<uint64_t>(width_) * height_;
+        pixel_table_indeces_ = BufferPool::GetInstance().Allocate<uint8_t>(pixel_data_size);
+        std::copy(other.pixel_table_indeces_, other.pixel_table_indeces_ + pixel_data_size, pixel_table_indeces_);
+    }
 }
 
 BmpWriter& BmpWriter::operator=(const BmpWriter& other) {
@@ -188,23 +302,29 @@ BmpWriter& BmpWriter::operator=(const BmpWriter& other) {
     Color* new_color_table = new Color[other.color_table_size_];
     std::copy(other.color_table_, other.color_table_ + other.color_table_size_, new_color_table);
 
-    uint64_t pixel_data_size = static_cast<uint64_t>(other.width_) * other.height_;
-    uint32_t* new_pixel_table_indeces = new uint32_t[pixel_data_size];
-    std::copy(other.pixel_table_indeces_, other.pixel_table_indeces_ + pixel_data_size, new_pixel_table_indeces);
+    uint8_t* new_pixel_table_indeces = nullptr;
+
+    if (other.pixel_table_indeces_ != nullptr) {
+        uint64_t pixel_data_size = static_cast<uint64_t>(other.width_) * other.height_;
+        new_pixel_table_indeces = BufferPool::GetInstance().Allocate<uint8_t>(pixel_data_size);
+        std::copy(other.pixel_table_indeces_, other.pixel_table_indeces_ + pixel_data_size, new_pixel_table_indeces);
+    }
 
     delete[] color_table_;
-    delete[] pixel_table_indeces_;
+    BufferPool::GetInstance().Release(pixel_table_indeces_);
 
     width_ = other.width_;
     height_ = other.height_;
     color_table_size_ = other.color_table_size_;
     color_table_ = new_color_table;
     pixel_table_indeces_ = new_pixel_table_indeces;
+    get_row_ = other.get_row_;
+    get_row_context_ = other.get_row_context_;
 
     return *this;
 }
 
 BmpWriter::~BmpWriter() {
     delete[] color_table_;
-    delete[] pixel_table_indeces_;
+    BufferPool::GetInstance().Release(pixel_table_indeces_);
 }
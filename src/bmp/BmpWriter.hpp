@@ -2,7 +2,6 @@
 
 #include <cstdint>
 #include <optional>
-#include <fstream>
 
 // RGB color
 struct Color {
@@ -17,7 +16,10 @@ struct BmpWriterError {
 
 /**
  * Class to generate .bmp files.
- * Uses color table, so only supports 1, 2, 4 and 8 bits per pixel
+ * Uses color table, so only supports 1, 2, 4 and 8 bits per pixel.
+ * Rows are encoded in parallel blocks, which are written to their offsets in the file.
+ * Not more blocks are encoded at once than fit into the memory limit of BufferPool.
+ * Pixels are stored only once SetPixel() is called, an image with a row source is encoded without storing them
  */
 class BmpWriter {
 public:
@@ -31,6 +33,14 @@ public:
     std::optional<BmpWriterError> SetColor(uint32_t table_index, Color color);
     std::optional<BmpWriterError> SetPixel(uint32_t x, uint32_t y, uint8_t color_table_index);
 
+    /**
+     * Makes Save() take the pixels from %get_row% instead of the ones set by SetPixel().
+     * %get_row%(y, indeces) fills the color table indices of the row y (row 0 is the bottom one).
+     * Each row is requested once, by a single thread. %get_row% has to outlive the writer
+     */
+    template<typename RowSource>
+    void SetRowSource(const RowSource& get_row);
+
     std::optional<BmpWriterError> Save(const char* path) const;
 
     uint64_t GetPixelDataSize() const;
@@ -41,7 +51,12 @@ public:
 
 private:
     Color* color_table_ = nullptr;
-    uint32_t* pixel_table_indeces_ = nullptr;
+    // color table indices fit into a byte, since there are at most 8 bits per pixel
+    uint8_t* pixel_table_indeces_ = nullptr;
+
+    // the row source, type-erased
+    void (*get_row_)(const void* context, uint32_t y, uint8_t* indeces) = nullptr;
+    const void* get_row_context_ = nullptr;
 
     uint32_t width_;
     uint32_t height_;
@@ -69,8 +84,29 @@ private:
         uint32_t bi_clr_important;
     };
 
-    void WriteHeader(std::ofstream& file, const BitmapHeader& header) const;
+    // 14 (BITMAPFILEHEADER) + 40 (BITMAPINFO)
+    static const uint32_t kHeadersByteSize = 54;
+
+    // approximate size of a block of rows encoded by one thread at a time
+    static const uint32_t kBlockByteSize = 1 << 20;
+
+    bool WritePixelData(int file, uint64_t pixel_data_offset) const;
 
-    void WriteBytes(std::ofstream& file, uint32_t bytes) const;
-    void WriteBytes(std::ofstream& file, uint16_t bytes) const;
+    /** @return Color table indices of the row, %buffer% of the image width is used if they aren't stored */
+    const uint8_t* GetRowIndeces(uint32_t y, uint8_t* buffer) const;
+    void EncodeRow(const uint8_t* indeces, char* row) const;
+    bool WriteAt(int file, const char* data, uint64_t size, uint64_t offset) const;
+
+    void WriteHeader(char*& destination, const BitmapHeader& header) const;
+
+    void WriteBytes(char*& destination, uint32_t bytes) const;
+    void WriteBytes(char*& destination, uint16_t bytes) const;
 };
+
+template<typename RowSource>
+void BmpWriter::SetRowSource(const RowSource& get_row) {
+    get_row_ = [](const void* context, uint32_t y, uint8_t* indeces) {
+        (*static_cast<const RowSource*>(context))(y, indeces);
+    };
+    get_row_context_ = &get_row;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "bmp/BmpWriter.hpp"
+
+#include <cstdint>
+
+/*
+ * Delta snapshots file layout (all numbers are little-endian):
+ *
+ * header:
+ *   kDeltaMagic (8 bytes), tile size log (1 byte),
+ *   palette size (1 byte), palette (red, green, blue for each color),
+ *   prefix length (2 bytes), prefix, extension length (2 bytes), extension
+ *
+ * frames, one after another:
+ *   label length (1 byte), label, keyframe flag (1 byte),
+ *   grid bounds: min_x, min_y, max_x, max_y (2 bytes each, signed),
+ *   tiles count (4 bytes), tiles byte size (8 bytes),
+ *   tiles: tile_x, tile_y (2 bytes each), then color indices of the tile cells
+ *   lying inside the grid bounds, row by row: two cells per byte, the first one in the high 4 bits,
+ *   each row starts from a new byte
+ *
+ * Tile (tile_x, tile_y) starts at the cell (tile_x * tile size - 32768, tile_y * tile size - 32768).
+ * A keyframe contains all tiles of the grid, other frames only the tiles changed since the previous frame.
+ * Cells which appear when the grid grows have color 0.
+ */
+
+const char kDeltaMagic[] = "SPDELTA1";
+const uint8_t kDeltaMagicSize = 8;
+
+// max length of a frame label
+const uint8_t kMaxDeltaLabelLength = 255;
+
+const uint8_t kMaxDeltaTileSizeLog = 8;
+
+// color indices take 4 bits
+const uint8_t kMaxDeltaPaletteSize = 16;
+
+struct DeltaBounds {
+    int16_t min_x = 0;
+    int16_t min_y = 0;
+    int16_t max_x = 0;
+    int16_t max_y = 0;
+};
+
+inline int32_t GetDeltaTileStart(uint32_t tile, uint8_t tile_size_log) {
+    return (static_cast<int32_t>(tile) << tile_size_log) - (1 << 15);
+}
@@ -0,0 +1,243 @@
+#include "DeltaReader.hpp"
+#include "memory/BufferPool.hpp"
+
+#include <algorithm>
+
+DeltaReader::~DeltaReader() {
+    delete[] palette_;
+    delete[] prefix_;
+    delete[] extension_;
+    BufferPool::GetInstance().Release(canvas_);
+}
+
+std::optional<DeltaReaderError> DeltaReader::Open(const char* path) {
+    file_.open(path, std::ios::binary);
+
+    if (!file_.good()) {
+        return DeltaReaderError{"Unable to open the delta snapshots file"};
+    }
+
+    char magic[kDeltaMagicSize];
+    file_.read(magic, kDeltaMagicSize);
+
+    if (!file_.good() || !std::equal(magic, magic + kDeltaMagicSize, kDeltaMagic)) {
+        return DeltaReaderError{"The file is not a delta snapshots file"};
+    }
+
+    tile_size_log_ = ReadBytes(1);
+    palette_size_ = ReadBytes(1);
+    palette_ = new Color[palette_size_];
+
+    if (tile_size_log_ > kMaxDeltaTileSizeLog || palette_size_ > kMaxDeltaPaletteSize) {
+        return DeltaReaderError{"The delta snapshots file header is corrupted"};
+    }
+
+    for (uint8_t i = 0; i < palette_size_; ++i) {
+        palette_[i].red = ReadBytes(1);
+        palette_[i].green = ReadBytes(1);
+        palette_[i].blue = ReadBytes(1);
+    }
+
+    prefix_ = ReadString(2);
+    extension_ = ReadString(2);
+
+    if (!file_.good()) {
+        return DeltaReaderError{"The delta snapshots file header is corrupted"};
+    }
+
+    return std::nullopt;
+}
+
+std::expected<bool, DeltaReaderError> DeltaReader::ReadFrame() {
+    std::expected<bool, DeltaReaderError> header_result = ReadFrameHeader();
+
+    if (!header_result.has_value() || !header_result.value()) {
+        return header_result;
+    }
+
+    if (!is_keyframe_ && !has_canvas_) {
+        return std::unexpected{DeltaReaderError{"Frames can only be rebuilt starting from a keyframe"}};
+    }
+
+    ResizeCanvas(bounds_);
+    has_canvas_ = true;
+
+    int32_t tile_size = 1 << tile_size_log_;
+    uint32_t canvas_width = GetCanvasWidth(bounds_);
+
+    for (uint32_t i = 0; i < tiles_count_; ++i) {
+        uint32_t tile_x = ReadBytes(2);
+        uint32_t tile_y = ReadBytes(2);
+
+        int32_t from_x = std::max<int32_t>(bounds_.min_x, GetDeltaTileStart(tile_x, tile_size_log_));
+        int32_t to_x = std::min<int32_t>(bounds_.max_x, GetDeltaTileStart(tile_x, tile_size_log_) + tile_size - 1);
+        int32_t from_y = std::max<int32_t>(bounds_.min_y, GetDeltaTileStart(tile_y, tile_size_log_));
+        int32_t to_y = std::min<int32_t>(bounds_.max_y, GetDeltaTileStart(tile_y, tile_size_log_) + tile_size - 1);
+
+        if (from_x > to_x || from_y > to_y) {
+            return std::unexpected{DeltaReaderError{"The frame contains a tile outside of the grid"}};
+        }
+
+        uint32_t width = to_x - from_x + 1;
+        uint8_t packed_row[(1 << kMaxDeltaTileSizeLog) / 2];
+
+        for (int32_t y = from_y; y <= to_y; ++y) {
+            uint8_t* row = canvas_ + static_cast<uint64_t>(y - bounds_.min_y) * canvas_width + (from_x - bounds_.min_x);
+            file_.read(reinterpret_cast<char*>(packed_row), (width + 1) / 2);
+
+            for (uint32_t x = 0; x < width; ++x) {
+                row[x] = (packed_row[x / 2] >> ((x % 2 == 0) ? 4 : 0)) & 0xf;
+            }
+        }
+    }
+
+    if (!file_.good()) {
+        return std::unexpected{DeltaReaderError{"The delta snapshots file is truncated"}};
+    }
+
+    return true;
+}
+
+std::expected<bool, DeltaReaderError> DeltaReader::SkipFrame() {
+    std::expected<bool, DeltaReaderError> header_result = ReadFrameHeader();
+
+    if (!header_result.has_value() || !header_result.value()) {
+        return header_result;
+    }
+
+    file_.seekg(tiles_byte_size_, std::ios::cur);
+    has_canvas_ = false;
+
+    return true;
+}
+
+uint64_t DeltaReader::Tell() {
+    return file_.tellg();
+}
+
+void DeltaReader::Seek(uint64_t offset) {
+    file_.clear();
+    file_.seekg(offset);
+    has_canvas_ = false;
+}
+
+std::expected<bool, DeltaReaderError> DeltaReader::ReadFrameHeader() {
+    if (file_.peek() == std::ifstream::traits_type::eof()) {
+        return false;
+    }
+
+    uint8_t label_length = ReadBytes(1);
+    file_.read(label_, label_length);
+    label_[label_length] = '\0';
+
+    is_keyframe_ = ReadBytes(1);
+    bounds_.min_x = static_cast<int16_t>(ReadBytes(2));
+    bounds_.min_y = static_cast<int16_t>(ReadBytes(2));
+    bounds_.max_x = static_cast<int16_t>(ReadBytes(2));
+    bounds_.max_y = static_cast<int16_t>(ReadBytes(2));
+
+    tiles_count_ = ReadBytes(4);
+    tiles_byte_size_ = ReadBytes(8);
+
+    if (!file_.good() || bounds_.min_x > bounds_.max_x || bounds_.min_y > bounds_.max_y) {
+        return std::unexpected{DeltaReaderError{"The delta snapshots file is corrupted"}};
+    }
+
+    return true;
+}
+
+void DeltaReader::ResizeCanvas(DeltaBounds bounds) {
+    if (has_canvas_ && bounds.min_x == canvas_bounds_.min_x && bounds.min_y == canvas_bounds_.min_y
+        && bounds.max_x == canvas_bounds_.max_x && bounds.max_y == canvas_bounds_.max_y) {
+        return;
+    }
+
+    uint64_t byte_size = static_cast<uint64_t>(GetCanvasWidth(bounds)) * GetCanvasHeight(bounds);
+    uint8_t* new_canvas = BufferPool::GetInstance().Allocate<uint8_t>(byte_size);
+    std::fill(new_canvas, new_canvas + byte_size, 0);
+
+    // the grid only grows, so the previous frame is copied to its place in the new one
+    if (has_canvas_) {
+        for (int32_t y = std::max(bounds.min_y, canvas_bounds_.min_y); y <= std::min(bounds.max_y, canvas_bounds_.max_y); ++y) {
+            int32_t from_x = std::max(bounds.min_x, canvas_bounds_.min_x);
+            int32_t to_x = std::min(bounds.max_x, canvas_bounds_.max_x);
+
+            if (from_x > to_x) {
+                break;
+            }
+
+            const uint8_t* source = canvas_ + static_cast<uint64_t>(y - canvas_bounds_.min_y) * GetCanvasWidth(canvas_bounds_)
+                + (from_x - canvas_bounds_.min_x);
+            uint8_t* destination = new_canvas + static_cast<uint64_t>(y - bounds.min_y) * GetCanvasWidth(bounds)
+                + (from_x - bounds.min_x);
+
+            std::copy(source, source + (to_x - from_x + 1), destination);
+        }
+    }
+
+    BufferPool::GetInstance().Release(canvas_);
+    canvas_ = new_canvas;
+    canvas_bounds_ = bounds;
+}
+
+uint32_t DeltaReader::GetCanvasWidth(DeltaBounds bounds) const {
+    return static_cast<int32_t>(bounds.max_x) - bounds.min_x + 1;
+}
+
+uint32_t DeltaReader::GetCanvasHeight(DeltaBounds bounds) const {
+    return static_cast<int32_t>(bounds.max_y) - bounds.min_y + 1;
+}
+
+uint64_t DeltaReader::ReadBytes(uint8_t count) {
+    uint8_t buffer[8] = {};
+    file_.read(reinterpret_cast<char*>(buffer), count);
+
+    uint64_t result = 0;
+    for (uint8_t i = 0; i < count; ++i) {
+        result |= static_cast<uint64_t>(buffer[i]) << (8 * i);
+    }
+
+    return result;
+}
+
+char* DeltaReader::ReadString(uint8_t length_byte_size) {
+    uint64_t length = ReadBytes(length_byte_size);
+    char* result = new char[length + 1];
+
+    file_.read(result, length);
+    result[length] = '\0';
+
+    return result;
+}
+
+const char* DeltaReader::GetLabel() const {
+    return label_;
+}
+
+bool DeltaReader::IsKeyframe() const {
+    return is_keyframe_;
+}
+
+DeltaBounds DeltaReader::GetBounds() const {
+    return bounds_;
+}
+
+uint8_t DeltaReader::GetColorIndex(int16_t x, int16_t y) const {
+    return canvas_[static_cast<uint64_t>(y - bounds_.min_y) * GetCanvasWidth(bounds_) + (x - bounds_.min_x)];
+}
+
+const Color* DeltaReader::GetPalette() const {
+    return palette_;
+}
+
+uint8_t DeltaReader::GetPaletteSize() const {
+    return palette_size_;
+}
+
+const char* DeltaReader::GetPrefix() const {
+    return prefix_;
+}
+
+const char* DeltaReader::GetExtension() const {
+    return extension_;
+}
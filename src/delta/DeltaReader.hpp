@@ -0,0 +1,80 @@
+#pragma once
+
+#include "delta/DeltaFormat.hpp"
+
+#include <cstdint>
+#include <expected>
+#include <fstream>
+#include <optional>
+
+struct DeltaReaderError {
+    const char* message = nullptr;
+};
+
+/**
+ * Reads a delta snapshots file (see DeltaFormat.hpp) and rebuilds full frames.
+ *
+ * Frames are applied one by one to a canvas of color indices, so after ReadFrame()
+ * the canvas holds the full frame. Frames may be skipped with SkipFrame(),
+ * but the canvas is only valid again after a keyframe is read.
+ */
+class DeltaReader {
+public:
+    DeltaReader() = default;
+    ~DeltaReader();
+
+    DeltaReader(const DeltaReader& other) = delete;
+    DeltaReader& operator=(const DeltaReader& other) = delete;
+
+    std::optional<DeltaReaderError> Open(const char* path);
+
+    /** Reads the next frame and applies it to the canvas. @return false if there are no frames left */
+    std::expected<bool, DeltaReaderError> ReadFrame();
+
+    /** Reads only the header of the next frame. @return false if there are no frames left */
+    std::expected<bool, DeltaReaderError> SkipFrame();
+
+    /** @return Offset of the next frame, which can be passed to Seek() */
+    uint64_t Tell();
+    void Seek(uint64_t offset);
+
+    const char* GetLabel() const;
+    bool IsKeyframe() const;
+    DeltaBounds GetBounds() const;
+
+    /** @return Color index of the cell (x, y) inside the current bounds */
+    uint8_t GetColorIndex(int16_t x, int16_t y) const;
+
+    const Color* GetPalette() const;
+    uint8_t GetPaletteSize() const;
+    const char* GetPrefix() const;
+    const char* GetExtension() const;
+
+private:
+    std::ifstream file_;
+
+    uint8_t tile_size_log_ = 0;
+    Color* palette_ = nullptr;
+    uint8_t palette_size_ = 0;
+    char* prefix_ = nullptr;
+    char* extension_ = nullptr;
+
+    char label_[kMaxDeltaLabelLength + 1] = {};
+    bool is_keyframe_ = false;
+    uint32_t tiles_count_ = 0;
+    uint64_t tiles_byte_size_ = 0;
+
+    DeltaBounds bounds_;
+    DeltaBounds canvas_bounds_;
+    uint8_t* canvas_ = nullptr;
+    bool has_canvas_ = false;
+
+    std::expected<bool, DeltaReaderError> ReadFrameHeader();
+    void ResizeCanvas(DeltaBounds bounds);
+
+    uint32_t GetCanvasWidth(DeltaBounds bounds) const;
+    uint32_t GetCanvasHeight(DeltaBounds bounds) const;
+
+    uint64_t ReadBytes(uint8_t count);
+    char* ReadString(uint8_t length_byte_size);
+};
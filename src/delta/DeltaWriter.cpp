@@ -0,0 +1,176 @@
+#include "DeltaWriter.hpp"
+#include "memory/BufferPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+DeltaWriter::~DeltaWriter() {
+    BufferPool::GetInstance().Release(tiles_);
+    BufferPool::GetInstance().Release(tile_colors_);
+}
+
+std::optional<DeltaWriterError> DeltaWriter::Open(
+    const char* path,
+    uint64_t keyframe_interval,
+    uint8_t tile_size_log,
+    const Color* palette,
+    uint8_t palette_size,
+    const char* prefix,
+    const char* extension)
+{
+    if (tile_size_log > kMaxDeltaTileSizeLog || palette_size > kMaxDeltaPaletteSize) {
+        return DeltaWriterError{"Delta snapshots support at most 16 colors and tiles of at most 256 cells"};
+    }
+
+    file_.open(path, std::ios::binary | std::ios::trunc);
+
+    if (!file_.good()) {
+        return DeltaWriterError{"Unable to open the delta snapshots file"};
+    }
+
+    keyframe_interval_ = std::max<uint64_t>(keyframe_interval, 1);
+    tile_size_log_ = tile_size_log;
+    frames_count_ = 0;
+
+    BufferPool::GetInstance().Release(tile_colors_);
+    tile_colors_ = BufferPool::GetInstance().Allocate<uint8_t>(uint64_t{1} << (2 * tile_size_log_));
+
+    file_.write(kDeltaMagic, kDeltaMagicSize);
+    WriteBytes(tile_size_log_, 1);
+    WriteBytes(palette_size, 1);
+
+    for (uint8_t i = 0; i < palette_size; ++i) {
+        WriteBytes(palette[i].red, 1);
+        WriteBytes(palette[i].green, 1);
+        WriteBytes(palette[i].blue, 1);
+    }
+
+    WriteBytes(std::strlen(prefix), 2);
+    file_.write(prefix, std::strlen(prefix));
+    WriteBytes(std::strlen(extension), 2);
+    file_.write(extension, std::strlen(extension));
+
+    if (!file_.good()) {
+        return DeltaWriterError{"Unable to write to the delta snapshots file"};
+    }
+
+    return std::nullopt;
+}
+
+bool DeltaWriter::IsOpen() const {
+    return file_.is_open();
+}
+
+bool DeltaWriter::IsNextFrameKeyframe() const {
+    return frames_count_ % keyframe_interval_ == 0;
+}
+
+void DeltaWriter::BeginFrame(const char* label, DeltaBounds bounds) {
+    std::strncpy(label_, label, kMaxDeltaLabelLength);
+    bounds_ = bounds;
+    tiles_count_ = 0;
+    tiles_byte_size_ = 0;
+    tile_width_ = 0;
+}
+
+uint8_t* DeltaWriter::AddTile(uint32_t tile_x, uint32_t tile_y) {
+    PackTile();
+
+    int32_t tile_size = 1 << tile_size_log_;
+    int32_t tile_start_x = GetDeltaTileStart(tile_x, tile_size_log_);
+    int32_t tile_start_y = GetDeltaTileStart(tile_y, tile_size_log_);
+
+    tile_width_ = std::min<int32_t>(bounds_.max_x, tile_start_x + tile_size - 1) - std::max<int32_t>(bounds_.min_x, tile_start_x) + 1;
+    tile_height_ = std::min<int32_t>(bounds_.max_y, tile_start_y + tile_size - 1) - std::max<int32_t>(bounds_.min_y, tile_start_y) + 1;
+
+    ReserveTiles(tiles_byte_size_ + 4);
+
+    uint8_t* tile = tiles_ + tiles_byte_size_;
+    tile[0] = tile_x & 0xff;
+    tile[1] = (tile_x >> 8) & 0xff;
+    tile[2] = tile_y & 0xff;
+    tile[3] = (tile_y >> 8) & 0xff;
+
+    tiles_byte_size_ += 4;
+    ++tiles_count_;
+
+    return tile_colors_;
+}
+
+void DeltaWriter::PackTile() {
+    if (tile_width_ == 0) {
+        return;
+    }
+
+    uint32_t row_byte_size = (tile_width_ + 1) / 2;
+    ReserveTiles(tiles_byte_size_ + static_cast<uint64_t>(row_byte_size) * tile_height_);
+
+    const uint8_t* colors = tile_colors_;
+    uint8_t* packed = tiles_ + tiles_byte_size_;
+
+    for (uint32_t y = 0; y < tile_height_; ++y) {
+        for (uint32_t x = 0; x < tile_width_; x += 2) {
+            uint8_t second = (x + 1 < tile_width_) ? colors[x + 1] : 0;
+            *packed++ = (colors[x] << 4) | second;
+        }
+
+        colors += tile_width_;
+    }
+
+    tiles_byte_size_ += static_cast<uint64_t>(row_byte_size) * tile_height_;
+    tile_width_ = 0;
+}
+
+std::optional<DeltaWriterError> DeltaWriter::EndFrame() {
+    PackTile();
+
+    uint8_t label_length = std::strlen(label_);
+
+    WriteBytes(label_length, 1);
+    file_.write(label_, label_length);
+    WriteBytes(IsNextFrameKeyframe(), 1);
+
+    WriteBytes(static_cast<uint16_t>(bounds_.min_x), 2);
+    WriteBytes(static_cast<uint16_t>(bounds_.min_y), 2);
+    WriteBytes(static_cast<uint16_t>(bounds_.max_x), 2);
+    WriteBytes(static_cast<uint16_t>(bounds_.max_y), 2);
+
+    WriteBytes(tiles_count_, 4);
+    WriteBytes(tiles_byte_size_, 8);
+    file_.write(reinterpret_cast<const char*>(tiles_), tiles_byte_size_);
+    file_.flush();
+
+    ++frames_count_;
+
+    if (!file_.good()) {
+        return DeltaWriterError{"Unable to write to the delta snapshots file"};
+    }
+
+    return std::nullopt;
+}
+
+void DeltaWriter::ReserveTiles(uint64_t byte_size) {
+    if (tiles_ != nullptr && BufferPool::GetCapacity(tiles_) >= byte_size) {
+        return;
+    }
+
+    uint64_t capacity = (tiles_ == nullptr) ? byte_size : std::max(byte_size, 2 * BufferPool::GetCapacity(tiles_));
+    uint8_t* new_tiles = BufferPool::GetInstance().Allocate<uint8_t>(capacity);
+
+    if (tiles_ != nullptr) {
+        std::copy(tiles_, tiles_ + tiles_byte_size_, new_tiles);
+        BufferPool::GetInstance().Release(tiles_);
+    }
+
+    tiles_ = new_tiles;
+}
+
+void DeltaWriter::WriteBytes(uint64_t bytes, uint8_t count) {
+    char buffer[8];
+
+    for (uint8_t i = 0; i < count; ++i) {
+        buffer[i] = (bytes >> (8 * i)) & 0xff;
+    }
+
+    file_.write(buffer, count);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "delta/DeltaFormat.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+
+struct DeltaWriterError {
+    const char* message = nullptr;
+};
+
+/**
+ * Writes frames to a delta snapshots file (see DeltaFormat.hpp).
+ *
+ * A frame is written by BeginFrame(), AddTile() for each tile it contains and EndFrame().
+ * Every %keyframe_interval%-th frame (starting from the first one) is a keyframe
+ * and must contain all tiles of the grid.
+ */
+class DeltaWriter {
+public:
+    DeltaWriter() = default;
+    ~DeltaWriter();
+
+    DeltaWriter(const DeltaWriter& other) = delete;
+    DeltaWriter& operator=(const DeltaWriter& other) = delete;
+
+    std::optional<DeltaWriterError> Open(
+        const char* path,
+        uint64_t keyframe_interval,
+        uint8_t tile_size_log,
+        const Color* palette,
+        uint8_t palette_size,
+        const char* prefix,
+        const char* extension);
+
+    bool IsOpen() const;
+    bool IsNextFrameKeyframe() const;
+
+    void BeginFrame(const char* label, DeltaBounds bounds);
+
+    /**
+     * Adds a tile to the current frame.
+     * @return Buffer for color indices of the tile cells inside the frame bounds (row by row, 1 byte per cell),
+     * which are packed on the next call
+     */
+    uint8_t* AddTile(uint32_t tile_x, uint32_t tile_y);
+
+    std::optional<DeltaWriterError> EndFrame();
+
+private:
+    std::ofstream file_;
+
+    uint64_t keyframe_interval_ = 1;
+    uint64_t frames_count_ = 0;
+    uint8_t tile_size_log_ = 0;
+
+    char label_[kMaxDeltaLabelLength + 1] = {};
+    DeltaBounds bounds_;
+    uint32_t tiles_count_ = 0;
+
+    uint8_t* tiles_ = nullptr;
+    uint64_t tiles_byte_size_ = 0;
+
+    // the last added tile, not packed yet
+    uint8_t* tile_colors_ = nullptr;
+    uint32_t tile_width_ = 0;
+    uint32_t tile_height_ = 0;
+
+    void PackTile();
+    void ReserveTiles(uint64_t byte_size);
+
+    void WriteBytes(uint64_t bytes, uint8_t count);
+};
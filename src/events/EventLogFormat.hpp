@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * Toppling event log layout (fixed-size numbers are little-endian, varints are LEB128,
+ * signed varints are zigzag-encoded):
+ *
+ * header:
+ *   kEventLogMagic (8 bytes), critical sand number (8 bytes), checkpoint interval (8 bytes),
+ *   whether the grid has a sink boundary at the bounds of the checkpoints (1 byte),
+ *   prefix length (2 bytes), prefix, extension length (2 bytes), extension
+ *
+ * records, one after another:
+ *   type (1 byte), iteration (8 bytes), stored payload byte size (8 bytes), stored payload
+ *
+ * A non-empty payload is stored compressed: its byte size (varint), then the payload as raw deflate data
+ * (see DeflateEncoder). Toppled cells are too dense and irregular for run-length encoding: in the middle of a run
+ * about a third of the cells of a row topple, mostly in runs of one to three cells. Their bitmaps have few
+ * long repetitions either, but a third of their bytes are zero, so they are only Huffman-coded, which makes them
+ * about 1.6 times smaller. An empty payload is stored as is. The payloads below are described uncompressed
+ *
+ * kCheckpointRecord, the state after %iteration% iterations, an empty payload for an empty grid:
+ *   grid bounds: min_x, min_y, max_x, max_y (2 bytes each, signed),
+ *   then the sand of the cells row by row (varints)
+ *
+ * kIterationRecord, the cells toppled by the iteration which leads to the state %iteration%,
+ * rows in the order they were swept, until the end of the payload:
+ *   y minus y of the previous row (varint, kNoEventRow before the first row), first_x + 32768 (varint),
+ *   words count (varint), words (8 bytes each): bit i of word w is the cell (first_x + 64 * w + i, y)
+ *
+ * kGrainsRecord, grains added to the state %iteration% by producers (see GrainQueue), until the end of the payload:
+ *   x, y (signed varints), amount (varint)
+ *
+ * Every iteration has a record, even if nothing toppled. A checkpoint is written at the state 0
+ * and then every checkpoint interval iterations. The state after n iterations is rebuilt from the last checkpoint
+ * not later than n by applying all records following it up to the iteration n: each cell of an iteration record
+ * topples once (the critical amount of sand), the cells of a row from left to right
+ */
+
+const char kEventLogMagic[] = "SPEVENT2";
+const uint8_t kEventLogMagicSize = 8;
+
+const int32_t kNoEventRow = -(1 << 15) - 1;
+
+// matches are not searched for (see above), so any level above 0 gives the same result
+const uint8_t kEventLogCompressionLevel = 1;
+
+// deflate can't expand data more than about 1032 times
+const uint64_t kMaxDeflateRatio = 1032;
+
+enum EventRecordType {
+    kCheckpointRecord = 0,
+    kIterationRecord = 1,
+    kGrainsRecord = 2
+};
+
+struct EventLogBounds {
+    int16_t min_x = 0;
+    int16_t min_y = 0;
+    int16_t max_x = 0;
+    int16_t max_y = 0;
+};
+
+inline uint64_t EncodeZigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t DecodeZigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
@@ -0,0 +1,234 @@
+#include "EventLogReader.hpp"
+#include "memory/BufferPool.hpp"
+
+#include <algorithm>
+
+EventLogReader::~EventLogReader() {
+    delete[] prefix_;
+    delete[] extension_;
+    BufferPool::GetInstance().Release(payload_);
+    BufferPool::GetInstance().Release(stored_payload_);
+}
+
+std::optional<EventLogReaderError> EventLogReader::Open(const char* path) {
+    file_.open(path, std::ios::binary);
+
+    if (!file_.good()) {
+        return EventLogReaderError{"Unable to open the event log file"};
+    }
+
+    char magic[kEventLogMagicSize];
+    file_.read(magic, kEventLogMagicSize);
+
+    if (!file_.good() || !std::equal(magic, magic + kEventLogMagicSize, kEventLogMagic)) {
+        return EventLogReaderError{"The file is not an event log"};
+    }
+
+    critical_sand_number_ = ReadBytes(8);
+    checkpoint_interval_ = ReadBytes(8);
+    is_bounded_ = ReadBytes(1);
+    prefix_ = ReadString(2);
+    extension_ = ReadString(2);
+
+    if (!file_.good() || critical_sand_number_ == 0 || checkpoint_interval_ == 0) {
+        return EventLogReaderError{"The event log header is corrupted"};
+    }
+
+    return std::nullopt;
+}
+
+std::expected<bool, EventLogReaderError> EventLogReader::ReadRecord() {
+    std::expected<bool, EventLogReaderError> header_result = ReadRecordHeader();
+
+    if (!header_result.has_value() || !header_result.value()) {
+        return header_result;
+    }
+
+    if (stored_payload_ == nullptr || BufferPool::GetCapacity(stored_payload_) < stored_byte_size_) {
+        BufferPool::GetInstance().Release(stored_payload_);
+        stored_payload_ = BufferPool::GetInstance().Allocate<uint8_t>(std::max<uint64_t>(stored_byte_size_, 1));
+    }
+
+    file_.read(reinterpret_cast<char*>(stored_payload_), stored_byte_size_);
+
+    if (!file_.good()) {
+        return std::unexpected{EventLogReaderError{"The event log is truncated"}};
+    } else if (!DecompressPayload()) {
+        return std::unexpected{EventLogReaderError{"The record can't be decompressed"}};
+    }
+
+    if (record_type_ == kCheckpointRecord && !IsCheckpointEmpty()) {
+        EventLogBounds bounds = GetBounds();
+
+        if (payload_byte_size_ < 8 || bounds.min_x > bounds.max_x || bounds.min_y > bounds.max_y) {
+            return std::unexpected{EventLogReaderError{"The checkpoint is corrupted"}};
+        }
+    }
+
+    return true;
+}
+
+std::expected<bool, EventLogReaderError> EventLogReader::SkipRecord() {
+    std::expected<bool, EventLogReaderError> header_result = ReadRecordHeader();
+
+    if (!header_result.has_value() || !header_result.value()) {
+        return header_result;
+    }
+
+    file_.seekg(stored_byte_size_, std::ios::cur);
+    payload_byte_size_ = 0;
+
+    return true;
+}
+
+uint64_t EventLogReader::Tell() {
+    return file_.tellg();
+}
+
+void EventLogReader::Seek(uint64_t offset) {
+    file_.clear();
+    file_.seekg(offset);
+}
+
+std::expected<bool, EventLogReaderError> EventLogReader::ReadRecordHeader() {
+    if (file_.peek() == std::ifstream::traits_type::eof()) {
+        return false;
+    }
+
+    uint8_t type = ReadBytes(1);
+    iteration_ = ReadBytes(8);
+    stored_byte_size_ = ReadBytes(8);
+
+    if (!file_.good() || type > kGrainsRecord) {
+        return std::unexpected{EventLogReaderError{"The event log is corrupted"}};
+    }
+
+    record_type_ = static_cast<EventRecordType>(type);
+
+    return true;
+}
+
+bool EventLogReader::DecompressPayload() {
+    payload_byte_size_ = 0;
+
+    if (stored_byte_size_ == 0) {
+        return true;
+    }
+
+    uint64_t offset = 0;
+    uint64_t byte_size = 0;
+
+    if (!ReadVarint(stored_payload_, stored_byte_size_, offset, byte_size)
+        || byte_size == 0 || byte_size / kMaxDeflateRatio > stored_byte_size_) {
+        return false;
+    }
+
+    if (payload_ == nullptr || BufferPool::GetCapacity(payload_) < byte_size) {
+        BufferPool::GetInstance().Release(payload_);
+        payload_ = BufferPool::GetInstance().Allocate<uint8_t>(byte_size);
+    }
+
+    if (!decoder_.Decompress(stored_payload_ + offset, stored_byte_size_ - offset, payload_, byte_size)) {
+        return false;
+    }
+
+    payload_byte_size_ = byte_size;
+    return true;
+}
+
+bool EventLogReader::ReadVarint(uint64_t& offset, uint64_t& value) const {
+    return ReadVarint(payload_, payload_byte_size_, offset, value);
+}
+
+bool EventLogReader::ReadVarint(const uint8_t* bytes, uint64_t byte_size, uint64_t& offset, uint64_t& value) {
+    value = 0;
+
+    for (uint8_t shift = 0; shift < 64; shift += 7) {
+        if (offset >= byte_size) {
+            return false;
+        }
+
+        uint8_t byte = bytes[offset++];
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint64_t EventLogReader::ReadPayloadBytes(uint64_t offset, uint8_t count) const {
+    uint64_t result = 0;
+
+    for (uint8_t i = 0; i < count; ++i) {
+        result |= static_cast<uint64_t>(payload_[offset + i]) << (8 * i);
+    }
+
+    return result;
+}
+
+uint64_t EventLogReader::ReadBytes(uint8_t count) {
+    uint8_t buffer[8] = {};
+    file_.read(reinterpret_cast<char*>(buffer), count);
+
+    uint64_t result = 0;
+    for (uint8_t i = 0; i < count; ++i) {
+        result |= static_cast<uint64_t>(buffer[i]) << (8 * i);
+    }
+
+    return result;
+}
+
+char* EventLogReader::ReadString(uint8_t length_byte_size) {
+    uint64_t length = ReadBytes(length_byte_size);
+    char* result = new char[length + 1];
+
+    file_.read(result, length);
+    result[length] = '\0';
+
+    return result;
+}
+
+EventRecordType EventLogReader::GetRecordType() const {
+    return record_type_;
+}
+
+uint64_t EventLogReader::GetIteration() const {
+    return iteration_;
+}
+
+bool EventLogReader::IsCheckpointEmpty() const {
+    return payload_byte_size_ == 0;
+}
+
+EventLogBounds EventLogReader::GetBounds() const {
+    EventLogBounds bounds;
+    bounds.min_x = static_cast<int16_t>(ReadPayloadBytes(0, 2));
+    bounds.min_y = static_cast<int16_t>(ReadPayloadBytes(2, 2));
+    bounds.max_x = static_cast<int16_t>(ReadPayloadBytes(4, 2));
+    bounds.max_y = static_cast<int16_t>(ReadPayloadBytes(6, 2));
+
+    return bounds;
+}
+
+uint64_t EventLogReader::GetCriticalSandNumber() const {
+    return critical_sand_number_;
+}
+
+uint64_t EventLogReader::GetCheckpointInterval() const {
+    return checkpoint_interval_;
+}
+
+bool EventLogReader::IsBounded() const {
+    return is_bounded_;
+}
+
+const char* EventLogReader::GetPrefix() const {
+    return prefix_;
+}
+
+const char* EventLogReader::GetExtension() const {
+    return extension_;
+}
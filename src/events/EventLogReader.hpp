@@ -0,0 +1,191 @@
+#pragma once
+
+#include "events/EventLogFormat.hpp"
+#include "png/Deflate.hpp"
+
+#include <cstdint>
+#include <expected>
+#include <fstream>
+#include <optional>
+
+struct EventLogReaderError {
+    const char* message = nullptr;
+};
+
+/**
+ * Reads a toppling event log (see EventLogFormat.hpp) record by record.
+ *
+ * ReadRecord() loads the payload of the next record, which is then walked by ForEachCell(), ForEachToppling()
+ * or ForEachGrain() depending on its type. SkipRecord() reads only the header, which is enough to index the checkpoints
+ */
+class EventLogReader {
+public:
+    EventLogReader() = default;
+    ~EventLogReader();
+
+    EventLogReader(const EventLogReader& other) = delete;
+    EventLogReader& operator=(const EventLogReader& other) = delete;
+
+    std::optional<EventLogReaderError> Open(const char* path);
+
+    /** Reads the next record with its payload, decompressing it. @return false if there are no records left */
+    std::expected<bool, EventLogReaderError> ReadRecord();
+
+    /** Reads only the header of the next record. @return false if there are no records left */
+    std::expected<bool, EventLogReaderError> SkipRecord();
+
+    /** @return Offset of the next record, which can be passed to Seek() */
+    uint64_t Tell();
+    void Seek(uint64_t offset);
+
+    EventRecordType GetRecordType() const;
+    uint64_t GetIteration() const;
+
+    /** Checks if the grid of the checkpoint record is empty, so it has neither bounds nor cells */
+    bool IsCheckpointEmpty() const;
+
+    /** @return Bounds of the grid of the checkpoint record */
+    EventLogBounds GetBounds() const;
+
+    /** Calls %callback%(x, y, sand) for every cell of the checkpoint record row by row */
+    template<typename Callback>
+    std::optional<EventLogReaderError> ForEachCell(Callback callback) const;
+
+    /** Calls %callback%(x, y) for every cell toppled by the iteration record in the order of the sweep */
+    template<typename Callback>
+    std::optional<EventLogReaderError> ForEachToppling(Callback callback) const;
+
+    /** Calls %callback%(x, y, amount) for every grain of the grains record */
+    template<typename Callback>
+    std::optional<EventLogReaderError> ForEachGrain(Callback callback) const;
+
+    uint64_t GetCriticalSandNumber() const;
+    uint64_t GetCheckpointInterval() const;
+    bool IsBounded() const;
+    const char* GetPrefix() const;
+    const char* GetExtension() const;
+
+private:
+    std::ifstream file_;
+
+    uint64_t critical_sand_number_ = 0;
+    uint64_t checkpoint_interval_ = 0;
+    bool is_bounded_ = false;
+    char* prefix_ = nullptr;
+    char* extension_ = nullptr;
+
+    EventRecordType record_type_ = kCheckpointRecord;
+    uint64_t iteration_ = 0;
+    uint64_t payload_byte_size_ = 0;
+    uint8_t* payload_ = nullptr;
+
+    // payload as it's stored in the file
+    uint64_t stored_byte_size_ = 0;
+    uint8_t* stored_payload_ = nullptr;
+    DeflateDecoder decoder_;
+
+    std::expected<bool, EventLogReaderError> ReadRecordHeader();
+
+    /** Decompresses the stored payload into the payload. @return false if it's corrupted */
+    bool DecompressPayload();
+
+    /** Reads a varint at %offset% of the payload and moves the offset past it. @return false if the payload ends */
+    bool ReadVarint(uint64_t& offset, uint64_t& value) const;
+    static bool ReadVarint(const uint8_t* bytes, uint64_t byte_size, uint64_t& offset, uint64_t& value);
+    uint64_t ReadPayloadBytes(uint64_t offset, uint8_t count) const;
+
+    uint64_t ReadBytes(uint8_t count);
+    char* ReadString(uint8_t length_byte_size);
+};
+
+template<typename Callback>
+std::optional<EventLogReaderError> EventLogReader::ForEachCell(Callback callback) const {
+    if (IsCheckpointEmpty()) {
+        return std::nullopt;
+    }
+
+    EventLogBounds bounds = GetBounds();
+    uint64_t offset = 8;
+
+    for (int32_t y = bounds.min_y; y <= bounds.max_y; ++y) {
+        for (int32_t x = bounds.min_x; x <= bounds.max_x; ++x) {
+            uint64_t sand;
+
+            if (!ReadVarint(offset, sand)) {
+                return EventLogReaderError{"The checkpoint is truncated"};
+            }
+
+            callback(static_cast<int16_t>(x), static_cast<int16_t>(y), sand);
+        }
+    }
+
+    return std::nullopt;
+}
+
+template<typename Callback>
+std::optional<EventLogReaderError> EventLogReader::ForEachToppling(Callback callback) const {
+    uint64_t offset = 0;
+    int64_t y = kNoEventRow;
+
+    while (offset < payload_byte_size_) {
+        uint64_t y_difference;
+        uint64_t first_x;
+        uint64_t words_count;
+
+        if (!ReadVarint(offset, y_difference) || !ReadVarint(offset, first_x) || !ReadVarint(offset, words_count)
+            || words_count > (payload_byte_size_ - offset) / 8) {
+            return EventLogReaderError{"The iteration record is corrupted"};
+        }
+
+        if (y_difference > static_cast<uint64_t>(INT16_MAX - y) || first_x > UINT16_MAX) {
+            return EventLogReaderError{"The iteration record contains a cell outside of the grid"};
+        }
+
+        y += static_cast<int64_t>(y_difference);
+        int64_t x = static_cast<int64_t>(first_x) + INT16_MIN;
+
+        for (uint64_t w = 0; w < words_count; ++w) {
+            uint64_t word = ReadPayloadBytes(offset, 8);
+            offset += 8;
+
+            while (word != 0) {
+                int64_t cell_x = x + 64 * static_cast<int64_t>(w) + __builtin_ctzll(word);
+                word &= word - 1;
+
+                if (cell_x > INT16_MAX) {
+                    return EventLogReaderError{"The iteration record contains a cell outside of the grid"};
+                }
+
+                callback(static_cast<int16_t>(cell_x), static_cast<int16_t>(y));
+            }
+        }
+    }
+
+    return std::nullopt;
+}
+
+template<typename Callback>
+std::optional<EventLogReaderError> EventLogReader::ForEachGrain(Callback callback) const {
+    uint64_t offset = 0;
+
+    while (offset < payload_byte_size_) {
+        uint64_t x;
+        uint64_t y;
+        uint64_t amount;
+
+        if (!ReadVarint(offset, x) || !ReadVarint(offset, y) || !ReadVarint(offset, amount)) {
+            return EventLogReaderError{"The grains record is corrupted"};
+        }
+
+        int64_t grain_x = DecodeZigzag(x);
+        int64_t grain_y = DecodeZigzag(y);
+
+        if (grain_x < INT16_MIN || grain_x > INT16_MAX || grain_y < INT16_MIN || grain_y > INT16_MAX) {
+            return EventLogReaderError{"The grains record contains a cell outside of the grid"};
+        }
+
+        callback(static_cast<int16_t>(grain_x), static_cast<int16_t>(grain_y), amount);
+    }
+
+    return std::nullopt;
+}
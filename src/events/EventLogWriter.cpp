@@ -0,0 +1,242 @@
+#include "EventLogWriter.hpp"
+#include "memory/BufferPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+EventLogWriter::~EventLogWriter() {
+    BufferPool::GetInstance().Release(checkpoint_.bytes);
+    BufferPool::GetInstance().Release(grains_.bytes);
+    BufferPool::GetInstance().Release(compressed_.bytes);
+    delete encoder_;
+
+    for (uint64_t i = 0; i < iterations_capacity_; ++i) {
+        BufferPool::GetInstance().Release(iterations_[i].bytes);
+    }
+
+    delete[] iterations_;
+}
+
+std::optional<EventLogWriterError> EventLogWriter::Open(
+    const char* path,
+    uint64_t critical_sand_number,
+    uint64_t checkpoint_interval,
+    bool is_bounded,
+    const char* prefix,
+    const char* extension)
+{
+    file_.open(path, std::ios::binary | std::ios::trunc);
+
+    if (!file_.good()) {
+        return EventLogWriterError{"Unable to open the event log file"};
+    }
+
+    checkpoint_interval_ = std::max<uint64_t>(checkpoint_interval, 1);
+    delete encoder_;
+    encoder_ = new DeflateEncoder{kEventLogCompressionLevel, true};
+
+    file_.write(kEventLogMagic, kEventLogMagicSize);
+    WriteBytes(critical_sand_number, 8);
+    WriteBytes(checkpoint_interval_, 8);
+    WriteBytes(is_bounded, 1);
+
+    WriteBytes(std::strlen(prefix), 2);
+    file_.write(prefix, std::strlen(prefix));
+    WriteBytes(std::strlen(extension), 2);
+    file_.write(extension, std::strlen(extension));
+
+    if (!file_.good()) {
+        return EventLogWriterError{"Unable to write to the event log file"};
+    }
+
+    return std::nullopt;
+}
+
+bool EventLogWriter::IsOpen() const {
+    return file_.is_open();
+}
+
+uint64_t EventLogWriter::GetCheckpointInterval() const {
+    return checkpoint_interval_;
+}
+
+void EventLogWriter::BeginCheckpoint(uint64_t iteration, const EventLogBounds* bounds) {
+    checkpoint_iteration_ = iteration;
+    checkpoint_.byte_size = 0;
+
+    if (bounds == nullptr) {
+        return;
+    }
+
+    AppendBytes(checkpoint_, static_cast<uint16_t>(bounds->min_x), 2);
+    AppendBytes(checkpoint_, static_cast<uint16_t>(bounds->min_y), 2);
+    AppendBytes(checkpoint_, static_cast<uint16_t>(bounds->max_x), 2);
+    AppendBytes(checkpoint_, static_cast<uint16_t>(bounds->max_y), 2);
+}
+
+void EventLogWriter::AddCheckpointCell(uint64_t sand) {
+    AppendVarint(checkpoint_, sand);
+}
+
+std::optional<EventLogWriterError> EventLogWriter::EndCheckpoint() {
+    std::optional<EventLogWriterError> writing_result = WriteRecord(kCheckpointRecord, checkpoint_iteration_, checkpoint_);
+    file_.flush();
+
+    return writing_result;
+}
+
+void EventLogWriter::BeginIterations(uint64_t first_iteration, uint64_t count) {
+    if (count > iterations_capacity_) {
+        RecordBuffer* iterations = new RecordBuffer[count];
+        std::copy(iterations_, iterations_ + iterations_capacity_, iterations);
+
+        delete[] iterations_;
+        iterations_ = iterations;
+        iterations_capacity_ = count;
+    }
+
+    for (uint64_t i = 0; i < count; ++i) {
+        iterations_[i].byte_size = 0;
+        iterations_[i].previous_y = kNoEventRow;
+    }
+
+    first_iteration_ = first_iteration;
+    iterations_count_ = count;
+}
+
+void EventLogWriter::AddToppledRow(
+    uint64_t iteration_index,
+    int32_t y,
+    int32_t first_x,
+    const uint64_t* words,
+    uint32_t words_count)
+{
+    while (words_count != 0 && words[words_count - 1] == 0) {
+        --words_count;
+    }
+
+    while (words_count != 0 && words[0] == 0) {
+        ++words;
+        --words_count;
+        first_x += 64;
+    }
+
+    if (words_count == 0) {
+        return;
+    }
+
+    RecordBuffer& iteration = iterations_[iteration_index];
+
+    // rows of an iteration are swept from top to bottom, so the difference is never negative
+    AppendVarint(iteration, static_cast<uint64_t>(y - iteration.previous_y));
+    AppendVarint(iteration, static_cast<uint64_t>(first_x + (1 << 15)));
+    AppendVarint(iteration, words_count);
+
+    for (uint32_t i = 0; i < words_count; ++i) {
+        AppendBytes(iteration, words[i], 8);
+    }
+
+    iteration.previous_y = y;
+}
+
+std::optional<EventLogWriterError> EventLogWriter::EndIterations(uint64_t performed_count) {
+    for (uint64_t i = 0; i < std::min(performed_count, iterations_count_); ++i) {
+        std::optional<EventLogWriterError> error = WriteRecord(kIterationRecord, first_iteration_ + i, iterations_[i]);
+
+        if (error.has_value()) {
+            return error;
+        }
+    }
+
+    iterations_count_ = 0;
+
+    // the log stays readable up to the last block if the run is killed
+    file_.flush();
+
+    return std::nullopt;
+}
+
+void EventLogWriter::AddGrain(int16_t x, int16_t y, uint64_t amount) {
+    AppendVarint(grains_, EncodeZigzag(x));
+    AppendVarint(grains_, EncodeZigzag(y));
+    AppendVarint(grains_, amount);
+}
+
+std::optional<EventLogWriterError> EventLogWriter::EndGrains(uint64_t iteration) {
+    if (grains_.byte_size == 0) {
+        return std::nullopt;
+    }
+
+    return WriteRecord(kGrainsRecord, iteration, grains_);
+}
+
+void EventLogWriter::Reserve(RecordBuffer& buffer, uint64_t byte_size) {
+    if (buffer.bytes != nullptr && BufferPool::GetCapacity(buffer.bytes) >= byte_size) {
+        return;
+    }
+
+    uint64_t capacity = (buffer.bytes == nullptr) ? byte_size : std::max(byte_size, 2 * BufferPool::GetCapacity(buffer.bytes));
+    uint8_t* new_bytes = BufferPool::GetInstance().Allocate<uint8_t>(capacity);
+
+    if (buffer.bytes != nullptr) {
+        std::copy(buffer.bytes, buffer.bytes + buffer.byte_size, new_bytes);
+        BufferPool::GetInstance().Release(buffer.bytes);
+    }
+
+    buffer.bytes = new_bytes;
+}
+
+void EventLogWriter::AppendBytes(RecordBuffer& buffer, uint64_t bytes, uint8_t count) {
+    Reserve(buffer, buffer.byte_size + count);
+
+    for (uint8_t i = 0; i < count; ++i) {
+        buffer.bytes[buffer.byte_size++] = (bytes >> (8 * i)) & 0xff;
+    }
+}
+
+void EventLogWriter::AppendVarint(RecordBuffer& buffer, uint64_t value) {
+    Reserve(buffer, buffer.byte_size + 10);
+
+    while (value >= 0x80) {
+        buffer.bytes[buffer.byte_size++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+
+    buffer.bytes[buffer.byte_size++] = value;
+}
+
+std::optional<EventLogWriterError> EventLogWriter::WriteRecord(EventRecordType type, uint64_t iteration, RecordBuffer& buffer) {
+    compressed_.byte_size = 0;
+
+    if (buffer.byte_size != 0) {
+        AppendVarint(compressed_, buffer.byte_size);
+        Reserve(compressed_, compressed_.byte_size + GetDeflateBound(buffer.byte_size));
+
+        compressed_.byte_size += encoder_->Compress(
+            buffer.bytes, buffer.byte_size, 0, true, compressed_.bytes + compressed_.byte_size);
+    }
+
+    WriteBytes(type, 1);
+    WriteBytes(iteration, 8);
+    WriteBytes(compressed_.byte_size, 8);
+    file_.write(reinterpret_cast<const char*>(compressed_.bytes), compressed_.byte_size);
+
+    buffer.byte_size = 0;
+    buffer.previous_y = kNoEventRow;
+
+    if (!file_.good()) {
+        return EventLogWriterError{"Unable to write to the event log file"};
+    }
+
+    return std::nullopt;
+}
+
+void EventLogWriter::WriteBytes(uint64_t bytes, uint8_t count) {
+    char buffer[8];
+
+    for (uint8_t i = 0; i < count; ++i) {
+        buffer[i] = (bytes >> (8 * i)) & 0xff;
+    }
+
+    file_.write(buffer, count);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "events/EventLogFormat.hpp"
+#include "png/Deflate.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+
+struct EventLogWriterError {
+    const char* message = nullptr;
+};
+
+/**
+ * Writes a toppling event log (see EventLogFormat.hpp).
+ *
+ * A checkpoint is written by BeginCheckpoint(), AddCheckpointCell() for each cell of the grid row by row and EndCheckpoint().
+ * Iterations are recorded in blocks, which may be computed interleaved (see Sandpile::ToppleGrid(uint64_t)):
+ * BeginIterations(), AddToppledRow() for the rows of any iteration of the block in any order of iterations,
+ * but in the sweep order within each one, and EndIterations(), which writes the records in the order of iterations.
+ * Grains are added by AddGrain() and written as one record by EndGrains()
+ */
+class EventLogWriter {
+public:
+    EventLogWriter() = default;
+    ~EventLogWriter();
+
+    EventLogWriter(const EventLogWriter& other) = delete;
+    EventLogWriter& operator=(const EventLogWriter& other) = delete;
+
+    std::optional<EventLogWriterError> Open(
+        const char* path,
+        uint64_t critical_sand_number,
+        uint64_t checkpoint_interval,
+        bool is_bounded,
+        const char* prefix,
+        const char* extension);
+
+    bool IsOpen() const;
+
+    uint64_t GetCheckpointInterval() const;
+
+    /** %bounds% is nullptr for an empty grid, which has no cells */
+    void BeginCheckpoint(uint64_t iteration, const EventLogBounds* bounds);
+    void AddCheckpointCell(uint64_t sand);
+    std::optional<EventLogWriterError> EndCheckpoint();
+
+    /** Starts recording the iterations leading to the states from %first_iteration% to %first_iteration% + %count% - 1 */
+    void BeginIterations(uint64_t first_iteration, uint64_t count);
+
+    /**
+     * Adds the row %y% of toppled cells of the %iteration_index%-th iteration of the block:
+     * bit i of %words%[w] is the cell (%first_x% + 64 * w + i, %y%). Zero words at the ends are skipped
+     */
+    void AddToppledRow(uint64_t iteration_index, int32_t y, int32_t first_x, const uint64_t* words, uint32_t words_count);
+
+    /** Writes the first %performed_count% iterations of the block, the rest of them is dropped */
+    std::optional<EventLogWriterError> EndIterations(uint64_t performed_count);
+
+    void AddGrain(int16_t x, int16_t y, uint64_t amount);
+
+    /** Writes the grains added since the last call as added to the state %iteration%, if there are any */
+    std::optional<EventLogWriterError> EndGrains(uint64_t iteration);
+
+private:
+    struct RecordBuffer {
+        uint8_t* bytes = nullptr;
+        uint64_t byte_size = 0;
+        int32_t previous_y = kNoEventRow;
+    };
+
+    std::ofstream file_;
+    uint64_t checkpoint_interval_ = 1;
+
+    RecordBuffer checkpoint_;
+    uint64_t checkpoint_iteration_ = 0;
+
+    RecordBuffer grains_;
+
+    // payload of the record being written, compressed
+    DeflateEncoder* encoder_ = nullptr;
+    RecordBuffer compressed_;
+
+    // records of the current block of iterations
+    RecordBuffer* iterations_ = nullptr;
+    uint64_t iterations_capacity_ = 0;
+    uint64_t iterations_count_ = 0;
+    uint64_t first_iteration_ = 0;
+
+    void Reserve(RecordBuffer& buffer, uint64_t byte_size);
+    void AppendBytes(RecordBuffer& buffer, uint64_t bytes, uint8_t count);
+    void AppendVarint(RecordBuffer& buffer, uint64_t value);
+
+    /** Compresses %buffer% and writes it as a record, then empties it */
+    std::optional<EventLogWriterError> WriteRecord(EventRecordType type, uint64_t iteration, RecordBuffer& buffer);
+    void WriteBytes(uint64_t bytes, uint8_t count);
+};
@@ -0,0 +1,127 @@
+#include "jobs/JobClient.hpp"
+#include "jobs/JobConnection.hpp"
+#include "jobs/JobProtocol.hpp"
+#include "parsing/tsv_parsing.hpp"
+#include "model/Grid.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <unistd.h>
+
+const uint64_t kOutputChunkSize = 4096;
+
+void WriteString(JobConnection& connection, const char* string) {
+    connection.WriteBytes(std::strlen(string), 4);
+    connection.Write(string, std::strlen(string));
+}
+
+void WriteInlineGrid(JobConnection& connection, const Grid& grid) {
+    connection.WriteBytes(static_cast<uint16_t>(grid.GetMinX()), 2);
+    connection.WriteBytes(static_cast<uint16_t>(grid.GetMinY()), 2);
+    connection.WriteBytes(grid.GetWidth(), 4);
+    connection.WriteBytes(grid.GetHeight(), 4);
+
+    if (grid.IsEmpty()) {
+        return;
+    }
+
+    for (int32_t y = grid.GetMinY(); y <= grid.GetMaxY(); ++y) {
+        for (int32_t x = grid.GetMinX(); x <= grid.GetMaxX(); ++x) {
+            connection.WriteBytes(grid.GetSand(x, y), 8);
+        }
+    }
+}
+
+int RunJobClient(const char* socket_path, int argc, char** argv, const Parameters& params) {
+    char working_directory[kMaxJobStringLength];
+
+    if (getcwd(working_directory, kMaxJobStringLength) == nullptr) {
+        std::cout << "An error occured while sending the job:" << std::endl;
+        std::cerr << "Unable to get the working directory" << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    bool has_inline_grid = std::string_view{params.input_file} == kStandardInputFileName;
+    Grid inline_grid;
+
+    if (has_inline_grid) {
+        std::optional<TsvParsingError> tsv_parsing_error = FillGrid(inline_grid, params.input_file);
+
+        if (tsv_parsing_error.has_value()) {
+            std::cout << "An error occured while processing the input file:" << std::endl;
+            std::cerr << tsv_parsing_error.value().message << std::endl;
+            std::cout << "On the line " << tsv_parsing_error.value().line << std::endl;
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    JobConnection connection;
+    std::optional<JobConnectionError> connection_error = connection.Connect(socket_path);
+
+    if (connection_error.has_value()) {
+        std::cout << "An error occured while sending the job:" << std::endl;
+        std::cerr << connection_error.value().message << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    // the server ignores the client options of the job
+    connection.Write(kJobMagic, kJobMagicSize);
+    WriteString(connection, working_directory);
+    connection.WriteBytes(argc - 1, 4);
+
+    for (int i = 1; i < argc; ++i) {
+        WriteString(connection, argv[i]);
+    }
+
+    connection.WriteBytes(has_inline_grid, 1);
+
+    if (has_inline_grid) {
+        WriteInlineGrid(connection, inline_grid);
+    }
+
+    if (!connection.Flush()) {
+        std::cout << "An error occured while sending the job:" << std::endl;
+        std::cerr << "The server closed the connection" << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    char chunk[kOutputChunkSize];
+    uint64_t chunk_size;
+
+    while ((chunk_size = connection.ReadAvailable(chunk, kOutputChunkSize)) != 0) {
+        char* output_end = static_cast<char*>(std::memchr(chunk, kJobOutputEnd, chunk_size));
+
+        if (output_end == nullptr) {
+            std::cout.write(chunk, chunk_size);
+            std::cout.flush();
+            continue;
+        }
+
+        std::cout.write(chunk, output_end - chunk);
+        std::cout.flush();
+
+        // the exit code may come in the next chunk
+        if (output_end + 1 < chunk + chunk_size) {
+            return static_cast<unsigned char>(output_end[1]);
+        }
+
+        uint64_t exit_code = connection.ReadBytes(1);
+
+        if (connection.IsGood()) {
+            return exit_code;
+        }
+
+        break;
+    }
+
+    std::cout << "An error occured while running the job:" << std::endl;
+    std::cerr << "The server closed the connection before the job finished" << std::endl;
+
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "parsing/argparsing.hpp"
+
+/**
+ * Sends the job given by the command line arguments %argv% (%params% parsed from them) to the server
+ * listening on %socket_path% (see JobServer) and prints its output as it comes.
+ * If the input file is kStandardInputFileName, the initial state is read from the standard input here
+ * and sent along with the job
+ * @return Exit code of the job
+ */
+int RunJobClient(const char* socket_path, int argc, char** argv, const Parameters& params);
@@ -0,0 +1,165 @@
+#include "jobs/JobConnection.hpp"
+#include "memory/BufferPool.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+const uint64_t kJobConnectionBufferSize = 1 << 16;
+
+JobConnection::JobConnection() {
+    write_buffer_ = BufferPool::GetInstance().Allocate<char>(kJobConnectionBufferSize);
+    read_buffer_ = BufferPool::GetInstance().Allocate<char>(kJobConnectionBufferSize);
+}
+
+JobConnection::JobConnection(int socket) : JobConnection() {
+    socket_ = socket;
+}
+
+JobConnection::~JobConnection() {
+    if (socket_ != -1) {
+        close(socket_);
+    }
+
+    BufferPool::GetInstance().Release(write_buffer_);
+    BufferPool::GetInstance().Release(read_buffer_);
+}
+
+std::optional<JobConnectionError> JobConnection::Connect(const char* socket_path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (std::strlen(socket_path) >= sizeof(address.sun_path)) {
+        return JobConnectionError{"The socket path is too long"};
+    }
+
+    std::strcpy(address.sun_path, socket_path);
+    socket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (socket_ == -1) {
+        return JobConnectionError{"Unable to create a socket"};
+    }
+
+    if (connect(socket_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        return JobConnectionError{"Unable to connect to the server"};
+    }
+
+    return std::nullopt;
+}
+
+bool JobConnection::IsGood() const {
+    return is_good_;
+}
+
+void JobConnection::Write(const char* data, uint64_t size) {
+    while (size != 0) {
+        if (write_size_ == kJobConnectionBufferSize && !Flush()) {
+            return;
+        }
+
+        uint64_t chunk_size = std::min(size, kJobConnectionBufferSize - write_size_);
+        std::memcpy(write_buffer_ + write_size_, data, chunk_size);
+
+        write_size_ += chunk_size;
+        data += chunk_size;
+        size -= chunk_size;
+    }
+}
+
+void JobConnection::WriteBytes(uint64_t bytes, uint8_t count) {
+    char buffer[8];
+
+    for (uint8_t i = 0; i < count; ++i) {
+        buffer[i] = (bytes >> (8 * i)) & 0xff;
+    }
+
+    Write(buffer, count);
+}
+
+bool JobConnection::Flush() {
+    uint64_t sent_size = 0;
+
+    while (is_good_ && sent_size < write_size_) {
+        // a closed connection must not kill the process with SIGPIPE
+        ssize_t result = send(socket_, write_buffer_ + sent_size, write_size_ - sent_size, MSG_NOSIGNAL);
+
+        if (result > 0) {
+            sent_size += result;
+        } else if (result == -1 && errno == EINTR) {
+            continue;
+        } else {
+            is_good_ = false;
+        }
+    }
+
+    write_size_ = 0;
+
+    return is_good_;
+}
+
+bool JobConnection::Receive() {
+    read_position_ = 0;
+    read_size_ = 0;
+
+    while (is_good_) {
+        ssize_t result = recv(socket_, read_buffer_, kJobConnectionBufferSize, 0);
+
+        if (result > 0) {
+            read_size_ = result;
+            return true;
+        } else if (result == -1 && errno == EINTR) {
+            continue;
+        }
+
+        is_good_ = false;
+    }
+
+    return false;
+}
+
+bool JobConnection::Read(char* data, uint64_t size) {
+    while (size != 0) {
+        if (read_position_ == read_size_ && !Receive()) {
+            std::fill(data, data + size, 0);
+            return false;
+        }
+
+        uint64_t chunk_size = std::min(size, read_size_ - read_position_);
+        std::memcpy(data, read_buffer_ + read_position_, chunk_size);
+
+        read_position_ += chunk_size;
+        data += chunk_size;
+        size -= chunk_size;
+    }
+
+    return true;
+}
+
+uint64_t JobConnection::ReadBytes(uint8_t count) {
+    unsigned char buffer[8];
+    uint64_t result = 0;
+
+    Read(reinterpret_cast<char*>(buffer), count);
+
+    for (uint8_t i = 0; i < count; ++i) {
+        result |= static_cast<uint64_t>(buffer[i]) << (8 * i);
+    }
+
+    return result;
+}
+
+uint64_t JobConnection::ReadAvailable(char* data, uint64_t size) {
+    if (read_position_ == read_size_ && !Receive()) {
+        return 0;
+    }
+
+    uint64_t chunk_size = std::min(size, read_size_ - read_position_);
+    std::memcpy(data, read_buffer_ + read_position_, chunk_size);
+    read_position_ += chunk_size;
+
+    return chunk_size;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+struct JobConnectionError {
+    const char* message = nullptr;
+};
+
+/**
+ * Buffered stream connection over a Unix domain socket, carrying the job protocol (see JobProtocol.hpp).
+ * Writes are sent on Flush(), reads are done in large chunks. Once an operation fails,
+ * the connection stays failed (see IsGood()) and the following reads return zeros
+ */
+class JobConnection {
+public:
+    JobConnection();
+
+    /** Takes the socket of an accepted connection */
+    explicit JobConnection(int socket);
+
+    ~JobConnection();
+
+    JobConnection(const JobConnection& other) = delete;
+    JobConnection& operator=(const JobConnection& other) = delete;
+
+    /** Connects to the server listening on %socket_path% */
+    std::optional<JobConnectionError> Connect(const char* socket_path);
+
+    bool IsGood() const;
+
+    void Write(const char* data, uint64_t size);
+
+    /** Writes %count% lower bytes of %bytes% */
+    void WriteBytes(uint64_t bytes, uint8_t count);
+
+    /** Sends all written data */
+    bool Flush();
+
+    bool Read(char* data, uint64_t size);
+    uint64_t ReadBytes(uint8_t count);
+
+    /**
+     * Reads whatever is available, waiting for at least one byte
+     * @return Amount of bytes read, 0 if the connection is closed
+     */
+    uint64_t ReadAvailable(char* data, uint64_t size);
+
+private:
+    int socket_ = -1;
+    bool is_good_ = true;
+
+    char* write_buffer_ = nullptr;
+    uint64_t write_size_ = 0;
+
+    char* read_buffer_ = nullptr;
+    uint64_t read_position_ = 0;
+    uint64_t read_size_ = 0;
+
+    /** Receives the next chunk into the empty read buffer */
+    bool Receive();
+};
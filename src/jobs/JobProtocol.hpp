@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * Job protocol over a Unix domain socket (all numbers are little-endian), one job per connection:
+ *
+ * request (client -> server):
+ *   kJobMagic (8 bytes), working directory length (4 bytes), working directory,
+ *   arguments count (4 bytes), arguments: length (4 bytes), then the argument,
+ *   inline grid flag (1 byte), then if it's set:
+ *   min_x, min_y (2 bytes each, signed), width, height (4 bytes each), cells row by row (8 bytes each)
+ *
+ * response (server -> client):
+ *   output of the job as it's produced, then a zero byte and the exit code of the job (1 byte)
+ *
+ * Arguments are the command line arguments of Sandpile without argv[0]. The job runs in the working directory
+ * of the client, so relative paths mean the same as in the command line. The inline grid is the initial state
+ * of a job whose input file is kStandardInputFileName. It must take at most kMaxInlineGridByteSize bytes
+ * and, if the job has a memory limit, at most half of it. A client which sends nothing for kJobReceiveTimeoutSeconds
+ * (or doesn't read the output for as long) is disconnected.
+ */
+
+const char kJobMagic[] = "SPJOB001";
+const uint8_t kJobMagicSize = 8;
+
+const uint32_t kMaxJobArgumentsCount = 256;
+const uint32_t kMaxJobStringLength = 4096;
+const uint64_t kMaxInlineGridByteSize = uint64_t{1} << 30;
+const long kJobReceiveTimeoutSeconds = 10;
+
+// the output of a job is text, so the zero byte marks its end
+const char kJobOutputEnd = '\0';
@@ -0,0 +1,282 @@
+#include "jobs/JobServer.hpp"
+#include "jobs/JobProtocol.hpp"
+#include "jobs/SandpileJob.hpp"
+#include "parsing/argparsing.hpp"
+#include "memory/BufferPool.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// jobs waiting for the current one to finish
+const int kJobsBacklog = 64;
+
+const char* kJobServerArgv0 = "Sandpile";
+
+/** Sends the output of a job to the client as it's produced, on each flush (e.g. std::endl) */
+class JobOutputBuffer : public std::streambuf {
+public:
+    explicit JobOutputBuffer(JobConnection& connection) : connection_(connection) {}
+
+protected:
+    int_type overflow(int_type character) override {
+        if (character != traits_type::eof()) {
+            char data = traits_type::to_char_type(character);
+            connection_.Write(&data, 1);
+        }
+
+        return connection_.IsGood() ? traits_type::not_eof(character) : traits_type::eof();
+    }
+
+    std::streamsize xsputn(const char* data, std::streamsize size) override {
+        connection_.Write(data, size);
+        return connection_.IsGood() ? size : 0;
+    }
+
+    int sync() override {
+        return connection_.Flush() ? 0 : -1;
+    }
+
+private:
+    JobConnection& connection_;
+};
+
+struct JobRequest {
+    char* working_directory = nullptr;
+
+    // argv of the job
+    uint32_t arguments_count = 0;
+    char** arguments = nullptr;
+
+    bool has_inline_grid = false;
+    Grid inline_grid;
+
+    JobRequest() = default;
+
+    JobRequest(const JobRequest& other) = delete;
+    JobRequest& operator=(const JobRequest& other) = delete;
+
+    ~JobRequest() {
+        for (uint32_t i = 0; i < arguments_count; ++i) {
+            delete[] arguments[i];
+        }
+
+        delete[] arguments;
+        delete[] working_directory;
+    }
+};
+
+JobServer::JobServer(const char* socket_path)
+    : socket_path_(socket_path),
+      scheduler_(std::max(1u, std::thread::hardware_concurrency())) {}
+
+JobServer::~JobServer() {
+    if (socket_ != -1) {
+        close(socket_);
+    }
+}
+
+std::optional<JobServerError> JobServer::Listen() {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (std::strlen(socket_path_) >= sizeof(address.sun_path)) {
+        return JobServerError{"The socket path is too long"};
+    }
+
+    std::strcpy(address.sun_path, socket_path_);
+
+    struct stat socket_stat;
+
+    if (stat(socket_path_, &socket_stat) == 0) {
+        if (!S_ISSOCK(socket_stat.st_mode)) {
+            return JobServerError{"The socket path is taken by a file which is not a socket"};
+        }
+
+        // a server which is still alive accepts the connection
+        JobConnection connection;
+
+        if (!connection.Connect(socket_path_).has_value()) {
+            return JobServerError{"Another server is already listening on the socket"};
+        }
+
+        unlink(socket_path_);
+    }
+
+    socket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (socket_ == -1) {
+        return JobServerError{"Unable to create a socket"};
+    }
+
+    if (bind(socket_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        return JobServerError{"Unable to bind the socket"};
+    }
+
+    if (listen(socket_, kJobsBacklog) != 0) {
+        return JobServerError{"Unable to listen on the socket"};
+    }
+
+    return std::nullopt;
+}
+
+std::optional<JobServerError> JobServer::Serve() {
+    while (true) {
+        int connection_socket = accept(socket_, nullptr, nullptr);
+
+        if (connection_socket == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+
+            return JobServerError{"Unable to accept a connection"};
+        }
+
+        // a client which stalls must not hold up the jobs queued after it
+        timeval timeout{kJobReceiveTimeoutSeconds, 0};
+        setsockopt(connection_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(connection_socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        JobConnection connection{connection_socket};
+        RunJob(connection);
+    }
+}
+
+void JobServer::RunJob(JobConnection& connection) {
+    JobOutputBuffer output_buffer{connection};
+    std::ostream output{&output_buffer};
+
+    char magic[kJobMagicSize];
+    connection.Read(magic, kJobMagicSize);
+
+    if (!connection.IsGood() || std::memcmp(magic, kJobMagic, kJobMagicSize) != 0) {
+        // not a client of the server, nobody to answer to
+        return;
+    }
+
+    JobRequest request;
+    std::optional<JobServerError> request_error = ReadRequest(connection, request);
+    int exit_code = EXIT_FAILURE;
+
+    if (request_error.has_value()) {
+        output << "An error occured while receiving the job:" << std::endl;
+        output << request_error.value().message << std::endl;
+    } else if (chdir(request.working_directory) != 0) {
+        output << "An error occured while receiving the job:" << std::endl;
+        output << "Unable to enter the working directory" << std::endl;
+        output << request.working_directory << std::endl;
+    } else {
+        exit_code = RunSandpileJob(request.arguments_count, request.arguments, output, output,
+            request.has_inline_grid ? &request.inline_grid : nullptr, &scheduler_);
+    }
+
+    output.flush();
+    connection.WriteBytes(kJobOutputEnd, 1);
+    connection.WriteBytes(exit_code, 1);
+    connection.Flush();
+}
+
+char* ReadString(JobConnection& connection) {
+    uint64_t length = connection.ReadBytes(4);
+
+    if (length > kMaxJobStringLength) {
+        return nullptr;
+    }
+
+    char* result = new char[length + 1];
+
+    connection.Read(result, length);
+    result[length] = '\0';
+
+    return result;
+}
+
+std::optional<JobServerError> JobServer::ReadRequest(JobConnection& connection, JobRequest& request) {
+    request.working_directory = ReadString(connection);
+    uint64_t arguments_count = connection.ReadBytes(4);
+
+    if (request.working_directory == nullptr || arguments_count > kMaxJobArgumentsCount) {
+        return JobServerError{"The request is too large"};
+    }
+
+    // argv[0] is not sent
+    request.arguments_count = arguments_count + 1;
+    request.arguments = new char*[request.arguments_count]{};
+    request.arguments[0] = new char[std::strlen(kJobServerArgv0) + 1];
+    std::strcpy(request.arguments[0], kJobServerArgv0);
+
+    for (uint32_t i = 1; i < request.arguments_count; ++i) {
+        request.arguments[i] = ReadString(connection);
+
+        if (request.arguments[i] == nullptr) {
+            return JobServerError{"The request is too large"};
+        }
+    }
+
+    request.has_inline_grid = connection.ReadBytes(1) != 0;
+
+    if (request.has_inline_grid) {
+        // wrong arguments are reported by the job itself, the grid is only checked against the hard cap then
+        std::expected<Parameters, ParametersParseError> params = ParseArguments(request.arguments_count, request.arguments);
+        uint64_t memory_limit = params.has_value() ? params->memory_limit_mb * 1024 * 1024 : 0;
+
+        std::optional<JobServerError> grid_error = ReadInlineGrid(connection, request.inline_grid, memory_limit);
+
+        if (grid_error.has_value()) {
+            return grid_error;
+        }
+    }
+
+    if (!connection.IsGood()) {
+        return JobServerError{"The request is incomplete"};
+    }
+
+    return std::nullopt;
+}
+
+std::optional<JobServerError> JobServer::ReadInlineGrid(JobConnection& connection, Grid& grid, uint64_t memory_limit) {
+    int16_t min_x = connection.ReadBytes(2);
+    int16_t min_y = connection.ReadBytes(2);
+    uint32_t width = connection.ReadBytes(4);
+    uint32_t height = connection.ReadBytes(4);
+
+    if (width == 0 || height == 0) {
+        return std::nullopt;
+    }
+
+    if (min_x + static_cast<int64_t>(width) - 1 > INT16_MAX || min_y + static_cast<int64_t>(height) - 1 > INT16_MAX) {
+        return JobServerError{"The inline grid doesn't fit into the coordinates range"};
+    }
+
+    uint64_t byte_size = static_cast<uint64_t>(width) * height * sizeof(uint64_t);
+
+    if (byte_size > kMaxInlineGridByteSize
+        || (memory_limit != 0 && BufferPool::GetCapacityFor(byte_size) > memory_limit / 2)) {
+        return JobServerError{"The inline grid is too large for the memory limit"};
+    }
+
+    int16_t max_x = min_x + static_cast<int32_t>(width) - 1;
+    int16_t max_y = min_y + static_cast<int32_t>(height) - 1;
+
+    // allocates the whole grid at once
+    grid.SetSand(min_x, min_y, 0);
+    grid.SetSand(max_x, max_y, 0);
+
+    for (int32_t y = min_y; y <= max_y && connection.IsGood(); ++y) {
+        for (int32_t x = min_x; x <= max_x; ++x) {
+            grid.SetSand(x, y, connection.ReadBytes(8));
+        }
+    }
+
+    return std::nullopt;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "jobs/JobConnection.hpp"
+#include "model/Grid.hpp"
+#include "model/WorkStealingScheduler.hpp"
+
+#include <optional>
+
+struct JobServerError {
+    const char* message = nullptr;
+};
+
+struct JobRequest;
+
+/**
+ * Runs jobs sent by clients (see JobClient.hpp) over a Unix domain socket, one after another.
+ * The threads of the checkerboard relaxation, the buffer pool and the cached group identities stay warm
+ * between jobs, so a small job doesn't pay for the process startup, thread creation and cold allocations.
+ * Connections waiting for their turn are queued by the socket
+ */
+class JobServer {
+public:
+    explicit JobServer(const char* socket_path);
+    ~JobServer();
+
+    JobServer(const JobServer& other) = delete;
+    JobServer& operator=(const JobServer& other) = delete;
+
+    /** Starts listening on the socket, replacing a stale socket file left by a previous server */
+    std::optional<JobServerError> Listen();
+
+    /** Accepts and runs jobs until an error occurs */
+    std::optional<JobServerError> Serve();
+
+private:
+    const char* socket_path_;
+    int socket_ = -1;
+
+    WorkStealingScheduler scheduler_;
+
+    void RunJob(JobConnection& connection);
+    std::optional<JobServerError> ReadRequest(JobConnection& connection, JobRequest& request);
+
+    /**
+     * Reads the inline grid of a request into the empty %grid%, refusing the ones which don't fit
+     * into %memory_limit% bytes (if it's not zero) along with the grid of the job
+     */
+    std::optional<JobServerError> ReadInlineGrid(JobConnection& connection, Grid& grid, uint64_t memory_limit);
+};
@@ -0,0 +1,248 @@
+#include "jobs/SandpileJob.hpp"
+#include "parsing/argparsing.hpp"
+#include "parsing/tsv_parsing.hpp"
+#include "model/Sandpile.hpp"
+#include "model/SandpileGroup.hpp"
+#include "memory/BufferPool.hpp"
+
+#include <thread>
+
+void CopyCells(const Grid& from, Grid& to) {
+    if (from.IsEmpty()) {
+        return;
+    }
+
+    for (int32_t y = from.GetMinY(); y <= from.GetMaxY(); ++y) {
+        for (int32_t x = from.GetMinX(); x <= from.GetMaxX(); ++x) {
+            to.SetSand(x, y, from.GetSand(x, y));
+        }
+    }
+}
+
+int RunSandpileJob(
+    int argc,
+    char** argv,
+    std::ostream& output,
+    std::ostream& errors,
+    const Grid* initial_grid,
+    WorkStealingScheduler* scheduler)
+{
+    std::expected<Parameters, ParametersParseError> params = ParseArguments(argc, argv);
+    if (!params.has_value()) {
+        ParametersParseError error = params.error();
+
+        output << "An error occured while parsing arguments:" << std::endl;
+        output << error.message << std::endl;
+
+        if (error.argument != nullptr) {
+            errors << error.argument << std::endl;
+        }
+
+        if (error.argument_value != nullptr) {
+            errors << error.argument_value << std::endl;
+        }
+
+        output << "Use --help to see information about supported commands";
+
+        return EXIT_FAILURE;
+    }
+
+    if (params->need_help) {
+        ShowHelpMessage(output);
+        return EXIT_SUCCESS;
+    }
+
+    if (params->server_socket != nullptr) {
+        output << "An error occured while parsing arguments:" << std::endl;
+        output << "A job can't start a server" << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    BufferPool::GetInstance().SetHugePagesMode(params->huge_pages_mode);
+    BufferPool::GetInstance().SetMemoryLimit(params->memory_limit_mb * 1024 * 1024);
+    BufferPool::GetInstance().ResetPeakUsage();
+
+    Grid grid;
+
+    // the grid goes to the scratch file if it doesn't fit into the budget or the limit
+    if (params->memory_budget_mb != 0 || params->memory_limit_mb != 0) {
+        const char* scratch_directory = params->scratch_directory;
+
+        if (scratch_directory == nullptr) {
+            scratch_directory = params->output_directory;
+        }
+
+        grid.SetMemoryBudget(params->memory_budget_mb * 1024 * 1024, scratch_directory);
+    }
+
+    SandpileGroup group(params->domain_width, params->domain_height);
+
+    if (params->domain_width != 0) {
+        group.InitConfiguration(grid);
+    }
+
+    if (initial_grid != nullptr) {
+        CopyCells(*initial_grid, grid);
+    } else {
+        std::optional<TsvParsingError> tsv_parsing_error = FillGrid(grid, params->input_file);
+
+        if (tsv_parsing_error.has_value()) {
+            output << "An error occured while processing the input file:" << std::endl;
+            errors << tsv_parsing_error.value().message << std::endl;
+            output << "On the line " << tsv_parsing_error.value().line << std::endl;
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (params->group_operation == kAddIdentity) {
+        Grid identity;
+        group.GetIdentity(identity);
+        group.Add(grid, identity);
+    }
+
+    Sandpile sandpile(grid);
+    sandpile.SetOutputDirectory(params->output_directory);
+    sandpile.SetOutputFilePrefix(params->output_file_prefix);
+    sandpile.SetOutputFileExtension(params->output_file_extension);
+    sandpile.SetPngCompressionLevel(params->png_compression_level);
+    sandpile.SetDeltaSnapshots(params->delta_keyframe_interval);
+    sandpile.SetEventLog(params->event_checkpoint_interval);
+    sandpile.SetSnapshotSchedule(SnapshotSchedule{
+        params->log_snapshots_per_decade, params->snapshot_interval_ms, params->snapshot_topplings_threshold});
+    sandpile.SetActivityMapSaving(params->save_activity_map);
+    sandpile.SetStatisticsSaving(params->save_statistics);
+    sandpile.SetCheckerboardRelaxation(params->checkerboard_relaxation);
+    sandpile.SetNumaPolicy(params->numa_policy);
+    sandpile.SetIterationEngine(params->iteration_engine);
+
+    if (scheduler != nullptr) {
+        scheduler->ResetStats();
+        sandpile.SetScheduler(scheduler);
+    }
+
+    std::optional<SandpileError> preview_result = sandpile.SavePreviews(params->preview_block_size);
+
+    if (preview_result.has_value()) {
+        output << "An error occured while saving previews:" << std::endl;
+        errors << preview_result.value().message << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    uint32_t streams_count = params->stream_files_count;
+    GrainQueue grain_queue{streams_count};
+    std::thread* stream_threads = new std::thread[streams_count];
+    std::optional<TsvParsingError>* stream_results = new std::optional<TsvParsingError>[streams_count];
+
+    for (uint32_t i = 0; i < streams_count; ++i) {
+        stream_threads[i] = std::thread([&grain_queue, stream_results, i, &params]() {
+            stream_results[i] = StreamGrains(grain_queue, i, params->stream_files[i]);
+        });
+    }
+
+    if (streams_count != 0) {
+        sandpile.SetGrainQueue(&grain_queue);
+    }
+
+    std::expected<uint64_t, SandpileError> run_result 
+        = sandpile.Run(params->max_iterations, params->state_saving_frequency);
+
+    // streams still running after the run stopped early have nowhere to put their grains
+    grain_queue.Cancel();
+
+    for (uint32_t i = 0; i < streams_count; ++i) {
+        stream_threads[i].join();
+    }
+
+    delete[] stream_threads;
+    bool is_stream_failed = false;
+
+    for (uint32_t i = 0; i < streams_count; ++i) {
+        if (stream_results[i].has_value()) {
+            is_stream_failed = true;
+            output << "An error occured while processing the stream " << params->stream_files[i] << ':' << std::endl;
+            errors << stream_results[i].value().message << std::endl;
+            output << "On the line " << stream_results[i].value().line << std::endl;
+        }
+    }
+
+    delete[] stream_results;
+
+    if (is_stream_failed) {
+        return EXIT_FAILURE;
+    }
+
+    if (!run_result.has_value()) {
+        output << "An error occured while running the model:" << std::endl;
+        errors << run_result.error().message << std::endl;
+        
+        return EXIT_FAILURE;
+    }
+
+    output << "Final grid size: " << grid.GetWidth() << 'x' << grid.GetHeight() << std::endl;
+    output << "Calculation took " << run_result.value() << " topplings" << std::endl;
+
+    if (params->group_operation == kCheckRecurrence) {
+        output << "The final state is " << (group.IsRecurrent(grid) ? "recurrent" : "not recurrent") << std::endl;
+    }
+
+    const WorkStealingScheduler* used_scheduler = sandpile.GetScheduler();
+
+    if (used_scheduler != nullptr) {
+        uint64_t local_tasks_count = 0;
+        uint64_t remote_tasks_count = 0;
+
+        for (uint32_t i = 0; i < used_scheduler->GetThreadsCount(); ++i) {
+            const SchedulerThreadStats& thread_stats = used_scheduler->GetThreadStats(i);
+            uint64_t elapsed_time = used_scheduler->GetElapsedTime();
+            uint64_t utilization = (elapsed_time == 0) ? 0 : 100 * thread_stats.busy_time / elapsed_time;
+
+            output << "Thread " << i << ": " << utilization << "% busy, " << thread_stats.tasks_count << " tiles, "
+                << thread_stats.stolen_tasks_count << " stolen";
+
+            if (params->numa_policy != kNoNumaPolicy) {
+                output << ", node " << used_scheduler->GetThreadNode(i) << ", " << thread_stats.local_tasks_count
+                    << " local, " << thread_stats.remote_tasks_count << " remote";
+            }
+
+            output << std::endl;
+
+            local_tasks_count += thread_stats.local_tasks_count;
+            remote_tasks_count += thread_stats.remote_tasks_count;
+        }
+
+        if (params->numa_policy != kNoNumaPolicy) {
+            uint64_t counted_tasks_count = local_tasks_count + remote_tasks_count;
+            uint64_t remote_share = (counted_tasks_count == 0) ? 0 : 100 * remote_tasks_count / counted_tasks_count;
+
+            output << "NUMA: " << NumaTopology::GetInstance().GetNodesCount() << " nodes, " << remote_share
+                << "% of tiles on remote memory";
+
+            // pages of the tiles may be unknown without NUMA support in the kernel
+            if (counted_tasks_count == 0) {
+                output << " (placement unknown)";
+            }
+
+            output << std::endl;
+        }
+    }
+
+    if (params->save_statistics || params->memory_limit_mb != 0) {
+        BufferPoolStats buffer_stats = BufferPool::GetInstance().GetStats();
+        output << "Buffers: " << buffer_stats.allocations << " allocations, "
+            << buffer_stats.reused_allocations << " reused, peak usage "
+            << buffer_stats.peak_used_byte_size / 1024 << " KiB";
+
+        // the peak usage is reset for each job, unlike the resident memory of the job server process
+        if (params->memory_limit_mb != 0) {
+            output << " (limit " << params->memory_limit_mb * 1024 << " KiB, grid "
+                << (grid.IsMapped() ? "in the scratch file" : "in memory") << ')';
+        }
+
+        output << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
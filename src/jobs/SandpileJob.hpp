@@ -0,0 +1,21 @@
+#pragma once
+
+#include "model/Grid.hpp"
+#include "model/WorkStealingScheduler.hpp"
+
+#include <ostream>
+
+/**
+ * Runs the model with the command line arguments %argv% (argv[0] is skipped) as the Sandpile executable does,
+ * printing the results to %output% and the error details to %errors%.
+ * If %initial_grid% is not nullptr, it's the initial state instead of the input file.
+ * The checkerboard relaxation runs on %scheduler% if it's not nullptr (see Sandpile::SetScheduler)
+ * @return Exit code
+ */
+int RunSandpileJob(
+    int argc,
+    char** argv,
+    std::ostream& output,
+    std::ostream& errors,
+    const Grid* initial_grid = nullptr,
+    WorkStealingScheduler* scheduler = nullptr);
@@ -1,6 +1,7 @@
 #include "parsing/argparsing.hpp"
-#include "parsing/tsv_parsing.hpp"
-#include "model/Sandpile.hpp"
+#include "jobs/SandpileJob.hpp"
+#include "jobs/JobServer.hpp"
+#include "jobs/JobClient.hpp"
 
 #include <iostream>
 
@@ -10,59 +11,27 @@ int main(int argc, char** argv){
         return EXIT_SUCCESS;
     }
 
+    // the job reports wrong arguments itself
     std::expected<Parameters, ParametersParseError> params = ParseArguments(argc, argv);
-    if (!params.has_value()) {
-        ParametersParseError error = params.error();
 
-        std::cout << "An error occured while parsing arguments:" << std::endl;
-        std::cout << error.message << std::endl;
+    if (params.has_value() && params->server_socket != nullptr) {
+        JobServer server(params->server_socket);
+        std::optional<JobServerError> server_error = server.Listen();
 
-        if (error.argument != nullptr) {
-            std::cerr << error.argument << std::endl;
+        if (!server_error.has_value()) {
+            std::cout << "Listening on " << params->server_socket << std::endl;
+            server_error = server.Serve();
         }
 
-        if (error.argument_value != nullptr) {
-            std::cerr << error.argument_value << std::endl;
-        }
-
-        std::cout << "Use --help to see information about supported commands";
-
-        return EXIT_FAILURE;
-    }
-
-    if (params->need_help) {
-        ShowHelpMessage();
-        return EXIT_SUCCESS;
-    }
-
-    Grid grid;
-    std::optional<TsvParsingError> tsv_parsing_error = FillGrid(grid, params->input_file);
-    
-    if (tsv_parsing_error.has_value()) {
-        std::cout << "An error occured while processing the input file:" << std::endl;
-        std::cerr << tsv_parsing_error.value().message << std::endl;
-        std::cout << "On the line " << tsv_parsing_error.value().line << std::endl;
+        std::cout << "An error occured while running the server:" << std::endl;
+        std::cerr << server_error.value().message << std::endl;
 
         return EXIT_FAILURE;
     }
 
-    Sandpile sandpile(grid);
-    sandpile.SetOutputDirectory(params->output_directory);
-    sandpile.SetOutputFilePrefix(params->output_file_prefix);
-    sandpile.SetOutputFileExtension(params->output_file_extension);
-
-    std::expected<uint64_t, SandpileError> run_result 
-        = sandpile.Run(params->max_iterations, params->state_saving_frequency);
-
-    if (!run_result.has_value()) {
-        std::cout << "An error occured while running the model:" << std::endl;
-        std::cerr << run_result.error().message << std::endl;
-        
-        return EXIT_FAILURE;
+    if (params.has_value() && params->client_socket != nullptr && !params->need_help) {
+        return RunJobClient(params->client_socket, argc, argv, params.value());
     }
 
-    std::cout << "Final grid size: " << grid.GetWidth() << 'x' << grid.GetHeight() << std::endl;
-    std::cout << "Calculation took " << run_result.value() << " topplings" << std::endl;
-
-    return EXIT_SUCCESS;
+    return RunSandpileJob(argc, argv, std::cout, std::cerr);
 }
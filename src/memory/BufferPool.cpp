@@ -0,0 +1,361 @@
+#include "memory/BufferPool.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+
+#include <sys/mman.h>
+
+BufferPool& BufferPool::GetInstance() {
+    static BufferPool instance;
+    return instance;
+}
+
+BufferPool::~BufferPool() {
+    Trim();
+    std::free(large_headers_);
+}
+
+void* BufferPool::Allocate(uint64_t byte_size) {
+    uint64_t capacity = GetCapacityFor(byte_size);
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    BufferHeader* header = TakeCached(capacity);
+
+    if (header != nullptr) {
+        ++stats_.reused_allocations;
+    } else {
+        if (memory_limit_ != 0 && stats_.reserved_byte_size + capacity > memory_limit_) {
+            FreeCached();
+        }
+
+        header = (capacity < kHugePageSize) ? AllocateSmall(capacity) : AllocateLarge(capacity);
+
+        if (header == nullptr) {
+            return nullptr;
+        }
+
+        stats_.reserved_byte_size += GetFootprint(header);
+    }
+
+    ++stats_.allocations;
+    stats_.used_byte_size += GetFootprint(header);
+    stats_.peak_used_byte_size = std::max(stats_.peak_used_byte_size, stats_.used_byte_size);
+
+    return GetBuffer(header);
+}
+
+void BufferPool::Release(void* buffer) {
+    if (buffer == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    BufferHeader* header = GetHeader(buffer);
+
+    stats_.used_byte_size -= GetFootprint(header);
+
+    bool is_over_limit = memory_limit_ != 0 && stats_.reserved_byte_size > memory_limit_;
+
+    if (is_over_limit || cached_byte_size_ + header->capacity > kMaxCachedByteSize) {
+        Free(header);
+        return;
+    }
+
+    cached_byte_size_ += header->capacity;
+
+    if (header->capacity < kHugePageSize) {
+        BufferHeader*& free_list = small_free_lists_[GetSmallClass(header->capacity)];
+        header->next_free = free_list;
+        free_list = header;
+    } else {
+        header->next_free = large_free_list_;
+        large_free_list_ = header;
+    }
+}
+
+uint64_t BufferPool::GetCapacity(const void* buffer) {
+    BufferPool& pool = GetInstance();
+    std::lock_guard<std::mutex> lock{pool.mutex_};
+
+    return pool.GetHeader(buffer)->capacity;
+}
+
+void BufferPool::SetHugePagesMode(HugePagesMode mode) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    huge_pages_mode_ = mode;
+}
+
+void BufferPool::SetMemoryLimit(uint64_t byte_size) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    memory_limit_ = byte_size;
+}
+
+uint64_t BufferPool::GetMemoryLimit() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return memory_limit_;
+}
+
+uint64_t BufferPool::GetAvailableByteSize() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    if (memory_limit_ == 0) {
+        return UINT64_MAX;
+    }
+
+    return (stats_.used_byte_size < memory_limit_) ? memory_limit_ - stats_.used_byte_size : 0;
+}
+
+BufferPoolStats BufferPool::GetStats() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return stats_;
+}
+
+void BufferPool::ResetPeakUsage() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stats_.peak_used_byte_size = stats_.used_byte_size;
+}
+
+void BufferPool::Trim() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    FreeCached();
+}
+
+void BufferPool::FreeCached() {
+    for (uint8_t i = 0; i < kSmallClassesCount; ++i) {
+        while (small_free_lists_[i] != nullptr) {
+            BufferHeader* header = small_free_lists_[i];
+            small_free_lists_[i] = header->next_free;
+            Free(header);
+        }
+    }
+
+    while (large_free_list_ != nullptr) {
+        BufferHeader* header = large_free_list_;
+        large_free_list_ = header->next_free;
+        Free(header);
+    }
+
+    cached_byte_size_ = 0;
+}
+
+BufferPool::BufferHeader* BufferPool::TakeCached(uint64_t capacity) {
+    if (capacity < kHugePageSize) {
+        BufferHeader*& free_list = small_free_lists_[GetSmallClass(capacity)];
+        BufferHeader* header = free_list;
+
+        if (header != nullptr) {
+            free_list = header->next_free;
+            cached_byte_size_ -= header->capacity;
+        }
+
+        return header;
+    }
+
+    // large buffers are reused if not more than a quarter of them is wasted
+    BufferHeader** link = &large_free_list_;
+
+    while (*link != nullptr) {
+        BufferHeader* header = *link;
+
+        if (header->capacity >= capacity && header->capacity - capacity <= capacity / 4) {
+            *link = header->next_free;
+            cached_byte_size_ -= header->capacity;
+
+            return header;
+        }
+
+        link = &header->next_free;
+    }
+
+    return nullptr;
+}
+
+BufferPool::BufferHeader* BufferPool::AllocateSmall(uint64_t capacity) {
+    void* memory = std::aligned_alloc(kAlignment, capacity + kAlignment);
+
+    if (memory == nullptr) {
+        return nullptr;
+    }
+
+    BufferHeader* header = static_cast<BufferHeader*>(memory);
+    header->capacity = capacity;
+    header->mapping_byte_size = 0;
+    header->mapping = nullptr;
+
+    return header;
+}
+
+BufferPool::BufferHeader* BufferPool::AllocateLarge(uint64_t capacity) {
+    void* memory = MAP_FAILED;
+
+    if (huge_pages_mode_ == kExplicitHugePages) {
+        memory = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+
+    if (memory == MAP_FAILED) {
+        // explicit huge pages may be not reserved in the system, transparent ones are used instead
+        memory = mmap(nullptr, capacity + kHugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (memory == MAP_FAILED) {
+            return nullptr;
+        }
+
+        // trim the mapping to the huge page boundaries
+        uintptr_t begin = reinterpret_cast<uintptr_t>(memory);
+        uintptr_t aligned_begin = (begin + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+
+        if (aligned_begin != begin) {
+            munmap(memory, aligned_begin - begin);
+        }
+
+        munmap(reinterpret_cast<void*>(aligned_begin + capacity), kHugePageSize - (aligned_begin - begin));
+        memory = reinterpret_cast<void*>(aligned_begin);
+
+        if (huge_pages_mode_ != kNoHugePages) {
+            madvise(memory, capacity, MADV_HUGEPAGE);
+        }
+    }
+
+    BufferHeader* header = static_cast<BufferHeader*>(std::malloc(sizeof(BufferHeader)));
+
+    if (header == nullptr) {
+        munmap(memory, capacity);
+        return nullptr;
+    }
+
+    header->capacity = capacity;
+    header->mapping_byte_size = capacity;
+    header->mapping = static_cast<char*>(memory);
+
+    if (!InsertLargeHeader(header)) {
+        munmap(memory, capacity);
+        std::free(header);
+
+        return nullptr;
+    }
+
+    return header;
+}
+
+void BufferPool::Free(BufferHeader* header) {
+    stats_.reserved_byte_size -= GetFootprint(header);
+
+    if (header->mapping_byte_size != 0) {
+        EraseLargeHeader(header);
+        munmap(header->mapping, header->mapping_byte_size);
+    }
+
+    std::free(header);
+}
+
+bool BufferPool::InsertLargeHeader(BufferHeader* header) {
+    // the table is kept at most half full
+    if (2 * (large_headers_count_ + 1) > large_headers_capacity_) {
+        uint64_t new_capacity = std::max<uint64_t>(64, 2 * large_headers_capacity_);
+        BufferHeader** new_headers = static_cast<BufferHeader**>(std::calloc(new_capacity, sizeof(BufferHeader*)));
+
+        if (new_headers == nullptr) {
+            return false;
+        }
+
+        for (uint64_t i = 0; i < large_headers_capacity_; ++i) {
+            if (large_headers_[i] != nullptr) {
+                uint64_t slot = GetLargeHeaderSlot(large_headers_[i]->mapping, new_capacity);
+
+                while (new_headers[slot] != nullptr) {
+                    slot = (slot + 1) & (new_capacity - 1);
+                }
+
+                new_headers[slot] = large_headers_[i];
+            }
+        }
+
+        std::free(large_headers_);
+        large_headers_ = new_headers;
+        large_headers_capacity_ = new_capacity;
+    }
+
+    uint64_t slot = GetLargeHeaderSlot(header->mapping, large_headers_capacity_);
+
+    while (large_headers_[slot] != nullptr) {
+        slot = (slot + 1) & (large_headers_capacity_ - 1);
+    }
+
+    large_headers_[slot] = header;
+    ++large_headers_count_;
+
+    return true;
+}
+
+void BufferPool::EraseLargeHeader(const BufferHeader* header) {
+    uint64_t mask = large_headers_capacity_ - 1;
+    uint64_t slot = GetLargeHeaderSlot(header->mapping, large_headers_capacity_);
+
+    while (large_headers_[slot] != header) {
+        slot = (slot + 1) & mask;
+    }
+
+    large_headers_[slot] = nullptr;
+    --large_headers_count_;
+
+    // the rest of the probe sequence is inserted again, so no lookup stops at the emptied slot too early
+    for (uint64_t i = (slot + 1) & mask; large_headers_[i] != nullptr; i = (i + 1) & mask) {
+        BufferHeader* moved = large_headers_[i];
+        large_headers_[i] = nullptr;
+
+        uint64_t new_slot = GetLargeHeaderSlot(moved->mapping, large_headers_capacity_);
+
+        while (large_headers_[new_slot] != nullptr) {
+            new_slot = (new_slot + 1) & mask;
+        }
+
+        large_headers_[new_slot] = moved;
+    }
+}
+
+BufferPool::BufferHeader* BufferPool::GetHeader(const void* buffer) const {
+    // large buffers start on a huge page boundary, small ones rarely do and are not found in the table then
+    if (large_headers_count_ != 0 && reinterpret_cast<uintptr_t>(buffer) % kHugePageSize == 0) {
+        uint64_t slot = GetLargeHeaderSlot(buffer, large_headers_capacity_);
+
+        while (large_headers_[slot] != nullptr) {
+            if (large_headers_[slot]->mapping == buffer) {
+                return large_headers_[slot];
+            }
+
+            slot = (slot + 1) & (large_headers_capacity_ - 1);
+        }
+    }
+
+    return reinterpret_cast<BufferHeader*>(const_cast<char*>(static_cast<const char*>(buffer)) - kAlignment);
+}
+
+uint64_t BufferPool::GetCapacityFor(uint64_t byte_size) {
+    if (byte_size <= kAlignment) {
+        return kAlignment;
+    } else if (byte_size < kHugePageSize) {
+        return std::bit_ceil(byte_size);
+    }
+
+    return (byte_size + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+}
+
+uint8_t BufferPool::GetSmallClass(uint64_t capacity) {
+    // kAlignment == 2^6
+    return std::countr_zero(capacity) - 6;
+}
+
+uint64_t BufferPool::GetLargeHeaderSlot(const void* buffer, uint64_t table_capacity) {
+    // Fibonacci hashing of the huge page number, the table capacity is a power of two
+    uint64_t page = reinterpret_cast<uintptr_t>(buffer) / kHugePageSize;
+    return (page * 0x9E3779B97F4A7C15ULL) >> (64 - std::countr_zero(table_capacity));
+}
+
+char* BufferPool::GetBuffer(BufferHeader* header) {
+    return (header->mapping_byte_size == 0) ? reinterpret_cast<char*>(header) + kAlignment : header->mapping;
+}
+
+uint64_t BufferPool::GetFootprint(const BufferHeader* header) {
+    return (header->mapping_byte_size == 0) ? header->capacity + kAlignment : header->mapping_byte_size;
+}
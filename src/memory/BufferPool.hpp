@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+
+enum HugePagesMode {
+    kNoHugePages = 0,
+    kTransparentHugePages = 1,
+    kExplicitHugePages = 2
+};
+
+struct BufferPoolStats {
+    uint64_t allocations = 0;
+    uint64_t reused_allocations = 0;
+
+    /** Memory taken from the system for all buffers and their headers, including cached free ones */
+    uint64_t reserved_byte_size = 0;
+    uint64_t used_byte_size = 0;
+    uint64_t peak_used_byte_size = 0;
+};
+
+/**
+ * Process-wide pool of 64-byte aligned buffers.
+ *
+ * Released buffers are cached and handed out again for requests of a similar size,
+ * so frame buffers, grids and paths don't go to the system allocator on every snapshot or grid expansion.
+ * Small buffers are rounded up to a power of two, large ones to a multiple of kHugePageSize
+ * and are mapped separately, backed by huge pages if possible. Headers of large buffers are kept in a side table,
+ * so the mapping holds nothing but the buffer.
+ *
+ * With a memory limit, free buffers are returned to the system instead of being cached once the reserved memory
+ * exceeds it, and users of large buffers check GetAvailableByteSize() to switch to more compact representations
+ * instead of going over the limit (the pool itself never refuses an allocation because of it).
+ * Thread-safe.
+ */
+class BufferPool {
+public:
+    static const uint64_t kAlignment = 64;
+    static const uint64_t kHugePageSize = 2 << 20;
+    static const uint64_t kMaxCachedByteSize = 256 << 20;
+
+    static BufferPool& GetInstance();
+
+    BufferPool(const BufferPool& other) = delete;
+    BufferPool& operator=(const BufferPool& other) = delete;
+
+    /** @return Uninitialized buffer of at least %byte_size% bytes, nullptr if out of memory */
+    void* Allocate(uint64_t byte_size);
+
+    template<typename T>
+    T* Allocate(uint64_t count) {
+        return static_cast<T*>(Allocate(count * sizeof(T)));
+    }
+
+    /** Returns the buffer to the pool. nullptr is ignored */
+    void Release(void* buffer);
+
+    /** @return Actual size of the buffer, which may be larger than requested */
+    static uint64_t GetCapacity(const void* buffer);
+
+    /** @return Capacity of a buffer allocated for %byte_size% bytes, so it can be checked against the memory limit */
+    static uint64_t GetCapacityFor(uint64_t byte_size);
+
+    void SetHugePagesMode(HugePagesMode mode);
+
+    /** Sets the limit of the used memory in bytes. If zero, there is no limit */
+    void SetMemoryLimit(uint64_t byte_size);
+    uint64_t GetMemoryLimit() const;
+
+    /** @return Amount of memory which may be used without exceeding the limit, UINT64_MAX if there is no limit */
+    uint64_t GetAvailableByteSize() const;
+
+    BufferPoolStats GetStats() const;
+
+    /** Starts measuring the peak usage from the current usage */
+    void ResetPeakUsage();
+
+    /** Returns all cached free buffers to the system */
+    void Trim();
+
+private:
+    BufferPool() = default;
+    ~BufferPool();
+
+    // stored in the kAlignment bytes before each small buffer, allocated separately for large ones
+    struct BufferHeader {
+        uint64_t capacity;
+        uint64_t mapping_byte_size;
+        BufferHeader* next_free;
+        char* mapping;
+    };
+
+    static const uint8_t kSmallClassesCount = 16; // from kAlignment to kHugePageSize / 2
+
+    BufferHeader* small_free_lists_[kSmallClassesCount] = {};
+    BufferHeader* large_free_list_ = nullptr;
+
+    // open addressing table of the headers of all large buffers, keyed by the buffer address
+    BufferHeader** large_headers_ = nullptr;
+    uint64_t large_headers_capacity_ = 0;
+    uint64_t large_headers_count_ = 0;
+
+    HugePagesMode huge_pages_mode_ = kTransparentHugePages;
+    uint64_t cached_byte_size_ = 0;
+    uint64_t memory_limit_ = 0;
+
+    BufferPoolStats stats_;
+    mutable std::mutex mutex_;
+
+    BufferHeader* TakeCached(uint64_t capacity);
+    BufferHeader* AllocateSmall(uint64_t capacity);
+    BufferHeader* AllocateLarge(uint64_t capacity);
+    void Free(BufferHeader* header);
+
+    /** Returns all cached free buffers to the system, the mutex has to be locked */
+    void FreeCached();
+
+    bool InsertLargeHeader(BufferHeader* header);
+    void EraseLargeHeader(const BufferHeader* header);
+
+    /** @return Header of the buffer, the mutex has to be locked */
+    BufferHeader* GetHeader(const void* buffer) const;
+
+    static uint8_t GetSmallClass(uint64_t capacity);
+    static uint64_t GetLargeHeaderSlot(const void* buffer, uint64_t table_capacity);
+    static char* GetBuffer(BufferHeader* header);
+
+    /** @return Memory taken from the system for the buffer and its header */
+    static uint64_t GetFootprint(const BufferHeader* header);
+};
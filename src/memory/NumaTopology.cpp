@@ -0,0 +1,116 @@
+#include "memory/NumaTopology.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const char* kNodesDirectory = "/sys/devices/system/node/node";
+
+// "0-3,8,10-11"
+void ParseCpuList(const std::string& list, uint8_t node, uint8_t* cpu_nodes) {
+    size_t position = 0;
+
+    while (position < list.size()) {
+        size_t end;
+        uint64_t first = std::stoul(list.substr(position), &end);
+        uint64_t last = first;
+        position += end;
+
+        if (position < list.size() && list[position] == '-') {
+            last = std::stoul(list.substr(position + 1), &end);
+            position += end + 1;
+        }
+
+        for (uint64_t cpu = first; cpu <= last && cpu < NumaTopology::kMaxCpusCount; ++cpu) {
+            cpu_nodes[cpu] = node;
+        }
+
+        ++position;
+    }
+}
+
+const NumaTopology& NumaTopology::GetInstance() {
+    static NumaTopology instance;
+    return instance;
+}
+
+NumaTopology::NumaTopology() {
+    CPU_ZERO(&allowed_cpus_);
+
+    if (sched_getaffinity(0, sizeof(allowed_cpus_), &allowed_cpus_) != 0) {
+        for (uint32_t cpu = 0; cpu < kMaxCpusCount; ++cpu) {
+            CPU_SET(cpu, &allowed_cpus_);
+        }
+    }
+
+    for (uint32_t node = 0; node < kMaxNodesCount; ++node) {
+        std::ifstream file{kNodesDirectory + std::to_string(node) + "/cpulist"};
+        std::string list;
+
+        if (!file.is_open()) {
+            break;
+        }
+
+        // a node without CPUs has an empty list
+        if (std::getline(file, list) && !list.empty()) {
+            try {
+                ParseCpuList(list, node, cpu_nodes_);
+            } catch (...) {
+                break;
+            }
+        }
+
+        nodes_count_ = node + 1;
+    }
+
+    for (uint32_t node = 0; node < nodes_count_; ++node) {
+        for (uint32_t cpu = 0; cpu < kMaxCpusCount; ++cpu) {
+            if (cpu_nodes_[cpu] == node && CPU_ISSET(cpu, &allowed_cpus_)) {
+                ordered_cpus_[ordered_cpus_count_++] = cpu;
+            }
+        }
+    }
+}
+
+uint32_t NumaTopology::GetNodesCount() const {
+    return nodes_count_;
+}
+
+uint32_t NumaTopology::GetCurrentNode() const {
+    int cpu = sched_getcpu();
+
+    return (cpu >= 0 && static_cast<uint32_t>(cpu) < kMaxCpusCount) ? cpu_nodes_[cpu] : 0;
+}
+
+void NumaTopology::GetMemoryNodes(const void* const* addresses, uint32_t count, int32_t* nodes) const {
+    // without target nodes move_pages only reports where the pages are
+    if (syscall(SYS_move_pages, 0, count, addresses, nullptr, nodes, 0) != 0) {
+        std::fill(nodes, nodes + count, -1);
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (nodes[i] < 0) {
+            nodes[i] = -1;
+        }
+    }
+}
+
+bool NumaTopology::PinCurrentThread(uint32_t thread, uint32_t threads_count) const {
+    if (ordered_cpus_count_ == 0) {
+        return false;
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(ordered_cpus_[static_cast<uint64_t>(thread) * ordered_cpus_count_ / threads_count], &cpus);
+
+    return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+}
+
+void NumaTopology::UnpinCurrentThread() const {
+    (void)sched_setaffinity(0, sizeof(allowed_cpus_), &allowed_cpus_);
+}
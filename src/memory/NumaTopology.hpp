@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+#include <sched.h>
+
+enum NumaPolicy {
+    kNoNumaPolicy = 0,
+    kNumaFirstTouch = 1,
+    kNumaPinned = 2
+};
+
+/**
+ * NUMA nodes of the machine, read from /sys/devices/system/node once.
+ *
+ * Memory is placed on the node of the thread which first touches its pages (the default Linux policy),
+ * so large buffers are filled by the threads which work on them afterwards. Threads are pinned to the CPUs
+ * the process is allowed to run on, spread evenly over them in the order of nodes, so consecutive threads
+ * share a node. Without the NUMA information in sysfs all CPUs belong to node 0
+ */
+class NumaTopology {
+public:
+    // nodes and CPUs with larger indices are ignored
+    static const uint32_t kMaxNodesCount = 64;
+    static const uint32_t kMaxCpusCount = CPU_SETSIZE;
+
+    static const NumaTopology& GetInstance();
+
+    NumaTopology(const NumaTopology& other) = delete;
+    NumaTopology& operator=(const NumaTopology& other) = delete;
+
+    uint32_t GetNodesCount() const;
+
+    /** @return Node of the CPU the calling thread is running on */
+    uint32_t GetCurrentNode() const;
+
+    /**
+     * Gets the nodes of the pages holding %addresses%, which have to be touched already.
+     * A node is -1 if it's unknown (including the kernels without NUMA support)
+     */
+    void GetMemoryNodes(const void* const* addresses, uint32_t count, int32_t* nodes) const;
+
+    /** Pins the calling thread, which is the %thread%-th of %threads_count%, to one of the allowed CPUs */
+    bool PinCurrentThread(uint32_t thread, uint32_t threads_count) const;
+
+    /** Lets the calling thread run on all allowed CPUs again */
+    void UnpinCurrentThread() const;
+
+private:
+    NumaTopology();
+
+    uint32_t nodes_count_ = 1;
+    uint8_t cpu_nodes_[kMaxCpusCount] = {};
+
+    // CPUs the process was started on, ordered by nodes
+    cpu_set_t allowed_cpus_;
+    uint32_t ordered_cpus_[kMaxCpusCount] = {};
+    uint32_t ordered_cpus_count_ = 0;
+};
@@ -0,0 +1,83 @@
+#include "model/ActivityMap.hpp"
+#include "memory/BufferPool.hpp"
+
+#include <algorithm>
+#include <limits>
+
+ActivityMap::ActivityMap(uint64_t threshold) : threshold_(threshold) {
+    tile_rows_ = BufferPool::GetInstance().Allocate<uint16_t*>(kTilesPerSide);
+    std::fill(tile_rows_, tile_rows_ + kTilesPerSide, nullptr);
+}
+
+ActivityMap::~ActivityMap() {
+    for (uint32_t tile_y = 0; tile_y < kTilesPerSide; ++tile_y) {
+        BufferPool::GetInstance().Release(tile_rows_[tile_y]);
+    }
+
+    BufferPool::GetInstance().Release(tile_rows_);
+}
+
+void ActivityMap::Reserve(int16_t min_y, int16_t max_y) {
+    for (uint32_t tile_y = GetTileIndex(min_y); tile_y <= GetTileIndex(max_y); ++tile_y) {
+        if (tile_rows_[tile_y] == nullptr) {
+            tile_rows_[tile_y] = BufferPool::GetInstance().Allocate<uint16_t>(kTilesPerSide);
+            std::fill(tile_rows_[tile_y], tile_rows_[tile_y] + kTilesPerSide, 0);
+        }
+    }
+}
+
+uint16_t ActivityMap::GetTile(uint32_t tile_x, uint32_t tile_y) const {
+    return (tile_rows_[tile_y] == nullptr) ? 0 : tile_rows_[tile_y][tile_x];
+}
+
+bool ActivityMap::IsTileUnstable(uint32_t tile_x, uint32_t tile_y) const {
+    return (GetTile(tile_x, tile_y) & kUnstableCellsMask) != 0;
+}
+
+bool ActivityMap::IsTileDirty(uint32_t tile_x, uint32_t tile_y) const {
+    return (GetTile(tile_x, tile_y) & kDirtyBit) != 0;
+}
+
+bool ActivityMap::IsStable() const {
+    return unstable_cells_count_ == 0;
+}
+
+uint64_t ActivityMap::GetUnstableCellsCount() const {
+    return unstable_cells_count_;
+}
+
+void ActivityMap::AddUnstableCells(int64_t delta) {
+    unstable_cells_count_ += delta;
+}
+
+void ActivityMap::ClearDirty() {
+    for (uint32_t tile_y = 0; tile_y < kTilesPerSide; ++tile_y) {
+        uint16_t* row = tile_rows_[tile_y];
+
+        if (row == nullptr) {
+            continue;
+        }
+
+        for (uint32_t tile_x = 0; tile_x < kTilesPerSide; ++tile_x) {
+            row[tile_x] &= kUnstableCellsMask;
+        }
+    }
+}
+
+void ActivityMap::Clear() {
+    for (uint32_t tile_y = 0; tile_y < kTilesPerSide; ++tile_y) {
+        if (tile_rows_[tile_y] != nullptr) {
+            std::fill(tile_rows_[tile_y], tile_rows_[tile_y] + kTilesPerSide, 0);
+        }
+    }
+
+    unstable_cells_count_ = 0;
+}
+
+uint64_t ActivityMap::GetThreshold() const {
+    return threshold_;
+}
+
+int32_t ActivityMap::GetTileStart(uint32_t tile_index) {
+    return static_cast<int32_t>(tile_index << kTileSizeLog) + std::numeric_limits<int16_t>::min();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Tile-level bookkeeping of the grid activity.
+ *
+ * The whole int16_t coordinate plane is split into square tiles of kTileSize cells.
+ * For each tile the map stores the number of unstable cells (cells with at least
+ * %threshold% grains of sand) and a dirty bit which is set every time any cell of the tile changes.
+ * Dirty bits are kept until ClearDirty() is called.
+ * Rows of tiles are allocated from BufferPool only when the grid reaches them (see Reserve()),
+ * tiles of other rows are neither unstable nor dirty.
+ */
+class ActivityMap {
+public:
+    static const uint8_t kTileSizeLog = 6;
+    static const uint32_t kTileSize = 1u << kTileSizeLog;
+    static const uint32_t kTilesPerSide = (1u << 16) >> kTileSizeLog;
+    static const uint64_t kTilesCount = static_cast<uint64_t>(kTilesPerSide) * kTilesPerSide;
+
+    explicit ActivityMap(uint64_t threshold);
+
+    ~ActivityMap();
+    ActivityMap(const ActivityMap& other) = delete;
+    ActivityMap& operator=(const ActivityMap& other) = delete;
+
+    /** Allocates the rows of tiles containing the cells from %min_y% to %max_y%. Cells of other rows can't be updated */
+    void Reserve(int16_t min_y, int16_t max_y);
+
+    /** Has to be called on every change of the cell (x, y) */
+    void Update(int16_t x, int16_t y, uint64_t old_sand, uint64_t new_sand);
+
+    /**
+     * Applies changes of several cells of the tile at once, %unstable_delta% is the change of the amount of its unstable cells.
+     * Unlike Update(), doesn't change the total amount of unstable cells, so different tiles can be updated
+     * concurrently, and the total is corrected later by AddUnstableCells()
+     */
+    void UpdateTile(uint32_t tile_x, uint32_t tile_y, int32_t unstable_delta, bool is_changed);
+    void AddUnstableCells(int64_t delta);
+
+    bool IsTileUnstable(uint32_t tile_x, uint32_t tile_y) const;
+    bool IsTileDirty(uint32_t tile_x, uint32_t tile_y) const;
+
+    /** Checks if there are no unstable cells in O(1) */
+    bool IsStable() const;
+    uint64_t GetUnstableCellsCount() const;
+
+    void ClearDirty();
+    void Clear();
+
+    uint64_t GetThreshold() const;
+
+    static uint32_t GetTileIndex(int16_t coordinate);
+    static int32_t GetTileStart(uint32_t tile_index);
+
+private:
+    // The lower bits of each tile keep the amount of its unstable cells, which is at most kTileSize^2,
+    // and the highest bit is the dirty one. Neighbouring tiles don't share words, so they can be updated concurrently
+    uint16_t** tile_rows_ = nullptr;
+
+    uint64_t unstable_cells_count_ = 0;
+    uint64_t threshold_;
+
+    static const uint16_t kDirtyBit = 1u << 15;
+    static const uint16_t kUnstableCellsMask = kDirtyBit - 1;
+
+    uint16_t GetTile(uint32_t tile_x, uint32_t tile_y) const;
+};
+
+inline void ActivityMap::Update(int16_t x, int16_t y, uint64_t old_sand, uint64_t new_sand) {
+    uint16_t& tile = tile_rows_[GetTileIndex(y)][GetTileIndex(x)];
+
+    // branchless, since it is called for every change of the grid
+    int32_t unstable_delta = static_cast<int32_t>(new_sand >= threshold_) - static_cast<int32_t>(old_sand >= threshold_);
+    tile = static_cast<uint16_t>((tile + unstable_delta) | (static_cast<uint32_t>(old_sand != new_sand) << 15));
+    unstable_cells_count_ += unstable_delta;
+}
+
+inline void ActivityMap::UpdateTile(uint32_t tile_x, uint32_t tile_y, int32_t unstable_delta, bool is_changed) {
+    uint16_t& tile = tile_rows_[tile_y][tile_x];
+    tile = static_cast<uint16_t>((tile + unstable_delta) | (static_cast<uint32_t>(is_changed) << 15));
+}
+
+inline uint32_t ActivityMap::GetTileIndex(int16_t coordinate) {
+    return static_cast<uint32_t>(static_cast<int32_t>(coordinate) + (1 << 15)) >> kTileSizeLog;
+}
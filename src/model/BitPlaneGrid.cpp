@@ -0,0 +1,199 @@
+#include "model/BitPlaneGrid.hpp"
+#include "memory/BufferPool.hpp"
+
+#include <algorithm>
+#include <bit>
+
+const uint32_t kBitsPerWord = 64;
+
+BitPlaneGrid::~BitPlaneGrid() {
+    Release();
+}
+
+void BitPlaneGrid::Release() {
+    BufferPool::GetInstance().Release(words_);
+    BufferPool::GetInstance().Release(toppled_);
+    BufferPool::GetInstance().Release(previous_toppled_);
+
+    words_ = nullptr;
+    toppled_ = nullptr;
+    previous_toppled_ = nullptr;
+}
+
+BitPlaneGrid::HeightWord* BitPlaneGrid::GetRow(uint32_t y) const {
+    return words_ + static_cast<uint64_t>(y) * words_per_row_;
+}
+
+void BitPlaneGrid::Load(Grid& grid, uint64_t sweeps_count) {
+    Release();
+
+    // the sand spreads by at most one cell per sweep; one more word and row on each side
+    // are visited by a sweep without ever getting sand
+    uint64_t margin = sweeps_count + 1;
+    uint32_t margin_words = (margin + kBitsPerWord - 1) / kBitsPerWord + 1;
+    uint32_t margin_rows = margin + 1;
+
+    words_per_row_ = margin_words + (grid.GetWidth() + margin + kBitsPerWord - 1) / kBitsPerWord + 1;
+    rows_count_ = grid.GetHeight() + 2 * margin_rows;
+
+    origin_x_ = grid.GetMinX() - static_cast<int32_t>(margin_words * kBitsPerWord);
+    origin_y_ = grid.GetMinY() - static_cast<int32_t>(margin_rows);
+
+    min_x_ = grid.GetMinX() - origin_x_;
+    min_y_ = grid.GetMinY() - origin_y_;
+    max_x_ = grid.GetMaxX() - origin_x_;
+    max_y_ = grid.GetMaxY() - origin_y_;
+
+    uint64_t words_count = static_cast<uint64_t>(rows_count_) * words_per_row_;
+    words_ = BufferPool::GetInstance().Allocate<HeightWord>(words_count);
+    toppled_ = BufferPool::GetInstance().Allocate<uint64_t>(words_per_row_);
+    previous_toppled_ = BufferPool::GetInstance().Allocate<uint64_t>(words_per_row_);
+
+    std::fill(words_, words_ + words_count, HeightWord{});
+
+    for (uint32_t y = min_y_; y <= max_y_; ++y) {
+        const uint64_t* cells = grid.GetRowCells(origin_y_ + y);
+        HeightWord* row = GetRow(y);
+
+        for (uint32_t x = min_x_; x <= max_x_; ++x) {
+            uint64_t sand = cells[x - min_x_];
+            HeightWord& word = row[x / kBitsPerWord];
+            uint32_t bit = x % kBitsPerWord;
+
+            for (uint8_t plane = 0; plane < kPlanesCount; ++plane) {
+                word.planes[plane] |= ((sand >> plane) & 1) << bit;
+            }
+        }
+    }
+}
+
+uint64_t BitPlaneGrid::Sweep(EventLogWriter* event_log, uint64_t iteration_index) {
+    uint32_t first_word = min_x_ / kBitsPerWord - 1;
+    uint32_t last_word = max_x_ / kBitsPerWord + 1;
+
+    std::fill(previous_toppled_ + first_word, previous_toppled_ + last_word + 1, 0);
+
+    uint64_t topplings_count = 0;
+    int64_t toppled_min_x = INT64_MAX;
+    int64_t toppled_max_x = -1;
+    int64_t toppled_min_y = INT64_MAX;
+    int64_t toppled_max_y = -1;
+
+    // the row below the last one only gets sand from above
+    for (uint32_t y = min_y_; y <= max_y_ + 1; ++y) {
+        HeightWord* row = GetRow(y);
+        HeightWord* upper_row = GetRow(y - 1);
+        uint64_t carry = 0;
+
+        for (uint32_t w = first_word; w <= last_word; ++w) {
+            const uint64_t* height = row[w].planes;
+            uint64_t from_above = previous_toppled_[w];
+
+            // height with the grain from above, only whether it's 3 or at least 4 matters
+            uint64_t bit0 = height[0] ^ from_above;
+            uint64_t bit_carry = height[0] & from_above;
+            uint64_t bit1 = height[1] ^ bit_carry;
+            bit_carry &= height[1];
+            uint64_t bit2 = height[2] ^ bit_carry;
+            uint64_t bit3 = height[2] & bit_carry;
+
+            uint64_t generate = bit2 | bit3;
+            uint64_t propagate = ~bit3 & ~bit2 & bit1 & bit0;
+
+            // the carry of chain + generate passes through a propagating cell exactly when its left neighbour topples
+            uint64_t chain = generate | propagate;
+            uint64_t sum = chain + generate;
+            uint64_t carry_out = (sum < chain);
+            uint64_t carried_sum = sum + carry;
+            carry_out |= (carried_sum < sum);
+
+            toppled_[w] = generate | (propagate & ~carried_sum);
+            carry = carry_out;
+        }
+
+        bool is_row_toppled = false;
+
+        for (uint32_t w = first_word; w <= last_word; ++w) {
+            uint64_t toppled = toppled_[w];
+            uint64_t from_left = (toppled << 1) | ((w > first_word) ? toppled_[w - 1] >> 63 : 0);
+            uint64_t from_right = (toppled >> 1) | ((w < last_word) ? toppled_[w + 1] << 63 : 0);
+            uint64_t from_above = previous_toppled_[w];
+
+            // height + grains from above, left and right - 4 * toppled, the result is below 8
+            uint64_t* height = row[w].planes;
+            uint64_t grains0 = from_above ^ from_left ^ from_right;
+            uint64_t grains1 = (from_above & from_left) | (from_above & from_right) | (from_left & from_right);
+
+            uint64_t carry0 = height[0] & grains0;
+            uint64_t carry1 = (height[1] & grains1) | (height[1] & carry0) | (grains1 & carry0);
+
+            height[0] ^= grains0;
+            height[1] ^= grains1 ^ carry0;
+            height[2] ^= carry1 ^ toppled;
+
+            // the grain to the row above, which is already done
+            uint64_t* upper_height = upper_row[w].planes;
+            uint64_t upper_carry0 = upper_height[0] & toppled;
+            uint64_t upper_carry1 = upper_height[1] & upper_carry0;
+
+            upper_height[0] ^= toppled;
+            upper_height[1] ^= upper_carry0;
+            upper_height[2] ^= upper_carry1;
+
+            if (toppled != 0) {
+                is_row_toppled = true;
+                topplings_count += std::popcount(toppled);
+
+                toppled_min_x = std::min<int64_t>(toppled_min_x, w * kBitsPerWord + std::countr_zero(toppled));
+                toppled_max_x = std::max<int64_t>(toppled_max_x, w * kBitsPerWord + kBitsPerWord - 1 - std::countl_zero(toppled));
+            }
+        }
+
+        if (is_row_toppled) {
+            toppled_min_y = std::min<int64_t>(toppled_min_y, y);
+            toppled_max_y = y;
+
+            if (event_log != nullptr) {
+                event_log->AddToppledRow(iteration_index, origin_y_ + static_cast<int32_t>(y),
+                    origin_x_ + static_cast<int32_t>(first_word * kBitsPerWord), toppled_ + first_word, last_word - first_word + 1);
+            }
+        }
+
+        std::swap(toppled_, previous_toppled_);
+    }
+
+    // neighbours of the toppled cells got sand
+    if (topplings_count != 0) {
+        min_x_ = std::min<int64_t>(min_x_, toppled_min_x - 1);
+        max_x_ = std::max<int64_t>(max_x_, toppled_max_x + 1);
+        min_y_ = std::min<int64_t>(min_y_, toppled_min_y - 1);
+        max_y_ = std::max<int64_t>(max_y_, toppled_max_y + 1);
+    }
+
+    return topplings_count;
+}
+
+void BitPlaneGrid::Store(Grid& grid) const {
+    grid.AddSand(origin_x_ + min_x_, origin_y_ + min_y_, 0);
+    grid.AddSand(origin_x_ + max_x_, origin_y_ + max_y_, 0);
+
+    for (uint32_t y = min_y_; y <= max_y_; ++y) {
+        const uint64_t* cells = grid.GetRowCells(origin_y_ + y);
+        const HeightWord* row = GetRow(y);
+
+        for (uint32_t x = min_x_; x <= max_x_; ++x) {
+            const HeightWord& word = row[x / kBitsPerWord];
+            uint32_t bit = x % kBitsPerWord;
+            uint64_t sand = 0;
+
+            for (uint8_t plane = 0; plane < kPlanesCount; ++plane) {
+                sand |= ((word.planes[plane] >> bit) & 1) << plane;
+            }
+
+            // unchanged cells are skipped, so the activity map only sees the changes
+            if (cells[origin_x_ + x - grid.GetMinX()] != sand) {
+                grid.SetSand(origin_x_ + x, origin_y_ + y, sand);
+            }
+        }
+    }
+}
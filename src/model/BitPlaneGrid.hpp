@@ -0,0 +1,73 @@
+#pragma once
+
+#include "model/Grid.hpp"
+#include "events/EventLogWriter.hpp"
+
+#include <cstdint>
+
+/**
+ * Rectangle of cells with heights up to kMaxHeight for the per-iteration mode of the standard model
+ * (a cell topples having 4 grains), stored as 3 bit planes of 64 cells per word.
+ *
+ * A sweep gives the same result as visiting the cells in the row-major order and toppling each cell
+ * which has at least 4 grains at the moment of the visit (see Sandpile::ToppleGrid), but processes 64 cells
+ * at once with bitwise operations. A cell topples if its height plus the grains from the cells above
+ * and to the left, which toppled earlier in the same sweep, is at least 4. Along a row it's a carry chain:
+ * a cell with 4 grains without the left neighbour generates the toppling, a cell with 3 propagates it,
+ * so a word of the row is resolved by a single addition.
+ *
+ * A sweep never makes the highest cell higher if it's above 4, so a grid with all heights up to kMaxHeight keeps them so.
+ * The rectangle has margins for the growth during the sweeps it's loaded for
+ */
+class BitPlaneGrid {
+public:
+    static const uint64_t kMaxHeight = 7;
+
+    BitPlaneGrid() = default;
+    ~BitPlaneGrid();
+
+    BitPlaneGrid(const BitPlaneGrid& other) = delete;
+    BitPlaneGrid& operator=(const BitPlaneGrid& other) = delete;
+
+    /**
+     * Loads the cells of %grid%, which must be not higher than kMaxHeight, with room for %sweeps_count% sweeps.
+     * The grid must be neither mapped nor shared
+     */
+    void Load(Grid& grid, uint64_t sweeps_count);
+
+    /**
+     * @return Amount of toppled cells. If %event_log% is not nullptr,
+     * the toppled cells are added to it as the %iteration_index%-th iteration of the recorded block
+     */
+    uint64_t Sweep(EventLogWriter* event_log = nullptr, uint64_t iteration_index = 0);
+
+    /** Writes the changed cells back to %grid%, which is expanded to all cells which got sand */
+    void Store(Grid& grid) const;
+
+private:
+    static const uint8_t kPlanesCount = 3;
+
+    struct HeightWord {
+        uint64_t planes[kPlanesCount];
+    };
+
+    // rows of words, the first cell of the rectangle is (origin_x_, origin_y_)
+    HeightWord* words_ = nullptr;
+    uint64_t* toppled_ = nullptr;
+    uint64_t* previous_toppled_ = nullptr;
+
+    uint32_t words_per_row_ = 0;
+    uint32_t rows_count_ = 0;
+
+    int32_t origin_x_ = 0;
+    int32_t origin_y_ = 0;
+
+    // bounds of the cells which may hold sand, relative to the origin
+    uint32_t min_x_ = 0;
+    uint32_t min_y_ = 0;
+    uint32_t max_x_ = 0;
+    uint32_t max_y_ = 0;
+
+    HeightWord* GetRow(uint32_t y) const;
+    void Release();
+};
@@ -0,0 +1,69 @@
+#include "model/GrainQueue.hpp"
+#include "memory/BufferPool.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <thread>
+
+GrainQueue::GrainQueue(uint32_t producers_count, uint32_t ring_capacity)
+    : producers_count_(producers_count),
+      ring_capacity_(std::bit_ceil(std::max<uint64_t>(ring_capacity, 1))) {
+    rings_ = new Ring[producers_count_];
+
+    for (uint32_t i = 0; i < producers_count_; ++i) {
+        rings_[i].grains = BufferPool::GetInstance().Allocate<Grain>(ring_capacity_);
+    }
+}
+
+GrainQueue::~GrainQueue() {
+    for (uint32_t i = 0; i < producers_count_; ++i) {
+        BufferPool::GetInstance().Release(rings_[i].grains);
+    }
+
+    delete[] rings_;
+}
+
+bool GrainQueue::Push(uint32_t producer, Grain grain) {
+    Ring& ring = rings_[producer];
+    uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+
+    // the consumer's position is only reloaded when the ring looks full
+    while (tail - ring.cached_head >= ring_capacity_) {
+        ring.cached_head = ring.head.load(std::memory_order_acquire);
+
+        if (tail - ring.cached_head < ring_capacity_) {
+            break;
+        } else if (is_cancelled_.load(std::memory_order_relaxed)) {
+            return false;
+        }
+
+        std::this_thread::yield();
+    }
+
+    ring.grains[tail & (ring_capacity_ - 1)] = grain;
+    ring.tail.store(tail + 1, std::memory_order_release);
+
+    return !is_cancelled_.load(std::memory_order_relaxed);
+}
+
+void GrainQueue::Finish(uint32_t producer) {
+    rings_[producer].is_finished.store(true, std::memory_order_release);
+}
+
+void GrainQueue::Cancel() {
+    is_cancelled_.store(true, std::memory_order_relaxed);
+}
+
+bool GrainQueue::IsFinished() const {
+    for (uint32_t i = 0; i < producers_count_; ++i) {
+        if (!rings_[i].is_finished.load(std::memory_order_acquire)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint32_t GrainQueue::GetProducersCount() const {
+    return producers_count_;
+}
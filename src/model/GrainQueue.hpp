@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+struct Grain {
+    int16_t x = 0;
+    int16_t y = 0;
+    uint64_t amount = 0;
+};
+
+/**
+ * Lock-free queue of grains added to the grid while the model runs.
+ *
+ * Each producer thread has its own single-producer ring buffer, so producers never contend
+ * with each other; the consumer (the thread running the model) drains all rings between batches of work.
+ * Grains of different producers are not ordered, which doesn't affect the result since the model is abelian
+ */
+class GrainQueue {
+public:
+    static const uint32_t kDefaultRingCapacity = 1 << 16;
+
+    /** @param ring_capacity Amount of grains each producer can push ahead of the consumer, rounded up to a power of 2 */
+    explicit GrainQueue(uint32_t producers_count, uint32_t ring_capacity = kDefaultRingCapacity);
+    ~GrainQueue();
+
+    GrainQueue(const GrainQueue& other) = delete;
+    GrainQueue& operator=(const GrainQueue& other) = delete;
+
+    /**
+     * Has to be called only from the thread of the producer %producer% (from 0 to producers count - 1).
+     * Waits while its ring is full.
+     * @return false if the queue was cancelled and the grain is dropped
+     */
+    bool Push(uint32_t producer, Grain grain);
+
+    /** Marks that the producer won't push anymore */
+    void Finish(uint32_t producer);
+
+    /** Makes all following and waiting pushes fail, e.g. when the model stops before the producers */
+    void Cancel();
+
+    /** @return true if all producers are finished. Grains pushed before that still have to be drained */
+    bool IsFinished() const;
+
+    /**
+     * Calls %consume% for each grain pushed so far. Has to be called only from the consumer thread
+     * @return Amount of drained grains
+     */
+    template<typename Consumer>
+    uint64_t Drain(const Consumer& consume);
+
+    uint32_t GetProducersCount() const;
+
+private:
+    // producer and consumer positions are kept on separate cache lines
+    struct Ring {
+        alignas(64) std::atomic<uint64_t> tail{0};
+        uint64_t cached_head = 0;
+        std::atomic<bool> is_finished{false};
+
+        alignas(64) std::atomic<uint64_t> head{0};
+
+        Grain* grains = nullptr;
+    };
+
+    Ring* rings_ = nullptr;
+    uint32_t producers_count_;
+    uint64_t ring_capacity_;
+
+    std::atomic<bool> is_cancelled_{false};
+};
+
+template<typename Consumer>
+uint64_t GrainQueue::Drain(const Consumer& consume) {
+    uint64_t drained = 0;
+
+    for (uint32_t i = 0; i < producers_count_; ++i) {
+        Ring& ring = rings_[i];
+
+        uint64_t head = ring.head.load(std::memory_order_relaxed);
+        uint64_t tail = ring.tail.load(std::memory_order_acquire);
+
+        for (; head != tail; ++head) {
+            consume(ring.grains[head & (ring_capacity_ - 1)]);
+            ++drained;
+        }
+
+        ring.head.store(head, std::memory_order_release);
+    }
+
+    return drained;
+}
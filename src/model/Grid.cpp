@@ -1,6 +1,8 @@
 #include "model/Grid.hpp"
+#include "memory/BufferPool.hpp"
 #include "parsing/utils.hpp"
 
+#include <algorithm>
 #include <cstddef>
 
 void Grid::Expand(uint32_t to_left, uint32_t to_top, uint32_t to_right, uint32_t to_bottom) {
@@ -10,17 +12,92 @@ void Grid::Expand(uint32_t to_left, uint32_t to_top, uint32_t to_right, uint32_t
 
     uint32_t new_width = width_ + to_left + to_right;
     uint32_t new_height = height_ + to_top + to_bottom;
+    uint64_t new_cells_count = static_cast<uint64_t>(new_width) * new_height;
 
-    uint64_t** new_sand = new uint64_t*[new_height];
+    if (cells_ != nullptr && new_cells_count * sizeof(uint64_t) <= BufferPool::GetCapacity(cells_)) {
+        ExpandInPlace(to_left, to_bottom, new_width, new_height);
+    } else {
+        Reallocate(to_left, to_top, to_right, to_bottom);
+    }
+
+    if (activity_map_ != nullptr) {
+        activity_map_->Reserve(GetMinY(), GetMaxY());
+    }
+}
+
+void Grid::Reallocate(uint32_t to_left, uint32_t to_top, uint32_t to_right, uint32_t to_bottom) {
+    uint32_t new_width = width_ + to_left + to_right;
+    uint32_t new_height = height_ + to_top + to_bottom;
+    uint64_t new_cells_count = static_cast<uint64_t>(new_width) * new_height;
+
+    MappedBuffer* new_mapped_sand = nullptr;
+    uint64_t* new_cells = nullptr;
+
+    // The old cells are still held while they're copied. Under the memory limit the grid takes
+    // not more than a half of the memory left, the rest is kept for saving the states
+    uint64_t available_byte_size = BufferPool::GetInstance().GetAvailableByteSize();
+    bool exceeds_budget = memory_budget_ != 0 && new_cells_count * sizeof(uint64_t) > memory_budget_;
+    bool exceeds_limit = scratch_directory_ != nullptr
+        && BufferPool::GetCapacityFor(new_cells_count * sizeof(uint64_t)) > available_byte_size / 2;
+
+    if (exceeds_budget || exceeds_limit) {
+        // under the memory limit only a half of the memory left is kept mapped
+        uint64_t resident_byte_size = exceeds_budget ? memory_budget_ : available_byte_size / 2;
+        new_mapped_sand = new MappedBuffer(scratch_directory_, new_width, new_height, resident_byte_size);
+
+        // if the scratch file can't be used, the grid stays in memory
+        if (!new_mapped_sand->IsMapped()) {
+            delete new_mapped_sand;
+            new_mapped_sand = nullptr;
+        }
+    }
+
+    if (new_mapped_sand == nullptr) {
+        // a quarter is reserved, so the next expansions don't need a new buffer, unless it doesn't fit into the memory limit
+        uint64_t reserved_cells_count = new_cells_count / 4;
+
+        if (BufferPool::GetCapacityFor((new_cells_count + reserved_cells_count) * sizeof(uint64_t)) > available_byte_size / 2) {
+            reserved_cells_count = 0;
+        }
+
+        new_cells = BufferPool::GetInstance().Allocate<uint64_t>(new_cells_count + reserved_cells_count);
+    }
+
+    uint64_t** new_sand = BufferPool::GetInstance().Allocate<uint64_t*>(new_height);
     for (size_t y = 0; y < new_height; ++y) {
-        new_sand[y] = new uint64_t[new_width];
-        std::fill(new_sand[y], new_sand[y] + new_width, 0);
+        new_sand[y] = (new_mapped_sand != nullptr) ? new_mapped_sand->GetRow(y) : new_cells + y * new_width;
     }
 
-    for (size_t y = to_bottom; y < height_ + to_bottom; ++y) {
-        for (size_t x = to_left; x < width_ + to_left; ++x) {
-            new_sand[y][x] = sand_[y - to_bottom][x - to_left];
+    auto fill_rows = [&](size_t first_row, size_t last_row) {
+        for (size_t y = first_row; y < last_row; ++y) {
+            bool has_old_row = y >= to_bottom && y < height_ + to_bottom;
+
+            // mapped file is already zero-filled
+            if (new_mapped_sand != nullptr) {
+                if (has_old_row) {
+                    new_mapped_sand->TouchRow(y);
+                }
+            } else {
+                std::fill(new_sand[y], new_sand[y] + new_width, 0);
+            }
+
+            if (has_old_row) {
+                uint64_t* row = GetRow(y - to_bottom);
+                std::copy(row, row + width_, new_sand[y] + to_left);
+            }
         }
+    };
+
+    // rows of mapped buffers are touched by a single thread
+    if (first_touch_scheduler_ != nullptr && new_mapped_sand == nullptr && mapped_sand_ == nullptr) {
+        uint32_t threads_count = first_touch_scheduler_->GetThreadsCount();
+
+        first_touch_scheduler_->RunOnEachThread([&](uint32_t thread) {
+            fill_rows(static_cast<uint64_t>(thread) * new_height / threads_count,
+                static_cast<uint64_t>(thread + 1) * new_height / threads_count);
+        });
+    } else {
+        fill_rows(0, new_height);
     }
 
     Reset();
@@ -28,14 +105,69 @@ void Grid::Expand(uint32_t to_left, uint32_t to_top, uint32_t to_right, uint32_t
     width_ = new_width;
     height_ = new_height;
     sand_ = new_sand;
+    cells_ = new_cells;
+    mapped_sand_ = new_mapped_sand;
 }
 
-uint64_t Grid::GetSand(int16_t x, int16_t y) const {
-    if (!HasCell(x, y)) {
-        return 0;
+void Grid::ExpandInPlace(uint32_t to_left, uint32_t to_bottom, uint32_t new_width, uint32_t new_height) {
+    // each cell moves to a position not less than its current one,
+    // so rows are moved starting from the last one
+    for (size_t y = height_; y-- > 0;) {
+        uint64_t* row = cells_ + y * width_;
+        std::copy_backward(row, row + width_, cells_ + (y + to_bottom) * new_width + to_left + width_);
+    }
+
+    for (size_t y = 0; y < new_height; ++y) {
+        uint64_t* row = cells_ + y * new_width;
+
+        if (y < to_bottom || y >= height_ + to_bottom) {
+            std::fill(row, row + new_width, 0);
+        } else {
+            std::fill(row, row + to_left, 0);
+            std::fill(row + to_left + width_, row + new_width, 0);
+        }
+    }
+
+    if (new_height != height_) {
+        BufferPool::GetInstance().Release(sand_);
+        sand_ = BufferPool::GetInstance().Allocate<uint64_t*>(new_height);
     }
 
-    return sand_[y - min_y_][x - min_x_];
+    for (size_t y = 0; y < new_height; ++y) {
+        sand_[y] = cells_ + y * new_width;
+    }
+
+    width_ = new_width;
+    height_ = new_height;
+}
+
+void Grid::SetFirstTouchScheduler(WorkStealingScheduler* scheduler) {
+    first_touch_scheduler_ = scheduler;
+
+    if (scheduler != nullptr && !IsEmpty() && !is_shared_ && mapped_sand_ == nullptr) {
+        Reallocate(0, 0, 0, 0);
+    }
+}
+
+uint64_t* Grid::GetRow(uint32_t y) const {
+    if (mapped_sand_ != nullptr) {
+        mapped_sand_->TouchRow(y);
+    }
+
+    return sand_[y];
+}
+
+void Grid::TouchRows(int16_t min_y, int16_t max_y) const {
+    if (mapped_sand_ == nullptr) {
+        return;
+    }
+
+    int32_t from_y = std::max<int32_t>(min_y, min_y_);
+    int32_t to_y = std::min<int32_t>(max_y, GetMaxY());
+
+    for (int32_t y = from_y; y <= to_y; ++y) {
+        mapped_sand_->TouchRow(y - min_y_);
+    }
 }
 
 bool Grid::IsEmpty() const {
@@ -43,6 +175,12 @@ bool Grid::IsEmpty() const {
 }
 
 void Grid::SetSand(int16_t x, int16_t y, uint64_t sand) {
+    if (is_bounded_ && !HasCell(x, y)) {
+        return;
+    } else if (is_shared_) {
+        PrepareWrite(x, y);
+    }
+
     if (IsEmpty()) {
         min_x_ = x;
         min_y_ = y;
@@ -76,28 +214,14 @@ void Grid::SetSand(int16_t x, int16_t y, uint64_t sand) {
     }
     
     Expand(to_left, to_top, to_right, to_bottom);
-    sand_[y][x] = sand;
-}
-
-void Grid::AddSand(int16_t x, int16_t y, uint64_t sand) {
-    SetSand(x, y, GetSand(x, y) + sand);
-}
 
-void Grid::RemoveSand(int16_t x, int16_t y, uint64_t sand) {
-    if (GetSand(x, y) < sand) {
-        SetSand(x, y, 0);
-    } else {
-        SetSand(x, y, GetSand(x, y) - sand);
-    }
-}
+    uint64_t* row = GetRow(y);
 
-bool Grid::HasCell(int16_t x, int16_t y) const {
-    if (IsEmpty()) {
-        return false;
+    if (activity_map_ != nullptr) {
+        activity_map_->Update(x + min_x_, y + min_y_, row[x], sand);
     }
 
-    return (x >= min_x_ && x < min_x_ + static_cast<int64_t>(width_)) 
-        && (y >= min_y_ && y < min_y_ + static_cast<int64_t>(height_));
+    row[x] = sand;
 }
 
 Grid& Grid::operator=(const Grid& other) {
@@ -105,49 +229,371 @@ Grid& Grid::operator=(const Grid& other) {
         return *this;
     }
 
-    uint64_t** new_sand = new uint64_t*[other.height_];
-    for (size_t y = 0; y < other.height_; ++y) {
-        new_sand[y] = new uint64_t[other.width_];
-        std::copy(other.sand_[y], other.sand_[y] + other.width_, new_sand[y]);
-    }
-
+    // %other% may be a snapshot of this grid, so it has to stop depending on it first
+    DetachSnapshots();
+    ReleaseSnapshot();
     Reset();
 
-    sand_ = new_sand;
-    width_ = other.width_;
-    height_ = other.height_;
-    min_x_ = other.min_x_;
-    min_y_ = other.min_y_;
+    TakeSnapshotOf(other);
+    RebuildActivityMap();
 
     return *this;
 }
 
 Grid::Grid(const Grid& other) {
-    uint64_t** new_sand = new uint64_t*[other.height_];
-    for (size_t y = 0; y < other.height_; ++y) {
-        new_sand[y] = new uint64_t[other.width_];
-        std::copy(other.sand_[y], other.sand_[y] + other.width_, new_sand[y]);
-    }
+    TakeSnapshotOf(other);
+}
 
-    sand_ = new_sand;
+void Grid::TakeSnapshotOf(const Grid& other) {
+    is_bounded_ = other.is_bounded_;
     width_ = other.width_;
     height_ = other.height_;
     min_x_ = other.min_x_;
     min_y_ = other.min_y_;
+
+    if (IsEmpty()) {
+        return;
+    }
+
+    snapshot_first_tile_x_ = ActivityMap::GetTileIndex(GetMinX());
+    snapshot_first_tile_y_ = ActivityMap::GetTileIndex(GetMinY());
+    snapshot_tiles_width_ = ActivityMap::GetTileIndex(GetMaxX()) - snapshot_first_tile_x_ + 1;
+    snapshot_tiles_height_ = ActivityMap::GetTileIndex(GetMaxY()) - snapshot_first_tile_y_ + 1;
+
+    uint64_t tiles_count = static_cast<uint64_t>(snapshot_tiles_width_) * snapshot_tiles_height_;
+    snapshot_tiles_ = BufferPool::GetInstance().Allocate<SharedTile*>(tiles_count);
+    is_shared_ = true;
+
+    if (other.snapshot_tiles_ != nullptr) {
+        // a snapshot of a snapshot shares its source and cloned tiles
+        snapshot_source_ = other.snapshot_source_;
+
+        for (uint64_t i = 0; i < tiles_count; ++i) {
+            snapshot_tiles_[i] = other.snapshot_tiles_[i];
+
+            if (snapshot_tiles_[i] != nullptr) {
+                ++snapshot_tiles_[i]->references;
+            }
+        }
+    } else {
+        snapshot_source_ = &other;
+        std::fill(snapshot_tiles_, snapshot_tiles_ + tiles_count, nullptr);
+
+        other.ShareTiles(snapshot_first_tile_x_, snapshot_first_tile_y_, snapshot_tiles_width_, snapshot_tiles_height_);
+    }
+
+    if (snapshot_source_ != nullptr) {
+        snapshot_source_->AddSnapshot(this);
+    }
 }
 
-void Grid::Reset() {
+void Grid::PrepareWrite(int16_t x, int16_t y) {
+    if (snapshot_tiles_ != nullptr) {
+        Materialize();
+    }
+
+    if (snapshots_count_ != 0 && HasCell(x, y)) {
+        PreserveTile(ActivityMap::GetTileIndex(x), ActivityMap::GetTileIndex(y));
+    }
+}
+
+void Grid::PreserveTile(uint32_t tile_x, uint32_t tile_y) const {
+    uint64_t tile = GetSharedTileIndex(tile_x, tile_y);
+    uint64_t tile_bit = uint64_t{1} << (tile % 64);
+
+    if (tile == UINT64_MAX || (shared_tiles_[tile / 64] & tile_bit) == 0) {
+        return;
+    }
+
+    shared_tiles_[tile / 64] &= ~tile_bit;
+
+    // one clone is shared by all snapshots taken since the tile last changed
+    SharedTile* clone = nullptr;
+
+    for (uint32_t i = 0; i < snapshots_count_; ++i) {
+        Grid* snapshot = snapshots_[i];
+
+        if (!snapshot->HasSnapshotTile(tile_x, tile_y) || snapshot->GetSnapshotTile(tile_x, tile_y) != nullptr) {
+            continue;
+        }
+
+        if (clone == nullptr) {
+            clone = CloneTile(tile_x, tile_y);
+        }
+
+        ++clone->references;
+        snapshot->GetSnapshotTile(tile_x, tile_y) = clone;
+    }
+}
+
+Grid::SharedTile* Grid::CloneTile(uint32_t tile_x, uint32_t tile_y) const {
+    SharedTile* clone = static_cast<SharedTile*>(BufferPool::GetInstance().Allocate(sizeof(SharedTile)));
+    clone->references = 0;
+    std::fill(clone->cells, clone->cells + ActivityMap::kTileSize * ActivityMap::kTileSize, 0);
+
+    int32_t tile_start_x = ActivityMap::GetTileStart(tile_x);
+    int32_t tile_start_y = ActivityMap::GetTileStart(tile_y);
+
+    int32_t from_x = std::max<int32_t>(GetMinX(), tile_start_x);
+    int32_t to_x = std::min<int32_t>(GetMaxX(), tile_start_x + ActivityMap::kTileSize - 1);
+    int32_t from_y = std::max<int32_t>(GetMinY(), tile_start_y);
+    int32_t to_y = std::min<int32_t>(GetMaxY(), tile_start_y + ActivityMap::kTileSize - 1);
+
+    for (int32_t y = from_y; y <= to_y && from_x <= to_x; ++y) {
+        const uint64_t* row = GetRow(y - min_y_);
+        std::copy(row + (from_x - min_x_), row + (to_x - min_x_ + 1),
+                  clone->cells + (y - tile_start_y) * ActivityMap::kTileSize + (from_x - tile_start_x));
+    }
+
+    return clone;
+}
+
+void Grid::ShareTiles(uint32_t first_tile_x, uint32_t first_tile_y, uint32_t tiles_width, uint32_t tiles_height) const {
+    uint32_t end_tile_x = first_tile_x + tiles_width;
+    uint32_t end_tile_y = first_tile_y + tiles_height;
+
+    bool is_covered = shared_tiles_ != nullptr
+        && first_tile_x >= shared_first_tile_x_ && end_tile_x <= shared_first_tile_x_ + shared_tiles_width_
+        && first_tile_y >= shared_first_tile_y_ && end_tile_y <= shared_first_tile_y_ + shared_tiles_height_;
+
+    // the bits grow to cover the tiles of all snapshots, keeping the bits of the tiles shared before
+    if (!is_covered) {
+        uint32_t new_first_tile_x = first_tile_x;
+        uint32_t new_first_tile_y = first_tile_y;
+
+        if (shared_tiles_ != nullptr) {
+            new_first_tile_x = std::min(new_first_tile_x, shared_first_tile_x_);
+            new_first_tile_y = std::min(new_first_tile_y, shared_first_tile_y_);
+            end_tile_x = std::max(end_tile_x, shared_first_tile_x_ + shared_tiles_width_);
+            end_tile_y = std::max(end_tile_y, shared_first_tile_y_ + shared_tiles_height_);
+        }
+
+        uint64_t words_count = (static_cast<uint64_t>(end_tile_x - new_first_tile_x) * (end_tile_y - new_first_tile_y) + 63) / 64;
+        uint64_t* new_shared_tiles = BufferPool::GetInstance().Allocate<uint64_t>(words_count);
+        std::fill(new_shared_tiles, new_shared_tiles + words_count, 0);
+
+        // no tiles are covered without the bits, so the loop is empty then
+        for (uint32_t tile_y = shared_first_tile_y_; tile_y < shared_first_tile_y_ + shared_tiles_height_; ++tile_y) {
+            for (uint32_t tile_x = shared_first_tile_x_; tile_x < shared_first_tile_x_ + shared_tiles_width_; ++tile_x) {
+                uint64_t tile = GetSharedTileIndex(tile_x, tile_y);
+
+                if ((shared_tiles_[tile / 64] >> (tile % 64)) & 1) {
+                    uint64_t new_tile = static_cast<uint64_t>(tile_y - new_first_tile_y) * (end_tile_x - new_first_tile_x) + (tile_x - new_first_tile_x);
+                    new_shared_tiles[new_tile / 64] |= uint64_t{1} << (new_tile % 64);
+                }
+            }
+        }
+
+        BufferPool::GetInstance().Release(shared_tiles_);
+        shared_tiles_ = new_shared_tiles;
+        shared_first_tile_x_ = new_first_tile_x;
+        shared_first_tile_y_ = new_first_tile_y;
+        shared_tiles_width_ = end_tile_x - new_first_tile_x;
+        shared_tiles_height_ = end_tile_y - new_first_tile_y;
+    }
+
+    for (uint32_t tile_y = first_tile_y; tile_y < first_tile_y + tiles_height; ++tile_y) {
+        for (uint32_t tile_x = first_tile_x; tile_x < first_tile_x + tiles_width; ++tile_x) {
+            uint64_t tile = GetSharedTileIndex(tile_x, tile_y);
+            shared_tiles_[tile / 64] |= uint64_t{1} << (tile % 64);
+        }
+    }
+}
+
+uint64_t Grid::GetSharedTileIndex(uint32_t tile_x, uint32_t tile_y) const {
+    if (shared_tiles_ == nullptr
+        || tile_x < shared_first_tile_x_ || tile_x >= shared_first_tile_x_ + shared_tiles_width_
+        || tile_y < shared_first_tile_y_ || tile_y >= shared_first_tile_y_ + shared_tiles_height_) {
+        return UINT64_MAX;
+    }
+
+    return static_cast<uint64_t>(tile_y - shared_first_tile_y_) * shared_tiles_width_ + (tile_x - shared_first_tile_x_);
+}
+
+void Grid::DetachSnapshots() const {
+    for (uint32_t i = 0; i < snapshots_count_; ++i) {
+        const Grid* snapshot = snapshots_[i];
+
+        for (uint32_t tile_y = snapshot->snapshot_first_tile_y_; tile_y < snapshot->snapshot_first_tile_y_ + snapshot->snapshot_tiles_height_; ++tile_y) {
+            for (uint32_t tile_x = snapshot->snapshot_first_tile_x_; tile_x < snapshot->snapshot_first_tile_x_ + snapshot->snapshot_tiles_width_; ++tile_x) {
+                PreserveTile(tile_x, tile_y);
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < snapshots_count_; ++i) {
+        snapshots_[i]->snapshot_source_ = nullptr;
+    }
+
+    snapshots_count_ = 0;
+    is_shared_ = (snapshot_tiles_ != nullptr);
+}
+
+void Grid::AddSnapshot(Grid* snapshot) const {
+    if (snapshots_count_ == snapshots_capacity_) {
+        snapshots_capacity_ = std::max<uint32_t>(4, 2 * snapshots_capacity_);
+
+        Grid** new_snapshots = new Grid*[snapshots_capacity_];
+        std::copy(snapshots_, snapshots_ + snapshots_count_, new_snapshots);
+
+        delete[] snapshots_;
+        snapshots_ = new_snapshots;
+    }
+
+    snapshots_[snapshots_count_++] = snapshot;
+    is_shared_ = true;
+}
+
+void Grid::RemoveSnapshot(Grid* snapshot) const {
+    Grid** end = std::remove(snapshots_, snapshots_ + snapshots_count_, snapshot);
+    snapshots_count_ = end - snapshots_;
+    is_shared_ = (snapshots_count_ != 0 || snapshot_tiles_ != nullptr);
+}
+
+void Grid::Materialize() {
+    uint64_t cells_count = static_cast<uint64_t>(width_) * height_;
+    uint64_t* new_cells = BufferPool::GetInstance().Allocate<uint64_t>(cells_count + cells_count / 4);
+    uint64_t** new_sand = BufferPool::GetInstance().Allocate<uint64_t*>(height_);
+
     for (size_t y = 0; y < height_; ++y) {
-        delete[] sand_[y];
+        new_sand[y] = new_cells + y * width_;
+
+        for (size_t x = 0; x < width_; ++x) {
+            new_sand[y][x] = GetSnapshotSand(min_x_ + x, min_y_ + y);
+        }
+    }
+
+    ReleaseSnapshot();
+
+    sand_ = new_sand;
+    cells_ = new_cells;
+}
+
+void Grid::ReleaseSnapshot() {
+    if (snapshot_tiles_ == nullptr) {
+        return;
     }
 
-    delete[] sand_;
+    if (snapshot_source_ != nullptr) {
+        snapshot_source_->RemoveSnapshot(this);
+    }
+
+    uint64_t tiles_count = static_cast<uint64_t>(snapshot_tiles_width_) * snapshot_tiles_height_;
+
+    for (uint64_t i = 0; i < tiles_count; ++i) {
+        if (snapshot_tiles_[i] != nullptr && --snapshot_tiles_[i]->references == 0) {
+            BufferPool::GetInstance().Release(snapshot_tiles_[i]);
+        }
+    }
+
+    BufferPool::GetInstance().Release(snapshot_tiles_);
+    snapshot_tiles_ = nullptr;
+    snapshot_source_ = nullptr;
+    is_shared_ = (snapshots_count_ != 0);
+}
+
+uint64_t Grid::GetSnapshotSand(int16_t x, int16_t y) const {
+    const SharedTile* tile = GetSnapshotTile(ActivityMap::GetTileIndex(x), ActivityMap::GetTileIndex(y));
+
+    if (tile == nullptr) {
+        return snapshot_source_->GetSand(x, y);
+    }
+
+    uint32_t x_in_tile = (x - ActivityMap::GetTileStart(ActivityMap::GetTileIndex(x)));
+    uint32_t y_in_tile = (y - ActivityMap::GetTileStart(ActivityMap::GetTileIndex(y)));
+
+    return tile->cells[y_in_tile * ActivityMap::kTileSize + x_in_tile];
+}
+
+Grid::SharedTile*& Grid::GetSnapshotTile(uint32_t tile_x, uint32_t tile_y) const {
+    uint64_t index = static_cast<uint64_t>(tile_y - snapshot_first_tile_y_) * snapshot_tiles_width_ + (tile_x - snapshot_first_tile_x_);
+    return snapshot_tiles_[index];
+}
+
+bool Grid::HasSnapshotTile(uint32_t tile_x, uint32_t tile_y) const {
+    return tile_x >= snapshot_first_tile_x_ && tile_x < snapshot_first_tile_x_ + snapshot_tiles_width_
+        && tile_y >= snapshot_first_tile_y_ && tile_y < snapshot_first_tile_y_ + snapshot_tiles_height_;
+}
+
+void Grid::Reset() {
+    delete mapped_sand_;
+    mapped_sand_ = nullptr;
+
+    BufferPool::GetInstance().Release(cells_);
+    BufferPool::GetInstance().Release(sand_);
+    cells_ = nullptr;
+    sand_ = nullptr;
     width_ = 0;
     height_ = 0;
 }
 
 Grid::~Grid() {
+    DetachSnapshots();
+    ReleaseSnapshot();
     Reset();
+
+    delete[] snapshots_;
+    BufferPool::GetInstance().Release(shared_tiles_);
+    delete activity_map_;
+}
+
+void Grid::EnableActivityTracking(uint64_t threshold) {
+    delete activity_map_;
+    activity_map_ = new ActivityMap(threshold);
+    RebuildActivityMap();
+}
+
+void Grid::RebuildActivityMap() {
+    if (activity_map_ == nullptr) {
+        return;
+    }
+
+    activity_map_->Clear();
+
+    if (!IsEmpty()) {
+        activity_map_->Reserve(GetMinY(), GetMaxY());
+    }
+
+    for (size_t y = 0; y < height_; ++y) {
+        for (size_t x = 0; x < width_; ++x) {
+            activity_map_->Update(min_x_ + x, min_y_ + y, 0, GetSand(min_x_ + x, min_y_ + y));
+        }
+    }
+}
+
+void Grid::SetMemoryBudget(uint64_t memory_budget, const char* scratch_directory) {
+    memory_budget_ = memory_budget;
+    scratch_directory_ = scratch_directory;
+}
+
+void Grid::SetSinkBoundary(int16_t min_x, int16_t min_y, int16_t max_x, int16_t max_y) {
+    SetSand(min_x, min_y, 0);
+    SetSand(max_x, max_y, 0);
+    is_bounded_ = true;
+}
+
+bool Grid::IsBounded() const {
+    return is_bounded_;
+}
+
+bool Grid::IsMapped() const {
+    return mapped_sand_ != nullptr;
+}
+
+bool Grid::IsShared() const {
+    return is_shared_;
+}
+
+uint64_t* Grid::GetRowCells(int16_t y) {
+    return sand_[y - min_y_];
+}
+
+const ActivityMap* Grid::GetActivityMap() const {
+    return activity_map_;
+}
+
+ActivityMap* Grid::GetActivityMap() {
+    return activity_map_;
 }
 
 uint32_t Grid::GetWidth() const {
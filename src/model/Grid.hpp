@@ -1,11 +1,20 @@
 #pragma once
 
+#include "model/ActivityMap.hpp"
+#include "model/MappedBuffer.hpp"
+#include "model/WorkStealingScheduler.hpp"
+
 #include <cstdint>
 
 class Grid {
 public:
     Grid() = default;
 
+    /**
+     * Copies are copy-on-write snapshots taken in O(tiles): a copy reads the cells of %other%
+     * until they change there, and a tile is cloned into the copy only before %other% writes to it first.
+     * A copy is turned into a plain grid (in O(area)) when it's written to itself
+     */
     Grid(const Grid& other);
     Grid& operator=(const Grid& other);
     
@@ -28,15 +37,200 @@ public:
 
     bool HasCell(int16_t x, int16_t y) const;
 
+    /**
+     * Starts tracking unstable and changed tiles of the grid (see ActivityMap).
+     * The map is rebuilt from the current contents of the grid
+     * and kept up to date by every following change of the cells.
+     * Copies of the grid don't inherit the tracking
+     */
+    void EnableActivityTracking(uint64_t threshold);
+
+    /** @return Activity map or nullptr if the tracking is not enabled */
+    const ActivityMap* GetActivityMap() const;
+    ActivityMap* GetActivityMap();
+
+    /**
+     * Sets the maximal amount of memory for grid cells. Grids larger than that are stored
+     * in a memory-mapped scratch file in %scratch_directory% (see MappedBuffer).
+     * Has to be set before filling the grid. If zero, the grid is stored in memory
+     * unless it doesn't fit into the memory limit of BufferPool. Copies of the grid are always stored in memory
+     */
+    void SetMemoryBudget(uint64_t memory_budget, const char* scratch_directory);
+
+    /**
+     * Fixes the grid to the rectangle from (%min_x%, %min_y%) to (%max_x%, %max_y%), which is allocated at once.
+     * Sand added outside of the rectangle falls into the sink and is lost, so the grid never grows.
+     * Has to be called on an empty grid. Copies of the grid are bounded too
+     */
+    void SetSinkBoundary(int16_t min_x, int16_t min_y, int16_t max_x, int16_t max_y);
+    bool IsBounded() const;
+
+    /**
+     * Makes the threads of %scheduler% fill new buffers of the grid in memory, each thread an equal strip of rows,
+     * so the pages of each strip are placed on the NUMA node of its thread. The current buffer is moved at once
+     * unless the grid is shared. The scheduler has to be idle during changes of the grid; nullptr turns it off
+     */
+    void SetFirstTouchScheduler(WorkStealingScheduler* scheduler);
+
+    /** Checks if the grid is currently stored in a scratch file */
+    bool IsMapped() const;
+
+    /** Checks if the grid has copy-on-write snapshots or is a snapshot itself */
+    bool IsShared() const;
+
+    /**
+     * @return Cells of the row %y% (starting from the column GetMinX()) for kernels processing
+     * rows of the grid directly, possibly from several threads. The grid must be neither mapped nor shared.
+     * Writes through the row bypass the activity map, so they have to be reported to it (see ActivityMap::UpdateTile)
+     */
+    uint64_t* GetRowCells(int16_t y);
+
+    /**
+     * Has to be called before accessing the cells of the rows from %min_y% to %max_y% one by one,
+     * so the residency of a grid stored in a scratch file is tracked (see MappedBuffer).
+     * Cell accessors don't track it themselves to keep the sweeps of grids in memory cheap
+     */
+    void TouchRows(int16_t min_y, int16_t max_y) const;
+
 private:
+    struct SharedTile {
+        uint64_t references;
+        uint64_t cells[ActivityMap::kTileSize * ActivityMap::kTileSize];
+    };
+
     uint64_t** sand_ = nullptr;
 
+    // rows are either stored contiguously in a buffer from BufferPool or in a mapped file
+    uint64_t* cells_ = nullptr;
+    MappedBuffer* mapped_sand_ = nullptr;
+    ActivityMap* activity_map_ = nullptr;
+
+    uint64_t memory_budget_ = 0;
+    const char* scratch_directory_ = nullptr;
+
     uint32_t width_ = 0;
     uint32_t height_ = 0;
 
     int16_t min_x_ = 0;
     int16_t min_y_ = 0;
 
+    // cells outside of a bounded grid belong to the sink
+    bool is_bounded_ = false;
+
+    WorkStealingScheduler* first_touch_scheduler_ = nullptr;
+
+    // Copy-on-write state of a grid with snapshots: the snapshots and the bits of tiles
+    // which haven't changed since the last snapshot was taken, covering the tiles of all snapshots.
+    // Mutable, since snapshots are taken from a const grid
+    mutable Grid** snapshots_ = nullptr;
+    mutable uint32_t snapshots_count_ = 0;
+    mutable uint32_t snapshots_capacity_ = 0;
+    mutable uint64_t* shared_tiles_ = nullptr;
+    mutable uint32_t shared_first_tile_x_ = 0;
+    mutable uint32_t shared_first_tile_y_ = 0;
+    mutable uint32_t shared_tiles_width_ = 0;
+    mutable uint32_t shared_tiles_height_ = 0;
+
+    // Copy-on-write state of a snapshot: the grid it reads unchanged cells from
+    // (nullptr if all tiles are already cloned) and the cloned tiles
+    const Grid* snapshot_source_ = nullptr;
+    SharedTile** snapshot_tiles_ = nullptr;
+    uint32_t snapshot_first_tile_x_ = 0;
+    uint32_t snapshot_first_tile_y_ = 0;
+    uint32_t snapshot_tiles_width_ = 0;
+    uint32_t snapshot_tiles_height_ = 0;
+
+    // either has snapshots or is a snapshot itself, so writes need preparation (see PrepareWrite)
+    mutable bool is_shared_ = false;
+
     void Expand(uint32_t to_left, uint32_t to_top, uint32_t to_right, uint32_t to_bottom);
+
+    /** Moves the cells into a new buffer, adding the empty rows and columns */
+    void Reallocate(uint32_t to_left, uint32_t to_top, uint32_t to_right, uint32_t to_bottom);
+
+    /** Expands the grid inside the capacity of the current buffer, moving the rows */
+    void ExpandInPlace(uint32_t to_left, uint32_t to_bottom, uint32_t new_width, uint32_t new_height);
     void Reset();
-};
\ No newline at end of file
+    void RebuildActivityMap();
+
+    /** @return Row with relative index %y%, keeping track of the scratch file residency */
+    uint64_t* GetRow(uint32_t y) const;
+
+    /** Sets the amount of sand in the existing cell */
+    void UpdateCell(int16_t x, int16_t y, uint64_t sand);
+
+    /** Turns the grid into a snapshot of %other%. The grid has to be empty */
+    void TakeSnapshotOf(const Grid& other);
+
+    /** Has to be called before writing to the cell (x, y) of a shared grid */
+    void PrepareWrite(int16_t x, int16_t y);
+
+    /** Marks the tiles as shared with a new snapshot */
+    void ShareTiles(uint32_t first_tile_x, uint32_t first_tile_y, uint32_t tiles_width, uint32_t tiles_height) const;
+
+    /** @return Index of the bit of the tile in shared_tiles_, UINT64_MAX if it's not covered by them */
+    uint64_t GetSharedTileIndex(uint32_t tile_x, uint32_t tile_y) const;
+
+    /** Clones the tile into the snapshots still reading it from this grid */
+    void PreserveTile(uint32_t tile_x, uint32_t tile_y) const;
+    SharedTile* CloneTile(uint32_t tile_x, uint32_t tile_y) const;
+
+    /** Clones all tiles still shared with the snapshots, so they don't depend on this grid anymore */
+    void DetachSnapshots() const;
+    void AddSnapshot(Grid* snapshot) const;
+    void RemoveSnapshot(Grid* snapshot) const;
+
+    /** Turns a snapshot into a plain grid */
+    void Materialize();
+    void ReleaseSnapshot();
+
+    uint64_t GetSnapshotSand(int16_t x, int16_t y) const;
+    SharedTile*& GetSnapshotTile(uint32_t tile_x, uint32_t tile_y) const;
+    bool HasSnapshotTile(uint32_t tile_x, uint32_t tile_y) const;
+};
+
+inline bool Grid::HasCell(int16_t x, int16_t y) const {
+    // an empty grid has zero width, so no cell fits into it
+    return (x >= min_x_ && x < min_x_ + static_cast<int64_t>(width_))
+        && (y >= min_y_ && y < min_y_ + static_cast<int64_t>(height_));
+}
+
+inline uint64_t Grid::GetSand(int16_t x, int16_t y) const {
+    if (!HasCell(x, y)) {
+        return 0;
+    } else if (snapshot_tiles_ != nullptr) [[unlikely]] {
+        return GetSnapshotSand(x, y);
+    }
+
+    return sand_[y - min_y_][x - min_x_];
+}
+
+inline void Grid::AddSand(int16_t x, int16_t y, uint64_t sand) {
+    if (!HasCell(x, y) || is_shared_) [[unlikely]] {
+        SetSand(x, y, GetSand(x, y) + sand);
+        return;
+    }
+
+    UpdateCell(x, y, sand_[y - min_y_][x - min_x_] + sand);
+}
+
+inline void Grid::RemoveSand(int16_t x, int16_t y, uint64_t sand) {
+    if (!HasCell(x, y) || is_shared_) [[unlikely]] {
+        uint64_t current_sand = GetSand(x, y);
+        SetSand(x, y, (current_sand < sand) ? 0 : current_sand - sand);
+        return;
+    }
+
+    uint64_t current_sand = sand_[y - min_y_][x - min_x_];
+    UpdateCell(x, y, (current_sand < sand) ? 0 : current_sand - sand);
+}
+
+inline void Grid::UpdateCell(int16_t x, int16_t y, uint64_t sand) {
+    uint64_t& cell = sand_[y - min_y_][x - min_x_];
+
+    if (activity_map_ != nullptr) {
+        activity_map_->Update(x, y, cell, sand);
+    }
+
+    cell = sand;
+}
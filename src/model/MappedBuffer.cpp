@@ -0,0 +1,142 @@
+#include "model/MappedBuffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+MappedBuffer::MappedBuffer(const char* scratch_directory, uint32_t width, uint32_t height, uint64_t memory_budget)
+    : width_(width),
+      height_(height),
+      memory_budget_(memory_budget) {
+    const char* file_template = "sandpile_XXXXXX";
+
+    char* path = new char[std::strlen(scratch_directory) + std::strlen(file_template) + 1];
+    std::strcpy(path, scratch_directory);
+    std::strcat(path, file_template);
+
+    file_descriptor_ = mkstemp(path);
+
+    if (file_descriptor_ != -1) {
+        // the file is only needed while it's mapped
+        unlink(path);
+    }
+
+    delete[] path;
+
+    uint64_t byte_size = static_cast<uint64_t>(width_) * height_ * sizeof(uint64_t);
+
+    if (file_descriptor_ == -1 || byte_size == 0 || ftruncate(file_descriptor_, byte_size) != 0) {
+        return;
+    }
+
+    void* data = mmap(nullptr, byte_size, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor_, 0);
+
+    if (data == MAP_FAILED) {
+        return;
+    }
+
+    data_ = static_cast<uint64_t*>(data);
+    madvise(data_, byte_size, MADV_SEQUENTIAL);
+
+    bands_count_ = (height_ + kBandHeight - 1) / kBandHeight;
+    band_last_use_ = new uint64_t[bands_count_];
+    band_resident_ = new bool[bands_count_];
+    std::fill(band_last_use_, band_last_use_ + bands_count_, 0);
+    std::fill(band_resident_, band_resident_ + bands_count_, false);
+}
+
+MappedBuffer::~MappedBuffer() {
+    if (data_ != nullptr) {
+        munmap(data_, static_cast<uint64_t>(width_) * height_ * sizeof(uint64_t));
+    }
+
+    if (file_descriptor_ != -1) {
+        close(file_descriptor_);
+    }
+
+    delete[] band_last_use_;
+    delete[] band_resident_;
+}
+
+bool MappedBuffer::IsMapped() const {
+    return data_ != nullptr;
+}
+
+uint64_t* MappedBuffer::GetRow(uint32_t row) const {
+    return data_ + static_cast<uint64_t>(row) * width_;
+}
+
+uint64_t MappedBuffer::GetResidentByteSize() const {
+    return resident_byte_size_;
+}
+
+void MappedBuffer::TouchBand(uint32_t band) {
+    last_band_ = band;
+    band_last_use_[band] = ++use_clock_;
+
+    if (band_resident_[band]) {
+        return;
+    }
+
+    band_resident_[band] = true;
+    resident_byte_size_ += GetBandByteSize(band);
+
+    if (band + 1 < bands_count_) {
+        AdviseBand(band + 1, MADV_WILLNEED);
+    }
+
+    while (resident_byte_size_ > memory_budget_) {
+        uint32_t least_recently_used = band;
+
+        for (uint32_t i = 0; i < bands_count_; ++i) {
+            if (band_resident_[i] && band_last_use_[i] < band_last_use_[least_recently_used]) {
+                least_recently_used = i;
+            }
+        }
+
+        // the current band is always kept, even if it doesn't fit in the budget by itself
+        if (least_recently_used == band) {
+            break;
+        }
+
+        EvictBand(least_recently_used);
+    }
+}
+
+void MappedBuffer::EvictBand(uint32_t band) {
+    uint64_t* band_begin = GetRow(band * kBandHeight);
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
+
+    // only whole pages of the band are dropped, the ones shared with neighbouring bands are kept
+    uint64_t begin_offset = (band_begin - data_) * sizeof(uint64_t);
+    uint64_t end_offset = begin_offset + GetBandByteSize(band);
+    begin_offset = (begin_offset + page_size - 1) / page_size * page_size;
+    end_offset = end_offset / page_size * page_size;
+
+    if (begin_offset < end_offset) {
+        char* begin = reinterpret_cast<char*>(data_) + begin_offset;
+
+        msync(begin, end_offset - begin_offset, MS_ASYNC);
+        madvise(begin, end_offset - begin_offset, MADV_DONTNEED);
+        posix_fadvise(file_descriptor_, begin_offset, end_offset - begin_offset, POSIX_FADV_DONTNEED);
+    }
+
+    band_resident_[band] = false;
+    resident_byte_size_ -= GetBandByteSize(band);
+}
+
+void MappedBuffer::AdviseBand(uint32_t band, int advice) const {
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
+    uint64_t begin_offset = static_cast<uint64_t>(band) * kBandHeight * width_ * sizeof(uint64_t);
+    begin_offset = begin_offset / page_size * page_size;
+
+    madvise(reinterpret_cast<char*>(data_) + begin_offset, GetBandByteSize(band), advice);
+}
+
+uint64_t MappedBuffer::GetBandByteSize(uint32_t band) const {
+    uint32_t rows = std::min(uint32_t{kBandHeight}, height_ - band * kBandHeight);
+    return static_cast<uint64_t>(rows) * width_ * sizeof(uint64_t);
+}
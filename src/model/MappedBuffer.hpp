@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Zero-filled buffer of grid cells stored in a memory-mapped scratch file,
+ * so the grid is not limited by the amount of RAM.
+ *
+ * Rows are grouped into bands of kBandHeight rows. Not more than %memory_budget% bytes of bands
+ * are kept mapped in memory: when the limit is reached, the least recently used band
+ * is written back to the file and dropped. Since the grid is swept row by row,
+ * the next band is prefetched every time a new band is accessed.
+ */
+class MappedBuffer {
+public:
+    static const uint32_t kBandHeight = 64;
+
+    MappedBuffer(const char* scratch_directory, uint32_t width, uint32_t height, uint64_t memory_budget);
+    ~MappedBuffer();
+
+    MappedBuffer(const MappedBuffer& other) = delete;
+    MappedBuffer& operator=(const MappedBuffer& other) = delete;
+
+    /** @return false if the scratch file can't be created or mapped */
+    bool IsMapped() const;
+
+    uint64_t* GetRow(uint32_t row) const;
+
+    /** Has to be called before accessing the row, so the residency of bands is tracked */
+    void TouchRow(uint32_t row);
+
+    uint64_t GetResidentByteSize() const;
+
+private:
+    int file_descriptor_ = -1;
+    uint64_t* data_ = nullptr;
+
+    uint32_t width_;
+    uint32_t height_;
+    uint64_t memory_budget_;
+
+    uint32_t bands_count_ = 0;
+    uint64_t* band_last_use_ = nullptr;
+    bool* band_resident_ = nullptr;
+    uint32_t last_band_ = 0;
+
+    uint64_t use_clock_ = 0;
+    uint64_t resident_byte_size_ = 0;
+
+    void TouchBand(uint32_t band);
+    void EvictBand(uint32_t band);
+    void AdviseBand(uint32_t band, int advice) const;
+
+    uint64_t GetBandByteSize(uint32_t band) const;
+};
+
+inline void MappedBuffer::TouchRow(uint32_t row) {
+    uint32_t band = row / kBandHeight;
+
+    if (band != last_band_ || !band_resident_[band]) {
+        TouchBand(band);
+    }
+}
@@ -1,46 +1,93 @@
 #include "model/Sandpile.hpp"
+#include "memory/BufferPool.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstring>
 #include <cstddef>
+#include <thread>
 
-Sandpile::Sandpile(Grid& grid) : grid_(grid) {}
+// How long a stable grid waits for grains from unfinished producers of the grain queue
+const std::chrono::microseconds kGrainQueuePollInterval{100};
 
-std::optional<SandpileError> Sandpile::SaveCurrentState(const char* filename) const {
+Sandpile::Sandpile(Grid& grid) : grid_(grid) {
+    grid_.EnableActivityTracking(critical_sand_number_);
+}
+
+Sandpile::~Sandpile() {
+    if (is_scheduler_owned_) {
+        delete scheduler_;
+    }
+}
+
+template<typename ImageWriter>
+void SetSandColors(ImageWriter& image_writer) {
+    for (size_t i = 0; i < kColorsUsed; ++i) {
+        image_writer.SetColor(i, kSandPalette[i]);
+    }
+}
+
+std::optional<SandpileError> Sandpile::SaveCurrentState(const char* filename, SandStatistics* statistics) const {
     if (output_directory_ == nullptr) {
         return SandpileError{"Cannot save current state to a file: no output directory is specified"};
     }
 
-    BmpWriter bmp_writer{grid_.GetWidth(), grid_.GetHeight(), kColorsUsed};
-    bmp_writer.SetColor(SandColor::kWhite, kWhiteRGB);
-    bmp_writer.SetColor(SandColor::kBlack, kBlackRGB);
-    bmp_writer.SetColor(SandColor::kGreen, kGreenRGB);
-    bmp_writer.SetColor(SandColor::kPurple, kPurpleRGB);
-    bmp_writer.SetColor(SandColor::kYellow, kYellowRGB);
-
-    for (int16_t y = grid_.GetMinY(); y <= grid_.GetMaxY(); ++y) {
-        for (int16_t x = grid_.GetMinX(); x <= grid_.GetMaxX(); ++x) {
-            uint64_t sand = grid_.GetSand(x, y);
-            SandColor color = (sand >= critical_sand_number_) ? kBlack : SandColor(sand % critical_sand_number_);
+    auto draw_row = [this, statistics](uint32_t y, uint8_t* colors) {
+        int16_t grid_y = grid_.GetMinY() + y;
+        grid_.TouchRows(grid_y, grid_y);
+
+        for (uint32_t x = 0; x < grid_.GetWidth(); ++x) {
+            uint64_t sand = grid_.GetSand(grid_.GetMinX() + x, grid_y);
+            colors[x] = GetSandColor(sand);
 
-            bmp_writer.SetPixel(x - grid_.GetMinX(), y - grid_.GetMinY(), color);
+            if (statistics != nullptr) {
+                statistics->AddCell(grid_.GetMinX() + x, grid_y, sand);
+            }
         }
+    };
+
+    if (IsPngOutput()) {
+        PngWriter png_writer{grid_.GetWidth(), grid_.GetHeight(), kColorsUsed};
+        png_writer.SetCompressionLevel(png_compression_level_);
+        DrawCurrentState(png_writer, draw_row);
+
+        return SaveImage(png_writer, filename);
     }
 
-    size_t output_directory_length = std::strlen(output_directory_);
-    size_t filename_length = std::strlen(filename);
+    BmpWriter bmp_writer{grid_.GetWidth(), grid_.GetHeight(), kColorsUsed};
+    DrawCurrentState(bmp_writer, draw_row);
 
-    char* path = new char[output_directory_length + filename_length + 1];
-    std::strcpy(path, output_directory_);
-    std::strcat(path, filename);
+    return SaveImage(bmp_writer, filename);
+}
 
-    std::optional<BmpWriterError> saving_result = bmp_writer.Save(path);
-    delete[] path;
+template<typename ImageWriter, typename RowSource>
+void Sandpile::DrawCurrentState(ImageWriter& image_writer, const RowSource& draw_row) const {
+    SetSandColors(image_writer);
 
-    if (saving_result.has_value()) {
-        return SandpileError{saving_result.value().message};
+    // the image is encoded right from the grid if its pixels would take a large part of the memory left
+    uint64_t pixels_count = static_cast<uint64_t>(grid_.GetWidth()) * grid_.GetHeight();
+
+    if (BufferPool::GetCapacityFor(pixels_count) > BufferPool::GetInstance().GetAvailableByteSize() / 2) {
+        image_writer.SetRowSource(draw_row);
+        return;
     }
 
-    return std::nullopt;
+    uint8_t* colors = BufferPool::GetInstance().Allocate<uint8_t>(grid_.GetWidth());
+
+    for (uint32_t y = 0; y < grid_.GetHeight(); ++y) {
+        draw_row(y, colors);
+
+        for (uint32_t x = 0; x < grid_.GetWidth(); ++x) {
+            image_writer.SetPixel(x, y, colors[x]);
+        }
+    }
+
+    BufferPool::GetInstance().Release(colors);
+}
+
+SandColor Sandpile::GetSandColor(uint64_t sand) const {
+    return (sand >= critical_sand_number_) ? kBlack : SandColor(sand % critical_sand_number_);
 }
 
 void Sandpile::ToppleCell(int16_t x, int16_t y, uint64_t amount) {
@@ -49,6 +96,7 @@ void Sandpile::ToppleCell(int16_t x, int16_t y, uint64_t amount) {
     }
 
     amount -= amount % 4;
+    ++topplings_count_;
 
     uint64_t add_to_neighbour = amount / 4;
 
@@ -65,39 +113,136 @@ void Sandpile::ToppleCell(int16_t x, int16_t y) {
 }
 
 void Sandpile::FullyToppleCell(int16_t x, int16_t y) {
-    ToppleCell(x, y, grid_.GetSand(x, y) - (grid_.GetSand(x, y) % critical_sand_number_));
+    uint64_t sand = grid_.GetSand(x, y);
+    ToppleCell(x, y, sand - (sand % critical_sand_number_));
 }
 
-void Sandpile::ToppleGrid() {
-    int16_t min_y = grid_.GetMinY();
-    int16_t min_x = grid_.GetMinX();
-    int16_t max_y = grid_.GetMaxY();
-    int16_t max_x = grid_.GetMaxX();
+void Sandpile::RecordedToppleCell(int16_t x, int16_t y) {
+    uint64_t topplings_before = topplings_count_;
+    ToppleCell(x, y);
+
+    if (topplings_count_ != topplings_before) {
+        uint32_t bit = x - recorded_row_first_x_;
+        recorded_row_[bit / 64] |= uint64_t{1} << (bit % 64);
+    }
+}
+
+template<void (Sandpile::*Topple)(int16_t, int16_t)>
+void Sandpile::SweepActiveTiles() {
+    int32_t min_y = grid_.GetMinY();
+    int32_t min_x = grid_.GetMinX();
+    int32_t max_y = grid_.GetMaxY();
+    int32_t max_x = grid_.GetMaxX();
+
+    for (int32_t y = min_y; y <= max_y; ++y) {
+        SweepRow<Topple>(y, min_x, max_x);
+    }
+}
+
+template<void (Sandpile::*Topple)(int16_t, int16_t)>
+void Sandpile::SweepRow(int32_t y, int32_t min_x, int32_t max_x) {
+    const ActivityMap& activity_map = *grid_.GetActivityMap();
+
+    // a toppling cell changes the rows next to it too
+    grid_.TouchRows(y - 1, y + 1);
 
-    for (int16_t y = min_y; y <= max_y; ++y) {
-        for (int16_t x = min_x; x <= max_x; ++x) {
-            ToppleCell(x, y);
+    uint32_t tile_y = ActivityMap::GetTileIndex(y);
+    uint32_t min_tile_x = ActivityMap::GetTileIndex(min_x);
+    uint32_t max_tile_x = ActivityMap::GetTileIndex(max_x);
+
+    // The cells are visited in the same row-major order as in a plain sweep.
+    // Row segments of tiles without unstable cells are skipped: none of their cells
+    // could topple until a neighbouring cell does, which would make the tile unstable first
+    for (uint32_t tile_x = min_tile_x; tile_x <= max_tile_x; ++tile_x) {
+        if (!activity_map.IsTileUnstable(tile_x, tile_y)) {
+            continue;
+        }
+
+        int32_t from_x = std::max(min_x, ActivityMap::GetTileStart(tile_x));
+        int32_t to_x = std::min(max_x, ActivityMap::GetTileStart(tile_x) + int32_t{ActivityMap::kTileSize} - 1);
+
+        for (int32_t x = from_x; x <= to_x; ++x) {
+            (this->*Topple)(x, y);
         }
     }
 }
 
-void Sandpile::FullyToppleGrid() {
-    int16_t min_y = grid_.GetMinY();
-    int16_t min_x = grid_.GetMinX();
-    int16_t max_y = grid_.GetMaxY();
-    int16_t max_x = grid_.GetMaxX();
+void Sandpile::ToppleGrid() {
+    SweepActiveTiles<&Sandpile::ToppleCell>();
+}
+
+uint64_t Sandpile::ToppleGrid(uint64_t iterations) {
+    bool* toppled = BufferPool::GetInstance().Allocate<bool>(iterations);
+    std::fill(toppled, toppled + iterations, false);
+
+    if (event_log_.IsOpen()) {
+        // a row holds at most 2^16 cells
+        uint32_t max_words_count = (1 << 16) / 64;
+        recorded_row_ = BufferPool::GetInstance().Allocate<uint64_t>(max_words_count);
+        std::fill(recorded_row_, recorded_row_ + max_words_count, 0);
+    }
+
+    // Row y of iteration i depends only on rows y - 1 of the same iteration
+    // and y + 1 of the previous one, so processing (y, i) in the order of y + 2 * i
+    // gives exactly the same result as %iterations% consecutive sweeps,
+    // while only about 2 * %iterations% rows of the grid are in use at a time.
+    // Rows and columns appearing on the border during the block can't hold a critical
+    // amount of sand yet, so it doesn't matter which iteration first visits them
+    for (int64_t wavefront = grid_.GetMinY(); wavefront <= grid_.GetMaxY() + 2 * static_cast<int64_t>(iterations - 1); ++wavefront) {
+        for (uint64_t iteration = 0; iteration < iterations; ++iteration) {
+            int64_t y = wavefront - 2 * static_cast<int64_t>(iteration);
+
+            if (y < grid_.GetMinY()) {
+                break;
+            } else if (y > grid_.GetMaxY()) {
+                continue;
+            }
+
+            uint64_t topplings_before = topplings_count_;
 
-    for (int16_t y = min_y; y <= max_y; ++y) {
-        for (int16_t x = min_x; x <= max_x; ++x) {
-            FullyToppleCell(x, y);
+            if (recorded_row_ == nullptr) {
+                SweepRow<&Sandpile::ToppleCell>(y, grid_.GetMinX(), grid_.GetMaxX());
+            } else {
+                // the row is swept over the columns the grid had before it, even if it grows during the sweep
+                recorded_row_first_x_ = grid_.GetMinX();
+                uint32_t words_count = (grid_.GetWidth() + 63) / 64;
+
+                SweepRow<&Sandpile::RecordedToppleCell>(y, grid_.GetMinX(), grid_.GetMaxX());
+
+                if (topplings_count_ != topplings_before) {
+                    event_log_.AddToppledRow(iteration, y, recorded_row_first_x_, recorded_row_, words_count);
+                    std::fill(recorded_row_, recorded_row_ + words_count, 0);
+                }
+            }
+
+            toppled[iteration] |= (topplings_count_ != topplings_before);
         }
     }
+
+    // an iteration topples nothing only if the grid was already stable before it
+    uint64_t performed_iterations = std::count(toppled, toppled + iterations, true);
+    BufferPool::GetInstance().Release(toppled);
+    BufferPool::GetInstance().Release(recorded_row_);
+    recorded_row_ = nullptr;
+
+    return performed_iterations;
 }
 
-bool Sandpile::IsGridStable() const {
-    for (int16_t y = grid_.GetMinY(); y <= grid_.GetMaxY(); ++y) {
-        for (int16_t x = grid_.GetMinX(); x <= grid_.GetMaxX(); ++x) {
-            if (grid_.GetSand(x, y) >= critical_sand_number_) {
+bool Sandpile::CanUseBitPlanes() {
+    if (critical_sand_number_ != 4 || grid_.IsEmpty() || grid_.IsBounded() || grid_.IsMapped() || grid_.IsShared()) {
+        return false;
+    } else if (grid_.GetSand(tall_cell_x_, tall_cell_y_) > BitPlaneGrid::kMaxHeight) {
+        return false;
+    }
+
+    for (int32_t y = grid_.GetMinY(); y <= grid_.GetMaxY(); ++y) {
+        const uint64_t* cells = grid_.GetRowCells(y);
+
+        for (uint32_t x = 0; x < grid_.GetWidth(); ++x) {
+            if (cells[x] > BitPlaneGrid::kMaxHeight) {
+                tall_cell_x_ = grid_.GetMinX() + x;
+                tall_cell_y_ = y;
+
                 return false;
             }
         }
@@ -106,47 +251,522 @@ bool Sandpile::IsGridStable() const {
     return true;
 }
 
+uint64_t Sandpile::ToppleBitPlanes(uint64_t iterations) {
+    BitPlaneGrid bit_planes;
+    bit_planes.Load(grid_, iterations);
+
+    // an iteration topples nothing only if the grid was already stable before it
+    uint64_t performed_iterations = 0;
+
+    while (performed_iterations < iterations) {
+        EventLogWriter* event_log = event_log_.IsOpen() ? &event_log_ : nullptr;
+        uint64_t topplings_count = bit_planes.Sweep(event_log, performed_iterations);
+
+        if (topplings_count == 0) {
+            break;
+        }
+
+        topplings_count_ += topplings_count;
+        ++performed_iterations;
+    }
+
+    bit_planes.Store(grid_);
+
+    return performed_iterations;
+}
+
+bool Sandpile::HasSnapshotSchedule() const {
+    return snapshot_schedule_.log_points_per_decade != 0 || snapshot_schedule_.wall_clock_interval != 0
+        || snapshot_schedule_.topplings_threshold != 0;
+}
+
+uint64_t Sandpile::GetNextLogSnapshot(uint64_t iteration) const {
+    if (snapshot_schedule_.log_points_per_decade == 0) {
+        return iteration;
+    }
+
+    double points_per_decade = static_cast<double>(snapshot_schedule_.log_points_per_decade);
+
+    // points 10^(k / n) are rounded, so the close ones at the start of the run are merged
+    uint64_t point = (iteration == 0) ? 0 : static_cast<uint64_t>(std::floor(points_per_decade * std::log10(iteration)));
+    uint64_t next_iteration = 0;
+
+    while (next_iteration <= iteration) {
+        next_iteration = std::llround(std::pow(10.0, point / points_per_decade));
+        ++point;
+    }
+
+    return next_iteration;
+}
+
+uint64_t Sandpile::GetTemporalBlockDepth() const {
+    // the wavefront keeps about 2 rows per iteration in use
+    uint64_t row_byte_size = static_cast<uint64_t>(grid_.GetWidth()) * sizeof(uint64_t);
+    uint64_t depth = kTemporalBlockByteSize / (2 * row_byte_size + 1);
+
+    return std::clamp<uint64_t>(depth, 1, kMaxTemporalBlockDepth);
+}
+
+void Sandpile::FullyToppleGrid() {
+    SweepActiveTiles<&Sandpile::FullyToppleCell>();
+}
+
+uint64_t Sandpile::GetToppledShare(uint64_t sand) const {
+    if (critical_sand_number_ == 4) {
+        return sand / 4;
+    } else if (sand < critical_sand_number_) {
+        return 0;
+    }
+
+    uint64_t amount = sand - sand % critical_sand_number_;
+
+    return (amount - amount % 4) / 4;
+}
+
+uint64_t Sandpile::RelaxCheckerboard() {
+    ActivityMap& activity_map = *grid_.GetActivityMap();
+
+    if (scheduler_ == nullptr) {
+        scheduler_ = new WorkStealingScheduler(std::max(1u, std::thread::hardware_concurrency()));
+        is_scheduler_owned_ = true;
+    }
+
+    is_scheduler_used_ = true;
+
+    // the threads are pinned before they touch the grid
+    scheduler_->SetPinned(numa_policy_ == kNumaPinned);
+
+    if (numa_policy_ != kNoNumaPolicy) {
+        grid_.SetFirstTouchScheduler(scheduler_);
+    }
+
+    uint32_t threads_count = scheduler_->GetThreadsCount();
+    CheckerboardPassResult* results = new CheckerboardPassResult[threads_count];
+
+    CheckerboardPass pass;
+    TileNodes tile_nodes;
+    uint64_t passes_count = 0;
+
+    auto is_unstable = [&activity_map](int64_t tile_x, int64_t tile_y) {
+        return tile_x >= 0 && tile_y >= 0 && tile_x < ActivityMap::kTilesPerSide && tile_y < ActivityMap::kTilesPerSide
+            && activity_map.IsTileUnstable(tile_x, tile_y);
+    };
+
+    while (!IsGridStable()) {
+        ExpandForCheckerboardPass(pass.toppling_color);
+
+        pass.first_tile_x = ActivityMap::GetTileIndex(grid_.GetMinX());
+        pass.first_tile_y = ActivityMap::GetTileIndex(grid_.GetMinY());
+        pass.tiles_width = ActivityMap::GetTileIndex(grid_.GetMaxX()) - pass.first_tile_x + 1;
+        pass.has_pending = (passes_count != 0);
+
+        uint32_t tiles_height = ActivityMap::GetTileIndex(grid_.GetMaxY()) - pass.first_tile_y + 1;
+        uint32_t tiles_count = pass.tiles_width * tiles_height;
+
+        // a tile can only change if it or one of its neighbours contains unstable cells
+        uint32_t* visited_tiles = BufferPool::GetInstance().Allocate<uint32_t>(tiles_count);
+        uint32_t visited_tiles_count = 0;
+
+        for (uint32_t tile = 0; tile < tiles_count; ++tile) {
+            int64_t tile_x = pass.first_tile_x + tile % pass.tiles_width;
+            int64_t tile_y = pass.first_tile_y + tile / pass.tiles_width;
+
+            if (is_unstable(tile_x, tile_y) || is_unstable(tile_x - 1, tile_y) || is_unstable(tile_x + 1, tile_y)
+                || is_unstable(tile_x, tile_y - 1) || is_unstable(tile_x, tile_y + 1)) {
+                visited_tiles[visited_tiles_count++] = tile;
+            }
+        }
+
+        if (numa_policy_ != kNoNumaPolicy) {
+            UpdateTileNodes(pass, tiles_count, tile_nodes);
+        }
+
+        PushCheckerboardTiles(visited_tiles, visited_tiles_count, tile_nodes.nodes);
+
+        BufferPool::GetInstance().Release(visited_tiles);
+        std::fill(results, results + threads_count, CheckerboardPassResult{});
+
+        scheduler_->RunRound([this, &pass, &tile_nodes, results](uint32_t thread, uint32_t tile) {
+            if (tile_nodes.nodes != nullptr) {
+                scheduler_->CountMemoryAccess(thread, tile_nodes.nodes[tile]);
+            }
+
+            RelaxCheckerboardTile(pass, tile, results[thread]);
+        });
+
+        for (uint32_t i = 0; i < threads_count; ++i) {
+            activity_map.AddUnstableCells(results[i].unstable_delta);
+            topplings_count_ += results[i].topplings_count;
+        }
+
+        pass.toppling_color ^= 1;
+        ++passes_count;
+    }
+
+    delete[] results;
+    BufferPool::GetInstance().Release(tile_nodes.nodes);
+    grid_.SetFirstTouchScheduler(nullptr);
+
+    return (passes_count + 1) / 2;
+}
+
+void Sandpile::UpdateTileNodes(const CheckerboardPass& pass, uint32_t tiles_count, TileNodes& tile_nodes) {
+    const uint64_t* cells = grid_.GetRowCells(grid_.GetMinY());
+
+    if (tile_nodes.cells == cells && tile_nodes.width == grid_.GetWidth() && tile_nodes.height == grid_.GetHeight()) {
+        return;
+    }
+
+    tile_nodes.cells = cells;
+    tile_nodes.width = grid_.GetWidth();
+    tile_nodes.height = grid_.GetHeight();
+
+    BufferPool::GetInstance().Release(tile_nodes.nodes);
+    tile_nodes.nodes = BufferPool::GetInstance().Allocate<int32_t>(tiles_count);
+
+    const void** addresses = BufferPool::GetInstance().Allocate<const void*>(tiles_count);
+
+    for (uint32_t tile = 0; tile < tiles_count; ++tile) {
+        int32_t x = std::max<int32_t>(grid_.GetMinX(), ActivityMap::GetTileStart(pass.first_tile_x + tile % pass.tiles_width));
+        int32_t y = std::max<int32_t>(grid_.GetMinY(), ActivityMap::GetTileStart(pass.first_tile_y + tile / pass.tiles_width));
+
+        addresses[tile] = grid_.GetRowCells(y) + (x - grid_.GetMinX());
+    }
+
+    NumaTopology::GetInstance().GetMemoryNodes(addresses, tiles_count, tile_nodes.nodes);
+    BufferPool::GetInstance().Release(addresses);
+}
+
+void Sandpile::PushCheckerboardTiles(const uint32_t* tiles, uint32_t tiles_count, const int32_t* tile_nodes) {
+    uint32_t threads_count = scheduler_->GetThreadsCount();
+    uint32_t nodes_count = NumaTopology::GetInstance().GetNodesCount();
+
+    // each thread starts with a contiguous part of the tiles, the rest is balanced by stealing
+    if (tile_nodes == nullptr || nodes_count == 1) {
+        for (uint32_t i = 0; i < tiles_count; ++i) {
+            scheduler_->Push(static_cast<uint64_t>(i) * threads_count / tiles_count, tiles[i]);
+        }
+
+        return;
+    }
+
+    // threads ordered by their nodes, the ones of node n start at node_first_threads[n]
+    uint32_t* node_first_threads = BufferPool::GetInstance().Allocate<uint32_t>(nodes_count + 1);
+    uint32_t* node_tiles_counts = BufferPool::GetInstance().Allocate<uint32_t>(nodes_count);
+    uint32_t* node_pushed_counts = BufferPool::GetInstance().Allocate<uint32_t>(nodes_count);
+    uint32_t* node_threads = BufferPool::GetInstance().Allocate<uint32_t>(threads_count);
+
+    std::fill(node_first_threads, node_first_threads + nodes_count + 1, 0);
+    std::fill(node_tiles_counts, node_tiles_counts + nodes_count, 0);
+    std::fill(node_pushed_counts, node_pushed_counts + nodes_count, 0);
+
+    for (uint32_t thread = 0; thread < threads_count; ++thread) {
+        ++node_first_threads[scheduler_->GetThreadNode(thread) + 1];
+    }
+
+    for (uint32_t node = 0; node < nodes_count; ++node) {
+        node_first_threads[node + 1] += node_first_threads[node];
+    }
+
+    for (uint32_t thread = 0; thread < threads_count; ++thread) {
+        uint32_t node = scheduler_->GetThreadNode(thread);
+        node_threads[node_first_threads[node] + node_pushed_counts[node]++] = thread;
+    }
+
+    std::fill(node_pushed_counts, node_pushed_counts + nodes_count, 0);
+
+    auto get_threads_count = [node_first_threads, nodes_count](int32_t node) {
+        bool is_known = node >= 0 && static_cast<uint32_t>(node) < nodes_count;
+        return is_known ? node_first_threads[node + 1] - node_first_threads[node] : 0;
+    };
+
+    for (uint32_t i = 0; i < tiles_count; ++i) {
+        int32_t node = tile_nodes[tiles[i]];
+
+        if (get_threads_count(node) != 0) {
+            ++node_tiles_counts[node];
+        }
+    }
+
+    for (uint32_t i = 0; i < tiles_count; ++i) {
+        int32_t node = tile_nodes[tiles[i]];
+        uint32_t node_threads_count = get_threads_count(node);
+        uint32_t thread;
+
+        if (node_threads_count == 0) {
+            thread = static_cast<uint64_t>(i) * threads_count / tiles_count;
+        } else {
+            uint64_t index = static_cast<uint64_t>(node_pushed_counts[node]++) * node_threads_count / node_tiles_counts[node];
+            thread = node_threads[node_first_threads[node] + index];
+        }
+
+        scheduler_->Push(thread, tiles[i]);
+    }
+
+    BufferPool::GetInstance().Release(node_first_threads);
+    BufferPool::GetInstance().Release(node_tiles_counts);
+    BufferPool::GetInstance().Release(node_pushed_counts);
+    BufferPool::GetInstance().Release(node_threads);
+}
+
+void Sandpile::RelaxCheckerboardTile(const CheckerboardPass& pass, uint32_t tile, CheckerboardPassResult& result) {
+    ActivityMap& activity_map = *grid_.GetActivityMap();
+
+    int32_t min_x = grid_.GetMinX();
+    int32_t min_y = grid_.GetMinY();
+    int32_t max_x = grid_.GetMaxX();
+    int32_t max_y = grid_.GetMaxY();
+
+    uint32_t tile_x = pass.first_tile_x + tile % pass.tiles_width;
+    uint32_t tile_y = pass.first_tile_y + tile / pass.tiles_width;
+
+    int32_t from_x = std::max(min_x, ActivityMap::GetTileStart(tile_x));
+    int32_t to_x = std::min(max_x, ActivityMap::GetTileStart(tile_x) + int32_t{ActivityMap::kTileSize} - 1);
+    int32_t from_y = std::max(min_y, ActivityMap::GetTileStart(tile_y));
+    int32_t to_y = std::min(max_y, ActivityMap::GetTileStart(tile_y) + int32_t{ActivityMap::kTileSize} - 1);
+
+    uint8_t written_color = pass.toppling_color ^ 1;
+    int32_t unstable_delta = 0;
+    uint64_t topplings_count = 0;
+    bool is_changed = false;
+
+    for (int32_t y = from_y; y <= to_y; ++y) {
+        uint64_t* row = grid_.GetRowCells(y);
+        const uint64_t* lower_row = (y > min_y) ? grid_.GetRowCells(y - 1) : nullptr;
+        const uint64_t* upper_row = (y < max_y) ? grid_.GetRowCells(y + 1) : nullptr;
+
+        // starting from the first cell of the written color
+        for (int32_t x = from_x + ((from_x + y + written_color) & 1); x <= to_x; x += 2) {
+            uint32_t column = x - min_x;
+            uint64_t sand = row[column];
+            uint64_t new_sand = sand;
+
+            // the grains were already given to the neighbours on the previous pass
+            if (pass.has_pending) {
+                uint64_t share = GetToppledShare(sand);
+                new_sand -= 4 * share;
+                topplings_count += (share != 0);
+            }
+
+            new_sand += (x > min_x) ? GetToppledShare(row[column - 1]) : 0;
+            new_sand += (x < max_x) ? GetToppledShare(row[column + 1]) : 0;
+            new_sand += (lower_row != nullptr) ? GetToppledShare(lower_row[column]) : 0;
+            new_sand += (upper_row != nullptr) ? GetToppledShare(upper_row[column]) : 0;
+
+            row[column] = new_sand;
+
+            unstable_delta += static_cast<int32_t>(new_sand >= critical_sand_number_)
+                - static_cast<int32_t>(sand >= critical_sand_number_);
+            is_changed |= (new_sand != sand);
+        }
+    }
+
+    activity_map.UpdateTile(tile_x, tile_y, unstable_delta, is_changed);
+
+    result.unstable_delta += unstable_delta;
+    result.topplings_count += topplings_count;
+}
+
+void Sandpile::ExpandForCheckerboardPass(uint8_t toppling_color) {
+    int32_t min_x = grid_.GetMinX();
+    int32_t min_y = grid_.GetMinY();
+    int32_t max_x = grid_.GetMaxX();
+    int32_t max_y = grid_.GetMaxY();
+
+    auto will_topple = [this, toppling_color](int32_t x, int32_t y) {
+        return ((x + y) & 1) == toppling_color && GetToppledShare(grid_.GetSand(x, y)) != 0;
+    };
+
+    bool to_left = false;
+    bool to_right = false;
+    bool to_bottom = false;
+    bool to_top = false;
+
+    for (int32_t y = min_y; y <= max_y; ++y) {
+        to_left |= will_topple(min_x, y);
+        to_right |= will_topple(max_x, y);
+    }
+
+    for (int32_t x = min_x; x <= max_x; ++x) {
+        to_bottom |= will_topple(x, min_y);
+        to_top |= will_topple(x, max_y);
+    }
+
+    // adding nothing to a cell outside of the grid expands it
+    if (to_left) {
+        grid_.AddSand(min_x - 1, min_y, 0);
+    }
+
+    if (to_right) {
+        grid_.AddSand(max_x + 1, min_y, 0);
+    }
+
+    if (to_bottom) {
+        grid_.AddSand(min_x, min_y - 1, 0);
+    }
+
+    if (to_top) {
+        grid_.AddSand(min_x, max_y + 1, 0);
+    }
+}
+
+uint64_t Sandpile::GetTopplingsCount() const {
+    return topplings_count_;
+}
+
+bool Sandpile::IsGridStable() const {
+    return grid_.GetActivityMap()->IsStable();
+}
+
 std::expected<uint64_t, SandpileError> Sandpile::Run(uint64_t max_iterations, uint64_t state_saving_frequency) {
     uint64_t amount_of_iterations = 0;
+    uint64_t next_event_checkpoint = 0;
+
+    uint64_t next_log_snapshot = 0;
+    std::chrono::steady_clock::time_point last_snapshot_time = std::chrono::steady_clock::now();
+    uint64_t last_snapshot_topplings = topplings_count_;
+
+    std::optional<SandpileError> opening_result = OpenEventLog();
+
+    if (opening_result.has_value()) {
+        return std::unexpected{opening_result.value()};
+    }
     
-    while (!IsGridStable()) {
+    while (true) {
         if (max_iterations != 0 && max_iterations == amount_of_iterations) {
             break;
         }
 
-        if (state_saving_frequency == 0 && max_iterations == 0) {
-            FullyToppleGrid();
-        } else if (output_directory_ == nullptr || state_saving_frequency == 0) {
-            ToppleGrid();
-        } else {
-            if (amount_of_iterations % state_saving_frequency == 0) {
-                // max length of size_t (decimal) is 20
-                size_t filename_length = std::strlen(output_file_prefix_) + 20 + std::strlen(output_file_extension_) + 1;
-                char* filename = new char[filename_length];
+        bool is_injecting = (grain_queue_ != nullptr) && DrainGrainQueue();
+
+        if (event_log_.IsOpen()) {
+            std::optional<EventLogWriterError> writing_result = event_log_.EndGrains(amount_of_iterations);
 
-                std::sprintf(filename, "%s%u%s", output_file_prefix_, amount_of_iterations, output_file_extension_);
+            if (writing_result.has_value()) {
+                return std::unexpected{SandpileError{writing_result.value().message}};
+            }
 
-                std::optional<SandpileError> saving_result = SaveCurrentState(filename);
-                delete[] filename;
+            // blocks of iterations never cross checkpoints, so each one is reached exactly
+            if (amount_of_iterations == next_event_checkpoint) {
+                std::optional<SandpileError> checkpoint_result = SaveEventCheckpoint(amount_of_iterations);
 
-                if (saving_result.has_value()) {
-                    return std::unexpected{saving_result.value()};
+                if (checkpoint_result.has_value()) {
+                    return std::unexpected{checkpoint_result.value()};
                 }
+
+                next_event_checkpoint += event_log_.GetCheckpointInterval();
             }
-            
-            ToppleGrid();
         }
-        
-        ++amount_of_iterations;
+
+        if (IsGridStable()) {
+            if (!is_injecting) {
+                break;
+            }
+
+            std::this_thread::sleep_for(kGrainQueuePollInterval);
+            continue;
+        }
+
+        if (state_saving_frequency == 0 && max_iterations == 0 && !event_log_.IsOpen() && !HasSnapshotSchedule()) {
+            // rows of mapped and shared grids can't be written directly
+            if (checkerboard_relaxation_ && !grid_.IsMapped() && !grid_.IsShared()) {
+                amount_of_iterations += RelaxCheckerboard();
+            } else {
+                FullyToppleGrid();
+                ++amount_of_iterations;
+            }
+
+            continue;
+        }
+
+        bool is_snapshot_due = (state_saving_frequency != 0 && amount_of_iterations % state_saving_frequency == 0);
+
+        // the state before the first iteration is saved by every schedule, as by the frequency
+        if (amount_of_iterations == 0 && HasSnapshotSchedule()) {
+            is_snapshot_due = true;
+        } else if (snapshot_schedule_.log_points_per_decade != 0 && amount_of_iterations == next_log_snapshot) {
+            is_snapshot_due = true;
+        } else if (snapshot_schedule_.topplings_threshold != 0
+            && topplings_count_ - last_snapshot_topplings > snapshot_schedule_.topplings_threshold) {
+            is_snapshot_due = true;
+        } else if (snapshot_schedule_.wall_clock_interval != 0
+            && std::chrono::steady_clock::now() - last_snapshot_time
+                >= std::chrono::milliseconds{snapshot_schedule_.wall_clock_interval}) {
+            is_snapshot_due = true;
+        }
+
+        if (output_directory_ != nullptr && is_snapshot_due) {
+            // max length of uint64_t (decimal) is 20
+            char iteration[21];
+            std::sprintf(iteration, "%llu", static_cast<unsigned long long>(amount_of_iterations));
+
+            std::optional<SandpileError> saving_result = SaveSnapshot(iteration, amount_of_iterations);
+
+            if (saving_result.has_value()) {
+                return std::unexpected{saving_result.value()};
+            }
+
+            // all schedules count from the last saved state, whichever of them saved it
+            last_snapshot_time = std::chrono::steady_clock::now();
+            last_snapshot_topplings = topplings_count_;
+        }
+
+        if (amount_of_iterations == next_log_snapshot) {
+            next_log_snapshot = GetNextLogSnapshot(amount_of_iterations);
+        }
+
+        // blocks never cross iterations where the state has to be saved or the run has to stop
+        uint64_t block_iterations = kMaxBitPlaneBlockDepth;
+
+        if (state_saving_frequency != 0) {
+            block_iterations = std::min(block_iterations, state_saving_frequency - amount_of_iterations % state_saving_frequency);
+        }
+
+        if (max_iterations != 0) {
+            block_iterations = std::min(block_iterations, max_iterations - amount_of_iterations);
+        }
+
+        if (snapshot_schedule_.log_points_per_decade != 0) {
+            block_iterations = std::min(block_iterations, next_log_snapshot - amount_of_iterations);
+        }
+
+        if (event_log_.IsOpen()) {
+            block_iterations = std::min(block_iterations, next_event_checkpoint - amount_of_iterations);
+        }
+
+        // the wall-clock and topplings schedules may become due at any iteration
+        if (snapshot_schedule_.wall_clock_interval != 0 || snapshot_schedule_.topplings_threshold != 0) {
+            block_iterations = 1;
+        }
+
+        bool is_bit_planes_block = (iteration_engine_ == kAutoEngine
+            && block_iterations >= kMinBitPlaneBlockDepth && CanUseBitPlanes());
+
+        if (iteration_engine_ == kSweepEngine) {
+            block_iterations = 1;
+        } else if (!is_bit_planes_block) {
+            block_iterations = std::min(block_iterations, GetTemporalBlockDepth());
+        }
+
+        if (event_log_.IsOpen()) {
+            event_log_.BeginIterations(amount_of_iterations + 1, block_iterations);
+        }
+
+        uint64_t performed_iterations = is_bit_planes_block ? ToppleBitPlanes(block_iterations) : ToppleGrid(block_iterations);
+
+        if (event_log_.IsOpen()) {
+            std::optional<EventLogWriterError> writing_result = event_log_.EndIterations(performed_iterations);
+
+            if (writing_result.has_value()) {
+                return std::unexpected{SandpileError{writing_result.value().message}};
+            }
+        }
+
+        amount_of_iterations += performed_iterations;
     }
 
     if (output_directory_ != nullptr) {
-        size_t filename_length = std::strlen(output_file_prefix_) + 5 + std::strlen(output_file_extension_) + 1;
-        char* filename = new char[filename_length];
-        std::sprintf(filename, "%sfinal%s", output_file_prefix_, output_file_extension_);
-
-        std::optional<SandpileError> saving_result = SaveCurrentState(filename);
-        delete[] filename;
+        std::optional<SandpileError> saving_result = SaveSnapshot("final", amount_of_iterations);
 
         if (saving_result.has_value()) {
             return std::unexpected{saving_result.value()};
@@ -156,6 +776,403 @@ std::expected<uint64_t, SandpileError> Sandpile::Run(uint64_t max_iterations, ui
     return amount_of_iterations;
 }
 
+std::optional<SandpileError> Sandpile::SavePreviews(uint64_t block_size) {
+    if (output_directory_ == nullptr) {
+        return SandpileError{"Cannot save previews: no output directory is specified"};
+    } else if (grid_.IsEmpty()) {
+        return std::nullopt;
+    }
+
+    // blocks must fit into the coordinates
+    block_size = std::min<uint64_t>(block_size, 1 << 15);
+
+    for (; block_size > 1; block_size /= 2) {
+        Grid coarse_grid;
+        BuildCoarseGrid(coarse_grid, block_size);
+
+        Sandpile coarse_sandpile(coarse_grid);
+        coarse_sandpile.SetCriticalSandNumber(critical_sand_number_);
+        coarse_sandpile.SetCheckerboardRelaxation(checkerboard_relaxation_);
+
+        std::expected<uint64_t, SandpileError> run_result = coarse_sandpile.Run();
+
+        if (!run_result.has_value()) {
+            return run_result.error();
+        }
+
+        // "preview_" takes 8 characters, max length of uint64_t (decimal) is 20
+        size_t filename_length = std::strlen(output_file_prefix_) + 8 + 20 + std::strlen(output_file_extension_) + 1;
+        char* filename = BufferPool::GetInstance().Allocate<char>(filename_length);
+        std::sprintf(filename, "%spreview_%llu%s", output_file_prefix_, static_cast<unsigned long long>(block_size), output_file_extension_);
+
+        coarse_sandpile.SetOutputDirectory(output_directory_);
+        coarse_sandpile.SetPngCompressionLevel(png_compression_level_);
+        coarse_sandpile.SetOutputFileExtension(output_file_extension_);
+
+        std::optional<SandpileError> saving_result = coarse_sandpile.SaveCurrentState(filename);
+        BufferPool::GetInstance().Release(filename);
+
+        if (saving_result.has_value()) {
+            return saving_result;
+        }
+    }
+
+    return std::nullopt;
+}
+
+void Sandpile::BuildCoarseGrid(Grid& coarse_grid, uint64_t block_size) const {
+    int32_t size = block_size;
+
+    auto get_block = [size](int32_t coordinate) {
+        // rounded down for negative coordinates too
+        return (coordinate >= 0) ? coordinate / size : -((-coordinate + size - 1) / size);
+    };
+
+    for (int32_t y = grid_.GetMinY(); y <= grid_.GetMaxY(); ++y) {
+        grid_.TouchRows(y, y);
+
+        for (int32_t x = grid_.GetMinX(); x <= grid_.GetMaxX(); ++x) {
+            uint64_t sand = grid_.GetSand(x, y);
+
+            if (sand != 0) {
+                coarse_grid.AddSand(get_block(x), get_block(y), sand);
+            }
+        }
+    }
+
+    // the block keeps the average amount of sand of its cells, rounded to the nearest
+    uint64_t cells_count = block_size * block_size;
+
+    for (int32_t y = coarse_grid.GetMinY(); y <= coarse_grid.GetMaxY(); ++y) {
+        for (int32_t x = coarse_grid.GetMinX(); x <= coarse_grid.GetMaxX(); ++x) {
+            coarse_grid.SetSand(x, y, (coarse_grid.GetSand(x, y) + cells_count / 2) / cells_count);
+        }
+    }
+}
+
+std::optional<SandpileError> Sandpile::SaveSnapshot(const char* label, uint64_t iteration) {
+    // "activity_" takes 9 characters
+    size_t filename_length = std::strlen(output_file_prefix_) + 9 + std::strlen(label) + std::strlen(output_file_extension_) + 1;
+    char* filename = BufferPool::GetInstance().Allocate<char>(filename_length);
+
+    std::sprintf(filename, "%s%s%s", output_file_prefix_, label, output_file_extension_);
+    std::optional<SandpileError> saving_result;
+
+    SandStatistics statistics;
+    SandStatistics* gathered_statistics = statistics_saving_ ? &statistics : nullptr;
+
+    if (delta_keyframe_interval_ != 0) {
+        saving_result = SaveDeltaFrame(label, gathered_statistics);
+    } else {
+        saving_result = SaveCurrentState(filename, gathered_statistics);
+    }
+
+    if (!saving_result.has_value() && statistics_saving_) {
+        saving_result = SaveStatistics(statistics, iteration);
+    }
+
+    if (!saving_result.has_value() && activity_map_saving_) {
+        std::sprintf(filename, "%sactivity_%s%s", output_file_prefix_, label, output_file_extension_);
+        saving_result = SaveActivityMap(filename);
+    }
+
+    BufferPool::GetInstance().Release(filename);
+    grid_.GetActivityMap()->ClearDirty();
+
+    return saving_result;
+}
+
+std::optional<SandpileError> Sandpile::OpenEventLog() {
+    if (event_checkpoint_interval_ == 0 || event_log_.IsOpen()) {
+        return std::nullopt;
+    } else if (output_directory_ == nullptr) {
+        return SandpileError{"Cannot record events: no output directory is specified"};
+    }
+
+    const char* event_log_filename = "events.log";
+
+    size_t path_length = std::strlen(output_directory_) + std::strlen(output_file_prefix_) + std::strlen(event_log_filename) + 1;
+    char* path = BufferPool::GetInstance().Allocate<char>(path_length);
+    std::sprintf(path, "%s%s%s", output_directory_, output_file_prefix_, event_log_filename);
+
+    std::optional<EventLogWriterError> opening_result = event_log_.Open(
+        path, critical_sand_number_, event_checkpoint_interval_, grid_.IsBounded(), output_file_prefix_, output_file_extension_);
+    BufferPool::GetInstance().Release(path);
+
+    if (opening_result.has_value()) {
+        return SandpileError{opening_result.value().message};
+    }
+
+    return std::nullopt;
+}
+
+std::optional<SandpileError> Sandpile::SaveEventCheckpoint(uint64_t iteration) {
+    if (grid_.IsEmpty()) {
+        event_log_.BeginCheckpoint(iteration, nullptr);
+    } else {
+        EventLogBounds bounds{grid_.GetMinX(), grid_.GetMinY(), grid_.GetMaxX(), grid_.GetMaxY()};
+        event_log_.BeginCheckpoint(iteration, &bounds);
+
+        for (int16_t y = grid_.GetMinY(); y <= grid_.GetMaxY(); ++y) {
+            grid_.TouchRows(y, y);
+
+            for (int16_t x = grid_.GetMinX(); x <= grid_.GetMaxX(); ++x) {
+                event_log_.AddCheckpointCell(grid_.GetSand(x, y));
+            }
+        }
+    }
+
+    std::optional<EventLogWriterError> writing_result = event_log_.EndCheckpoint();
+
+    if (writing_result.has_value()) {
+        return SandpileError{writing_result.value().message};
+    }
+
+    return std::nullopt;
+}
+
+std::optional<SandpileError> Sandpile::SaveStatistics(const SandStatistics& statistics, uint64_t iteration) {
+    if (!statistics_writer_.IsOpen()) {
+        const char* statistics_filename = "stats.csv";
+
+        size_t path_length = std::strlen(output_directory_) + std::strlen(output_file_prefix_) + std::strlen(statistics_filename) + 1;
+        char* path = BufferPool::GetInstance().Allocate<char>(path_length);
+        std::sprintf(path, "%s%s%s", output_directory_, output_file_prefix_, statistics_filename);
+
+        std::optional<StatisticsWriterError> opening_result = statistics_writer_.Open(path);
+        BufferPool::GetInstance().Release(path);
+
+        if (opening_result.has_value()) {
+            return SandpileError{opening_result.value().message};
+        }
+    }
+
+    uint64_t cells_count = static_cast<uint64_t>(grid_.GetWidth()) * grid_.GetHeight();
+    std::optional<StatisticsWriterError> writing_result = statistics_writer_.Write(
+        iteration, statistics, grid_.GetActivityMap()->GetUnstableCellsCount(), cells_count);
+
+    if (writing_result.has_value()) {
+        return SandpileError{writing_result.value().message};
+    }
+
+    return std::nullopt;
+}
+
+std::optional<SandpileError> Sandpile::SaveDeltaFrame(const char* label, SandStatistics* statistics) {
+    if (!delta_writer_.IsOpen()) {
+        const char* delta_filename = "frames.delta";
+
+        size_t path_length = std::strlen(output_directory_) + std::strlen(output_file_prefix_) + std::strlen(delta_filename) + 1;
+        char* path = BufferPool::GetInstance().Allocate<char>(path_length);
+        std::sprintf(path, "%s%s%s", output_directory_, output_file_prefix_, delta_filename);
+
+        std::optional<DeltaWriterError> opening_result = delta_writer_.Open(
+            path, delta_keyframe_interval_, ActivityMap::kTileSizeLog,
+            kSandPalette, kColorsUsed, output_file_prefix_, output_file_extension_);
+        BufferPool::GetInstance().Release(path);
+
+        if (opening_result.has_value()) {
+            return SandpileError{opening_result.value().message};
+        }
+    }
+
+    const ActivityMap& activity_map = *grid_.GetActivityMap();
+    bool is_keyframe = delta_writer_.IsNextFrameKeyframe();
+
+    int32_t min_x = grid_.GetMinX();
+    int32_t min_y = grid_.GetMinY();
+    int32_t max_x = grid_.GetMaxX();
+    int32_t max_y = grid_.GetMaxY();
+
+    delta_writer_.BeginFrame(label, DeltaBounds{grid_.GetMinX(), grid_.GetMinY(), grid_.GetMaxX(), grid_.GetMaxY()});
+
+    if (statistics != nullptr) {
+        tile_statistics_.Fit(ActivityMap::GetTileIndex(min_x), ActivityMap::GetTileIndex(min_y),
+            ActivityMap::GetTileIndex(max_x) - ActivityMap::GetTileIndex(min_x) + 1,
+            ActivityMap::GetTileIndex(max_y) - ActivityMap::GetTileIndex(min_y) + 1);
+    }
+
+    // dirty bits are cleared after each saved state, so they mark exactly the tiles changed since the previous frame
+    for (uint32_t tile_y = ActivityMap::GetTileIndex(min_y); tile_y <= ActivityMap::GetTileIndex(max_y); ++tile_y) {
+        for (uint32_t tile_x = ActivityMap::GetTileIndex(min_x); tile_x <= ActivityMap::GetTileIndex(max_x); ++tile_x) {
+            if (!is_keyframe && !activity_map.IsTileDirty(tile_x, tile_y)) {
+                continue;
+            }
+
+            uint8_t* colors = delta_writer_.AddTile(tile_x, tile_y);
+            SandStatistics* tile_statistics = (statistics != nullptr) ? &tile_statistics_.ResetTile(tile_x, tile_y) : nullptr;
+
+            int32_t from_x = std::max(min_x, ActivityMap::GetTileStart(tile_x));
+            int32_t to_x = std::min(max_x, ActivityMap::GetTileStart(tile_x) + int32_t{ActivityMap::kTileSize} - 1);
+            int32_t from_y = std::max(min_y, ActivityMap::GetTileStart(tile_y));
+            int32_t to_y = std::min(max_y, ActivityMap::GetTileStart(tile_y) + int32_t{ActivityMap::kTileSize} - 1);
+
+            for (int32_t y = from_y; y <= to_y; ++y) {
+                grid_.TouchRows(y, y);
+
+                for (int32_t x = from_x; x <= to_x; ++x) {
+                    uint64_t sand = grid_.GetSand(x, y);
+                    *colors++ = GetSandColor(sand);
+
+                    if (tile_statistics != nullptr) {
+                        tile_statistics->AddCell(x, y, sand);
+                    }
+                }
+            }
+        }
+    }
+
+    if (statistics != nullptr) {
+        *statistics = tile_statistics_.GetTotal(static_cast<uint64_t>(grid_.GetWidth()) * grid_.GetHeight());
+    }
+
+    std::optional<DeltaWriterError> writing_result = delta_writer_.EndFrame();
+
+    if (writing_result.has_value()) {
+        return SandpileError{writing_result.value().message};
+    }
+
+    return std::nullopt;
+}
+
+std::optional<SandpileError> Sandpile::SaveActivityMap(const char* filename) const {
+    if (output_directory_ == nullptr) {
+        return SandpileError{"Cannot save the activity map to a file: no output directory is specified"};
+    }
+
+    uint32_t width = ActivityMap::GetTileIndex(grid_.GetMaxX()) - ActivityMap::GetTileIndex(grid_.GetMinX()) + 1;
+    uint32_t height = ActivityMap::GetTileIndex(grid_.GetMaxY()) - ActivityMap::GetTileIndex(grid_.GetMinY()) + 1;
+
+    if (IsPngOutput()) {
+        PngWriter png_writer{width, height, kColorsUsed};
+        png_writer.SetCompressionLevel(png_compression_level_);
+        DrawActivityMap(png_writer);
+
+        return SaveImage(png_writer, filename);
+    }
+
+    BmpWriter bmp_writer{width, height, kColorsUsed};
+    DrawActivityMap(bmp_writer);
+
+    return SaveImage(bmp_writer, filename);
+}
+
+template<typename ImageWriter>
+void Sandpile::DrawActivityMap(ImageWriter& image_writer) const {
+    const ActivityMap& activity_map = *grid_.GetActivityMap();
+
+    uint32_t min_tile_x = ActivityMap::GetTileIndex(grid_.GetMinX());
+    uint32_t min_tile_y = ActivityMap::GetTileIndex(grid_.GetMinY());
+    uint32_t max_tile_x = ActivityMap::GetTileIndex(grid_.GetMaxX());
+    uint32_t max_tile_y = ActivityMap::GetTileIndex(grid_.GetMaxY());
+
+    SetSandColors(image_writer);
+
+    // unstable tiles are black, changed since the last saved state are green, others are white
+    for (uint32_t tile_y = min_tile_y; tile_y <= max_tile_y; ++tile_y) {
+        for (uint32_t tile_x = min_tile_x; tile_x <= max_tile_x; ++tile_x) {
+            SandColor color = kWhite;
+
+            if (activity_map.IsTileUnstable(tile_x, tile_y)) {
+                color = kBlack;
+            } else if (activity_map.IsTileDirty(tile_x, tile_y)) {
+                color = kGreen;
+            }
+
+            image_writer.SetPixel(tile_x - min_tile_x, tile_y - min_tile_y, color);
+        }
+    }
+}
+
+template<typename ImageWriter>
+std::optional<SandpileError> Sandpile::SaveImage(const ImageWriter& image_writer, const char* filename) const {
+    size_t output_directory_length = std::strlen(output_directory_);
+    size_t filename_length = std::strlen(filename);
+
+    char* path = BufferPool::GetInstance().Allocate<char>(output_directory_length + filename_length + 1);
+    std::strcpy(path, output_directory_);
+    std::strcat(path, filename);
+
+    auto saving_result = image_writer.Save(path);
+    BufferPool::GetInstance().Release(path);
+
+    if (saving_result.has_value()) {
+        return SandpileError{saving_result.value().message};
+    }
+
+    return std::nullopt;
+}
+
+bool Sandpile::IsPngOutput() const {
+    const char* png_extension = ".png";
+
+    size_t extension_length = std::strlen(output_file_extension_);
+    size_t png_extension_length = std::strlen(png_extension);
+
+    return extension_length >= png_extension_length
+        && std::strcmp(output_file_extension_ + extension_length - png_extension_length, png_extension) == 0;
+}
+
+void Sandpile::SetGrainQueue(GrainQueue* queue) {
+    grain_queue_ = queue;
+}
+
+bool Sandpile::DrainGrainQueue() {
+    // grains pushed before a producer finished are visible once its finish is seen
+    bool is_finished = grain_queue_->IsFinished();
+
+    grain_queue_->Drain([this](const Grain& grain) {
+        grid_.AddSand(grain.x, grain.y, grain.amount);
+
+        if (event_log_.IsOpen()) {
+            event_log_.AddGrain(grain.x, grain.y, grain.amount);
+        }
+    });
+
+    return !is_finished;
+}
+
+const WorkStealingScheduler* Sandpile::GetScheduler() const {
+    return is_scheduler_used_ ? scheduler_ : nullptr;
+}
+
+void Sandpile::SetScheduler(WorkStealingScheduler* scheduler) {
+    if (is_scheduler_owned_) {
+        delete scheduler_;
+    }
+
+    scheduler_ = scheduler;
+    is_scheduler_owned_ = false;
+}
+
+void Sandpile::SetNumaPolicy(NumaPolicy policy) {
+    numa_policy_ = policy;
+}
+
+void Sandpile::SetIterationEngine(IterationEngine engine) {
+    iteration_engine_ = engine;
+}
+
+void Sandpile::SetCheckerboardRelaxation(bool enabled) {
+    checkerboard_relaxation_ = enabled;
+}
+
+void Sandpile::SetActivityMapSaving(bool enabled) {
+    activity_map_saving_ = enabled;
+}
+
+void Sandpile::SetStatisticsSaving(bool enabled) {
+    statistics_saving_ = enabled;
+}
+
+void Sandpile::SetEventLog(uint64_t checkpoint_interval) {
+    event_checkpoint_interval_ = checkpoint_interval;
+}
+
+void Sandpile::SetSnapshotSchedule(const SnapshotSchedule& schedule) {
+    snapshot_schedule_ = schedule;
+}
+
 void Sandpile::SetOutputDirectory(const char* path) {
     output_directory_ = path;
 }
@@ -168,10 +1185,19 @@ void Sandpile::SetOutputFileExtension(const char* extension) {
     output_file_extension_ = extension;
 }
 
+void Sandpile::SetPngCompressionLevel(uint8_t level) {
+    png_compression_level_ = level;
+}
+
+void Sandpile::SetDeltaSnapshots(uint64_t keyframe_interval) {
+    delta_keyframe_interval_ = keyframe_interval;
+}
+
 void Sandpile::SaveStateToGrid(Grid& grid) const {
     grid = grid_;
 }
 
 void Sandpile::SetCriticalSandNumber(uint64_t number) {
     critical_sand_number_ = number;
+    grid_.EnableActivityTracking(critical_sand_number_);
 }
\ No newline at end of file
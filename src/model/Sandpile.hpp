@@ -2,12 +2,29 @@
 
 #include "parsing/argparsing.hpp"
 #include "model/Grid.hpp"
+#include "model/GrainQueue.hpp"
+#include "model/BitPlaneGrid.hpp"
+#include "model/WorkStealingScheduler.hpp"
+#include "memory/NumaTopology.hpp"
 #include "bmp/BmpWriter.hpp"
+#include "png/PngWriter.hpp"
+#include "delta/DeltaWriter.hpp"
+#include "stats/StatisticsWriter.hpp"
+#include "stats/TileStatisticsCache.hpp"
+#include "events/EventLogWriter.hpp"
 
 #include <cstddef>
 
 const size_t kColorsUsed = 5;
 
+// Approximate amount of grid data a temporal block of iterations should fit in (about L2 cache size)
+const uint64_t kTemporalBlockByteSize = 1 << 20;
+const uint64_t kMaxTemporalBlockDepth = 16;
+
+// Blocks of iterations on bit planes (see BitPlaneGrid) are longer, so loading and storing them is amortized
+const uint64_t kMinBitPlaneBlockDepth = 4;
+const uint64_t kMaxBitPlaneBlockDepth = 256;
+
 enum SandColor {
     kWhite = 0,
     kGreen = 1,
@@ -22,18 +39,110 @@ const Color kPurpleRGB{146, 42, 191};
 const Color kYellowRGB{186, 186, 34};
 const Color kBlackRGB{0, 0, 0};
 
+// colors in the order of SandColor
+const Color kSandPalette[kColorsUsed] = {kWhiteRGB, kGreenRGB, kPurpleRGB, kYellowRGB, kBlackRGB};
+
 struct SandpileError {
     const char* message = nullptr;
 };
 
+/**
+ * Schedules of saving intermediate states in addition to the fixed frequency of Sandpile::Run().
+ * A state is saved when any of them is due. Zero turns a schedule off
+ */
+struct SnapshotSchedule {
+    // states at iterations evenly spaced on the log scale, this many per power of 10 (for 10: 0, 1, 2, 3, 4, 5, 6, 8, 10, 13, ...)
+    uint64_t log_points_per_decade = 0;
+
+    // milliseconds of wall-clock time since the last saved state
+    uint64_t wall_clock_interval = 0;
+
+    // more topplings than this since the last saved state
+    uint64_t topplings_threshold = 0;
+};
+
 class Sandpile {
 public:
     explicit Sandpile(Grid& grid);
+    ~Sandpile();
+
+    Sandpile(const Sandpile& other) = delete;
+    Sandpile& operator=(const Sandpile& other) = delete;
 
     void SetOutputDirectory(const char* path);
     void SetOutputFilePrefix(const char* prefix);
     void SetOutputFileExtension(const char* extension);
     void SetCriticalSandNumber(uint64_t number);
+
+    /** Compression level (0-9) used if the output extension is .png */
+    void SetPngCompressionLevel(uint8_t level);
+
+    /**
+     * If %keyframe_interval% is not 0, states are saved as frames of <prefix>frames.delta
+     * instead of separate images: only the tiles changed since the previous state are stored,
+     * except every %keyframe_interval%-th frame, which is stored in full (see DeltaWriter)
+     */
+    void SetDeltaSnapshots(uint64_t keyframe_interval);
+
+    /**
+     * Grains pushed to %queue% are added to the grid between batches of iterations.
+     * The run doesn't end until all producers of the queue are finished and the grid is stable.
+     * The queue must outlive the run
+     */
+    void SetGrainQueue(GrainQueue* queue);
+
+    /**
+     * If enabled, a run without intermediate states relaxes the grid in parallel passes
+     * over the colors of a checkerboard (see RelaxCheckerboard()) instead of sequential sweeps.
+     * The final state is the same, but the amount of iterations differs
+     */
+    void SetCheckerboardRelaxation(bool enabled);
+
+    /** @return Scheduler of the checkerboard relaxation with per-thread statistics, or nullptr if it wasn't used */
+    const WorkStealingScheduler* GetScheduler() const;
+
+    /**
+     * Runs the checkerboard relaxation on %scheduler%, which is kept by the caller and may be shared by
+     * sandpiles running one after another. Otherwise the sandpile starts its own threads when they're first needed
+     */
+    void SetScheduler(WorkStealingScheduler* scheduler);
+
+    /**
+     * NUMA placement for the checkerboard relaxation. With kNumaFirstTouch the grid is filled by the threads
+     * in strips (see Grid::SetFirstTouchScheduler) and each tile goes to a thread running on the node holding it,
+     * kNumaPinned also pins the threads to CPUs. Tasks on local and remote tiles are counted in the scheduler stats
+     */
+    void SetNumaPolicy(NumaPolicy policy);
+
+    /**
+     * Engine of the per-iteration mode. kWavefrontEngine never uses bit planes, and kSweepEngine performs each iteration
+     * as a separate sweep, without temporal blocks and bit planes, so they can be the reference for them. The states are the same
+     */
+    void SetIterationEngine(IterationEngine engine);
+
+    /** If enabled, the activity map is saved along with each state as <prefix>activity_<iteration><extension> */
+    void SetActivityMapSaving(bool enabled);
+
+    /**
+     * If enabled, statistics of each saved state are appended to <prefix>stats.csv (see StatisticsWriter).
+     * They are gathered by the same loops which read the cells for saving, so they take no extra passes over the grid
+     */
+    void SetStatisticsSaving(bool enabled);
+
+    /**
+     * If %checkpoint_interval% is not 0, every toppling is recorded into <prefix>events.log
+     * along with the grains from the grain queue and a full checkpoint every %checkpoint_interval% iterations,
+     * so any state can be rebuilt later without saving it (see EventLogWriter). The run is done iteration by iteration
+     * even if no intermediate states are needed
+     */
+    void SetEventLog(uint64_t checkpoint_interval);
+
+    /**
+     * Saves intermediate states by %schedule% along with the fixed frequency of Run().
+     * While the wall-clock or topplings schedule is set, iterations are performed one at a time,
+     * so a state is saved right after the iteration where the schedule became due
+     */
+    void SetSnapshotSchedule(const SnapshotSchedule& schedule);
     
     /**
      * Runs the model: topples all cells until either 
@@ -42,8 +151,8 @@ public:
      * If intermediate states have to be calculated, only a %critical_sand_number% grains of sand
      * gets toppled on each iteration.
      * 
-     * If no intermediate states are needed (max_iteration == state_saving_frequency == 0),
-     * a more efficient algorithm is used, so the number of iterations is much less
+     * If no intermediate states are needed (max_iteration == state_saving_frequency == 0
+     * and there is no snapshot schedule), a more efficient algorithm is used, so the number of iterations is much less
      * 
      * @param max_iterations Maximum number of iterations
      * @param state_saving_frequency Frequency of saving intermediate states to a file.
@@ -54,30 +163,227 @@ public:
         uint64_t max_iterations = 0,
         uint64_t state_saving_frequency = 0);
 
-    /** Performs one iteration of running the model: critical amount of sand is toppled from each cell */
+    /**
+     * Saves quick approximations of the final state, which doesn't need the exact run.
+     * The grid is coarsened into blocks of %block_size% x %block_size% cells, each one holding the average amount of sand
+     * of its cells (which is the same as the threshold multiplied by the block area for the total amount of sand).
+     * The final state of the coarse grid is approximately the final state of the grid scaled down %block_size% times,
+     * it is saved as <prefix>preview_<block size><extension>, one pixel per block.
+     * Then it's refined: repeated for halved block sizes while they are greater than 1, each level taking about 16 times longer.
+     * Intermediate states are never saved for previews
+     */
+    std::optional<SandpileError> SavePreviews(uint64_t block_size);
+
+    /**
+     * Performs one iteration of running the model: critical amount of sand is toppled from each cell.
+     * Only tiles containing unstable cells are visited (see ActivityMap)
+     */
     void ToppleGrid();
 
+    /**
+     * Performs %iterations% iterations of running the model at once.
+     * The grid is passed by a wavefront, so each row is loaded from memory once per block
+     * instead of once per iteration. The result is exactly the same as of consecutive ToppleGrid() calls
+     * 
+     * @return Amount of iterations before the grid became stable (at most %iterations%)
+     */
+    uint64_t ToppleGrid(uint64_t iterations);
+
     void ToppleCell(int16_t x, int16_t y);
     void ToppleCell(int16_t x, int16_t y, uint64_t amount);
 
-    /** Saves current state to a bmp file */
-    std::optional<SandpileError> SaveCurrentState(const char* filename) const;
+    /** @return Total amount of cell topplings performed */
+    uint64_t GetTopplingsCount() const;
 
+    /**
+     * Saves current state to a bmp file, or to a png one if the output extension is .png.
+     * Statistics of the cells are gathered into %statistics% if it's not nullptr
+     */
+    std::optional<SandpileError> SaveCurrentState(const char* filename, SandStatistics* statistics = nullptr) const;
+
+    /**
+     * Saves the activity map to an image file: one pixel per tile.
+     * Tiles with unstable cells are black, tiles changed since the last saved state are green
+     */
+    std::optional<SandpileError> SaveActivityMap(const char* filename) const;
+
+    /**
+     * Takes a copy-on-write snapshot of the current state in O(tiles): %grid% keeps the state,
+     * while only the tiles changed by the following iterations are cloned (see Grid(const Grid&))
+     */
     void SaveStateToGrid(Grid& grid) const;
 
     /** Checks if each grid cell contains less grains of sand than a critical amount of sand */
     bool IsGridStable() const;
 
 private:
+    // State of a checkerboard pass shared by all threads
+    struct CheckerboardPass {
+        uint8_t toppling_color = 0;
+        bool has_pending = false;
+
+        // tasks are indices of tiles row by row within the tiles of the grid
+        uint32_t first_tile_x = 0;
+        uint32_t first_tile_y = 0;
+        uint32_t tiles_width = 0;
+    };
+
+    struct alignas(64) CheckerboardPassResult {
+        int64_t unstable_delta = 0;
+        uint64_t topplings_count = 0;
+    };
+
+    // NUMA nodes of the tiles of a checkerboard pass (of their first cells), found again only when the grid changes its buffer
+    struct TileNodes {
+        int32_t* nodes = nullptr;
+        const uint64_t* cells = nullptr;
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+
     Grid& grid_;
 
     void FullyToppleCell(int16_t x, int16_t y);
     void FullyToppleGrid();
 
+    /** Same as ToppleCell(), but marks the cell in the recorded row if it toppled */
+    void RecordedToppleCell(int16_t x, int16_t y);
+
+    /** Calls %topple% for each cell of the tiles containing unstable cells in the row-major order */
+    template<void (Sandpile::*Topple)(int16_t, int16_t)>
+    void SweepActiveTiles();
+
+    template<void (Sandpile::*Topple)(int16_t, int16_t)>
+    void SweepRow(int32_t y, int32_t min_x, int32_t max_x);
+
+    /**
+     * Adds all grains pushed to the grain queue so far to the grid
+     * @return true if there may be more grains (not all producers are finished)
+     */
+    bool DrainGrainQueue();
+
+    /**
+     * Relaxes the grid until it's stable. Cell (x, y) has the color (x + y) % 2, so cells of the same color
+     * are never neighbours: on each pass all cells of one color are fully toppled at once, then the cells of the other one.
+     * Cells of the other color only gather the grains, so each cell is written by one thread, and tiles which may change
+     * are distributed between threads by a work-stealing scheduler. A toppled cell loses its grains on the next pass,
+     * when its color is written
+     * @return Amount of iterations (pairs of passes)
+     */
+    uint64_t RelaxCheckerboard();
+
+    void RelaxCheckerboardTile(const CheckerboardPass& pass, uint32_t tile, CheckerboardPassResult& result);
+
+    void UpdateTileNodes(const CheckerboardPass& pass, uint32_t tiles_count, TileNodes& tile_nodes);
+
+    /**
+     * Pushes %tiles% to the threads of the scheduler in contiguous parts. With %tile_nodes% the tiles of each node
+     * are split between the threads which ran on it, the tiles of the nodes without threads between all threads
+     */
+    void PushCheckerboardTiles(const uint32_t* tiles, uint32_t tiles_count, const int32_t* tile_nodes);
+
+    /** Expands the grid, so all neighbours of the border cells of %toppling_color% which will topple exist */
+    void ExpandForCheckerboardPass(uint8_t toppling_color);
+
+    /** @return Amount of sand FullyToppleCell() gives to each neighbour of a cell with %sand% grains */
+    uint64_t GetToppledShare(uint64_t sand) const;
+
+    bool HasSnapshotSchedule() const;
+
+    /** @return The first iteration after %iteration% where the log-spaced schedule saves a state */
+    uint64_t GetNextLogSnapshot(uint64_t iteration) const;
+
+    /** @return Amount of iterations in a temporal block for the current grid width */
+    uint64_t GetTemporalBlockDepth() const;
+
+    /**
+     * Checks if the iterations can be performed on bit planes: the standard model
+     * on an unbounded grid stored in memory, with no cell higher than BitPlaneGrid::kMaxHeight
+     */
+    bool CanUseBitPlanes();
+
+    /** Same as ToppleGrid(%iterations%), but on bit planes */
+    uint64_t ToppleBitPlanes(uint64_t iterations);
+
+    /** Fills the empty %coarse_grid% with blocks of the grid (see SavePreviews()) */
+    void BuildCoarseGrid(Grid& coarse_grid, uint64_t block_size) const;
+
+    /**
+     * Saves the current state (and the activity map if needed) as <prefix><label><extension>,
+     * and its statistics as of the %iteration% if needed
+     */
+    std::optional<SandpileError> SaveSnapshot(const char* label, uint64_t iteration);
+
+    /** Opens the event log if it's needed and not open yet */
+    std::optional<SandpileError> OpenEventLog();
+
+    /** Writes the current state to the event log as the checkpoint of the %iteration% */
+    std::optional<SandpileError> SaveEventCheckpoint(uint64_t iteration);
+
+    /** Appends a line of %statistics% of the current state to the statistics file */
+    std::optional<SandpileError> SaveStatistics(const SandStatistics& statistics, uint64_t iteration);
+
+    /**
+     * Appends the current state to the delta snapshots file as a frame labeled %label%. Statistics of the whole grid
+     * are gathered into %statistics% if it's not nullptr, reading again only the tiles stored in the frame
+     */
+    std::optional<SandpileError> SaveDeltaFrame(const char* label, SandStatistics* statistics);
+
+    SandColor GetSandColor(uint64_t sand) const;
+
+    bool IsPngOutput() const;
+
+    /**
+     * Sets the colors of the image from %draw_row%(y, colors), which fills the colors of the row GetMinY() + y.
+     * Near the memory limit the image is given %draw_row% as its row source instead of storing the pixels
+     */
+    template<typename ImageWriter, typename RowSource>
+    void DrawCurrentState(ImageWriter& image_writer, const RowSource& draw_row) const;
+
+    template<typename ImageWriter>
+    void DrawActivityMap(ImageWriter& image_writer) const;
+
+    template<typename ImageWriter>
+    std::optional<SandpileError> SaveImage(const ImageWriter& image_writer, const char* filename) const;
+
     uint64_t critical_sand_number_ = 4;
+    uint64_t topplings_count_ = 0;
 
     const char* output_file_prefix_ = "sandpile_";
     const char* output_file_extension_ = ".bmp";
 
     const char* output_directory_ = nullptr;
+    uint8_t png_compression_level_ = 6;
+
+    bool activity_map_saving_ = false;
+    bool checkerboard_relaxation_ = false;
+    WorkStealingScheduler* scheduler_ = nullptr;
+    bool is_scheduler_owned_ = false;
+    bool is_scheduler_used_ = false;
+    NumaPolicy numa_policy_ = kNoNumaPolicy;
+    IterationEngine iteration_engine_ = kAutoEngine;
+
+    uint64_t delta_keyframe_interval_ = 0;
+    DeltaWriter delta_writer_;
+
+    bool statistics_saving_ = false;
+    StatisticsWriter statistics_writer_;
+
+    // statistics of the tiles which aren't read again for delta frames
+    TileStatisticsCache tile_statistics_;
+
+    SnapshotSchedule snapshot_schedule_;
+
+    uint64_t event_checkpoint_interval_ = 0;
+    EventLogWriter event_log_;
+
+    // bitmap of the cells toppled in the row being swept while recording, starting from the column recorded_row_first_x_
+    uint64_t* recorded_row_ = nullptr;
+    int32_t recorded_row_first_x_ = 0;
+
+    GrainQueue* grain_queue_ = nullptr;
+
+    // the last cell seen higher than the bit planes allow, checked first
+    int16_t tall_cell_x_ = 0;
+    int16_t tall_cell_y_ = 0;
 };
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include "model/SandpileGroup.hpp"
+#include "model/Sandpile.hpp"
+
+#include <mutex>
+
+// the group is defined for the standard model, where a cell topples having 4 grains
+const uint64_t kMaxStableSand = 3;
+
+struct IdentityCacheEntry {
+    uint16_t width = 0;
+    uint16_t height = 0;
+
+    // cells row by row
+    uint64_t* cells = nullptr;
+    IdentityCacheEntry* next = nullptr;
+};
+
+// identities computed so far, never released
+IdentityCacheEntry* identity_cache = nullptr;
+std::mutex identity_cache_mutex;
+
+SandpileGroup::SandpileGroup(uint16_t width, uint16_t height) : width_(width), height_(height) {}
+
+void SandpileGroup::InitConfiguration(Grid& grid) const {
+    grid.SetSinkBoundary(0, 0, width_ - 1, height_ - 1);
+}
+
+void SandpileGroup::Stabilize(Grid& grid) const {
+    Sandpile sandpile(grid);
+    sandpile.SetCheckerboardRelaxation(true);
+
+    // nothing is saved, so the run can't fail
+    (void)sandpile.Run();
+}
+
+void SandpileGroup::Add(Grid& grid, const Grid& other) const {
+    for (int32_t y = 0; y < height_; ++y) {
+        for (int32_t x = 0; x < width_; ++x) {
+            grid.AddSand(x, y, other.GetSand(x, y));
+        }
+    }
+
+    Stabilize(grid);
+}
+
+void SandpileGroup::GetIdentity(Grid& grid) const {
+    InitConfiguration(grid);
+
+    std::lock_guard<std::mutex> lock{identity_cache_mutex};
+    IdentityCacheEntry* entry = identity_cache;
+
+    while (entry != nullptr && (entry->width != width_ || entry->height != height_)) {
+        entry = entry->next;
+    }
+
+    if (entry != nullptr) {
+        for (int32_t y = 0; y < height_; ++y) {
+            for (int32_t x = 0; x < width_; ++x) {
+                grid.SetSand(x, y, entry->cells[static_cast<uint64_t>(y) * width_ + x]);
+            }
+        }
+
+        return;
+    }
+
+    for (int32_t y = 0; y < height_; ++y) {
+        for (int32_t x = 0; x < width_; ++x) {
+            grid.SetSand(x, y, 2 * kMaxStableSand);
+        }
+    }
+
+    Stabilize(grid);
+
+    for (int32_t y = 0; y < height_; ++y) {
+        for (int32_t x = 0; x < width_; ++x) {
+            grid.SetSand(x, y, 2 * kMaxStableSand - grid.GetSand(x, y));
+        }
+    }
+
+    Stabilize(grid);
+
+    entry = new IdentityCacheEntry{width_, height_, new uint64_t[static_cast<uint64_t>(width_) * height_], identity_cache};
+    identity_cache = entry;
+
+    for (int32_t y = 0; y < height_; ++y) {
+        for (int32_t x = 0; x < width_; ++x) {
+            entry->cells[static_cast<uint64_t>(y) * width_ + x] = grid.GetSand(x, y);
+        }
+    }
+}
+
+bool SandpileGroup::IsRecurrent(const Grid& grid) const {
+    for (int32_t y = 0; y < height_; ++y) {
+        for (int32_t x = 0; x < width_; ++x) {
+            if (grid.GetSand(x, y) > kMaxStableSand) {
+                return false;
+            }
+        }
+    }
+
+    Grid sum;
+    GetIdentity(sum);
+    Add(sum, grid);
+
+    for (int32_t y = 0; y < height_; ++y) {
+        for (int32_t x = 0; x < width_; ++x) {
+            if (sum.GetSand(x, y) != grid.GetSand(x, y)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "model/Grid.hpp"
+
+#include <cstdint>
+
+/**
+ * Sandpile group of the rectangle from (0, 0) to (width - 1, height - 1) with the sink boundary.
+ *
+ * Elements are the recurrent stable configurations, stored in grids bounded by the rectangle (see Grid::SetSinkBoundary).
+ * The group operation is the addition of configurations followed by the stabilization,
+ * which is done by the checkerboard relaxation (see Sandpile::SetCheckerboardRelaxation)
+ */
+class SandpileGroup {
+public:
+    SandpileGroup(uint16_t width, uint16_t height);
+
+    /** Makes the empty %grid% an empty configuration of the rectangle */
+    void InitConfiguration(Grid& grid) const;
+
+    void Stabilize(Grid& grid) const;
+
+    /** Adds the configuration %other% to %grid% and stabilizes the sum */
+    void Add(Grid& grid, const Grid& other) const;
+
+    /**
+     * Makes the empty %grid% the identity element, computed as stab(2m - stab(2m)),
+     * where m is the maximal stable configuration. It is computed once for each size of the rectangle and cached
+     */
+    void GetIdentity(Grid& grid) const;
+
+    /** Checks if the configuration is stable and recurrent: adding the identity to it doesn't change it */
+    bool IsRecurrent(const Grid& grid) const;
+
+private:
+    uint16_t width_;
+    uint16_t height_;
+};
@@ -0,0 +1,232 @@
+#include "model/WorkStealingScheduler.hpp"
+#include "memory/BufferPool.hpp"
+#include "memory/NumaTopology.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+uint64_t GetNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+WorkStealingScheduler::WorkStealingScheduler(uint32_t threads_count)
+    : threads_count_(std::max<uint32_t>(threads_count, 1)),
+      round_barrier_(threads_count_) {
+    deques_ = new Deque[threads_count_];
+    workers_ = new std::thread[threads_count_ - 1];
+
+    for (uint32_t i = 1; i < threads_count_; ++i) {
+        workers_[i - 1] = std::thread{&WorkStealingScheduler::RunWorker, this, i};
+    }
+}
+
+WorkStealingScheduler::~WorkStealingScheduler() {
+    // the calling thread outlives the scheduler
+    SetPinned(false);
+
+    is_stopped_ = true;
+    round_barrier_.arrive_and_wait();
+
+    for (uint32_t i = 0; i + 1 < threads_count_; ++i) {
+        workers_[i].join();
+    }
+
+    for (uint32_t i = 0; i < threads_count_; ++i) {
+        BufferPool::GetInstance().Release(deques_[i].tasks);
+    }
+
+    delete[] workers_;
+    delete[] deques_;
+}
+
+uint32_t WorkStealingScheduler::GetThreadsCount() const {
+    return threads_count_;
+}
+
+void WorkStealingScheduler::Push(uint32_t thread, uint32_t task) {
+    Deque& deque = deques_[thread];
+    int64_t bottom = deque.bottom.load(std::memory_order_relaxed);
+
+    if (static_cast<uint64_t>(bottom) == deque.capacity) {
+        uint64_t new_capacity = std::max<uint64_t>(2 * deque.capacity, 64);
+        uint32_t* new_tasks = BufferPool::GetInstance().Allocate<uint32_t>(new_capacity);
+
+        if (deque.tasks != nullptr) {
+            std::copy(deque.tasks, deque.tasks + bottom, new_tasks);
+            BufferPool::GetInstance().Release(deque.tasks);
+        }
+
+        deque.tasks = new_tasks;
+        deque.capacity = new_capacity;
+    }
+
+    deque.tasks[bottom] = task;
+    deque.bottom.store(bottom + 1, std::memory_order_relaxed);
+}
+
+void WorkStealingScheduler::RunRound() {
+    uint64_t start_time = GetNanoseconds();
+
+    // the barrier publishes the pushed tasks to the workers and then waits for them to finish
+    round_barrier_.arrive_and_wait();
+    RunTasks(0);
+    round_barrier_.arrive_and_wait();
+
+    if (!is_per_thread_round_) {
+        elapsed_time_ += GetNanoseconds() - start_time;
+    }
+
+    for (uint32_t i = 0; i < threads_count_; ++i) {
+        deques_[i].top.store(0, std::memory_order_relaxed);
+        deques_[i].bottom.store(0, std::memory_order_relaxed);
+    }
+}
+
+void WorkStealingScheduler::RunWorker(uint32_t thread) {
+    while (true) {
+        round_barrier_.arrive_and_wait();
+
+        if (is_stopped_) {
+            return;
+        }
+
+        RunTasks(thread);
+        round_barrier_.arrive_and_wait();
+    }
+}
+
+void WorkStealingScheduler::RunTasks(uint32_t thread) {
+    SchedulerThreadStats& stats = deques_[thread].stats;
+    uint32_t task;
+
+    deques_[thread].node = NumaTopology::GetInstance().GetCurrentNode();
+
+    if (is_per_thread_round_) {
+        if (Pop(thread, task)) {
+            run_task_(run_task_context_, thread, task);
+        }
+
+        return;
+    }
+
+    while (true) {
+        if (Pop(thread, task)) {
+            ++stats.tasks_count;
+        } else if (Steal(thread, task)) {
+            ++stats.tasks_count;
+            ++stats.stolen_tasks_count;
+        } else {
+            return;
+        }
+
+        uint64_t start_time = GetNanoseconds();
+        run_task_(run_task_context_, thread, task);
+        stats.busy_time += GetNanoseconds() - start_time;
+    }
+}
+
+bool WorkStealingScheduler::Pop(uint32_t thread, uint32_t& task) {
+    Deque& deque = deques_[thread];
+
+    int64_t bottom = deque.bottom.load(std::memory_order_relaxed) - 1;
+    deque.bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = deque.top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+        deque.bottom.store(bottom + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    task = deque.tasks[bottom];
+
+    if (top == bottom) {
+        // the last task may be taken by a thief at the same time
+        bool is_taken = deque.top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        deque.bottom.store(bottom + 1, std::memory_order_relaxed);
+
+        return is_taken;
+    }
+
+    return true;
+}
+
+bool WorkStealingScheduler::Steal(uint32_t thread, uint32_t& task) {
+    bool has_tasks = true;
+
+    // tasks are never added during a round, so the thread is done once all deques are seen empty
+    while (has_tasks) {
+        has_tasks = false;
+
+        for (uint32_t i = 1; i < threads_count_; ++i) {
+            Deque& victim = deques_[(thread + i) % threads_count_];
+
+            int64_t top = victim.top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t bottom = victim.bottom.load(std::memory_order_acquire);
+
+            if (top >= bottom) {
+                continue;
+            }
+
+            has_tasks = true;
+            uint32_t stolen_task = victim.tasks[top];
+
+            if (victim.top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                task = stolen_task;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+const SchedulerThreadStats& WorkStealingScheduler::GetThreadStats(uint32_t thread) const {
+    return deques_[thread].stats;
+}
+
+void WorkStealingScheduler::SetPinned(bool is_pinned) {
+    if (is_pinned == is_pinned_) {
+        return;
+    }
+
+    is_pinned_ = is_pinned;
+
+    RunOnEachThread([this, is_pinned](uint32_t thread) {
+        if (is_pinned) {
+            (void)NumaTopology::GetInstance().PinCurrentThread(thread, threads_count_);
+        } else {
+            NumaTopology::GetInstance().UnpinCurrentThread();
+        }
+    });
+}
+
+uint32_t WorkStealingScheduler::GetThreadNode(uint32_t thread) const {
+    return deques_[thread].node;
+}
+
+void WorkStealingScheduler::CountMemoryAccess(uint32_t thread, int32_t memory_node) {
+    SchedulerThreadStats& stats = deques_[thread].stats;
+
+    if (memory_node < 0) {
+        return;
+    } else if (static_cast<uint32_t>(memory_node) == deques_[thread].node) {
+        ++stats.local_tasks_count;
+    } else {
+        ++stats.remote_tasks_count;
+    }
+}
+
+uint64_t WorkStealingScheduler::GetElapsedTime() const {
+    return elapsed_time_;
+}
+
+void WorkStealingScheduler::ResetStats() {
+    for (uint32_t i = 0; i < threads_count_; ++i) {
+        deques_[i].stats = SchedulerThreadStats{};
+    }
+
+    elapsed_time_ = 0;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <barrier>
+#include <cstdint>
+#include <thread>
+
+struct SchedulerThreadStats {
+    uint64_t tasks_count = 0;
+    uint64_t stolen_tasks_count = 0;
+
+    // time spent running tasks, in nanoseconds
+    uint64_t busy_time = 0;
+
+    // tasks working on the memory of the node the thread ran on or of another one (see CountMemoryAccess)
+    uint64_t local_tasks_count = 0;
+    uint64_t remote_tasks_count = 0;
+};
+
+/**
+ * Runs rounds of independent tasks on a fixed set of threads with work stealing.
+ *
+ * Before a round, tasks are pushed to the deques of the threads. During the round each thread takes tasks
+ * from the bottom of its own deque and, once it's empty, steals from the top of the deques of other threads,
+ * so threads which got cheap tasks help the ones with expensive ones. Tasks are never added during a round.
+ * The calling thread works as thread 0, the others wait for the next round between rounds
+ */
+class WorkStealingScheduler {
+public:
+    explicit WorkStealingScheduler(uint32_t threads_count);
+    ~WorkStealingScheduler();
+
+    WorkStealingScheduler(const WorkStealingScheduler& other) = delete;
+    WorkStealingScheduler& operator=(const WorkStealingScheduler& other) = delete;
+
+    uint32_t GetThreadsCount() const;
+
+    /** Adds %task% to the deque of %thread% for the next round. Has to be called only between rounds */
+    void Push(uint32_t thread, uint32_t task);
+
+    /** Calls %run_task%(thread, task) for each pushed task and returns when all of them are done */
+    template<typename Task>
+    void RunRound(const Task& run_task);
+
+    /**
+     * Calls %run_task%(thread) once on each thread and returns when all of them are done, without stealing,
+     * e.g. to first touch the parts of a buffer the threads will work on. Doesn't count in the stats
+     */
+    template<typename Task>
+    void RunOnEachThread(const Task& run_task);
+
+    /** Pins each thread to its own CPU, spreading them over NUMA nodes (see NumaTopology), or unpins them */
+    void SetPinned(bool is_pinned);
+
+    /** @return NUMA node the thread ran on during the last round */
+    uint32_t GetThreadNode(uint32_t thread) const;
+
+    /** Counts a task of %thread% working on the memory of %memory_node% (unknown if negative) as local or remote */
+    void CountMemoryAccess(uint32_t thread, int32_t memory_node);
+
+    const SchedulerThreadStats& GetThreadStats(uint32_t thread) const;
+
+    /** @return Total time of all rounds in nanoseconds */
+    uint64_t GetElapsedTime() const;
+
+    /** Zeroes the stats of all threads and the elapsed time. Has to be called only between rounds */
+    void ResetStats();
+
+private:
+    struct alignas(64) Deque {
+        // the owner takes tasks at the bottom, thieves at the top
+        std::atomic<int64_t> top{0};
+        std::atomic<int64_t> bottom{0};
+
+        uint32_t* tasks = nullptr;
+        uint64_t capacity = 0;
+
+        SchedulerThreadStats stats;
+        uint32_t node = 0;
+    };
+
+    Deque* deques_ = nullptr;
+    uint32_t threads_count_;
+
+    std::thread* workers_ = nullptr;
+    std::barrier<> round_barrier_;
+    bool is_stopped_ = false;
+    bool is_pinned_ = false;
+
+    // each thread runs the single task pushed to it
+    bool is_per_thread_round_ = false;
+
+    // the task of the current round, type-erased for the workers
+    void (*run_task_)(const void* context, uint32_t thread, uint32_t task) = nullptr;
+    const void* run_task_context_ = nullptr;
+
+    uint64_t elapsed_time_ = 0;
+
+    void RunWorker(uint32_t thread);
+    void RunTasks(uint32_t thread);
+    void RunRound();
+
+    bool Pop(uint32_t thread, uint32_t& task);
+
+    /** @return false if all other deques are empty */
+    bool Steal(uint32_t thread, uint32_t& task);
+};
+
+template<typename Task>
+void WorkStealingScheduler::RunRound(const Task& run_task) {
+    run_task_ = [](const void* context, uint32_t thread, uint32_t task) {
+        (*static_cast<const Task*>(context))(thread, task);
+    };
+    run_task_context_ = &run_task;
+
+    RunRound();
+}
+
+template<typename Task>
+void WorkStealingScheduler::RunOnEachThread(const Task& run_task) {
+    for (uint32_t i = 0; i < threads_count_; ++i) {
+        Push(i, i);
+    }
+
+    is_per_thread_round_ = true;
+
+    RunRound([&run_task](uint32_t thread, uint32_t) {
+        run_task(thread);
+    });
+
+    is_per_thread_round_ = false;
+}
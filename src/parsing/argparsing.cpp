@@ -13,12 +13,50 @@ const char* kMaxIterLongArg = "--max-iter";
 const char* kMaxIterShortArg = "-m";
 const char* kFrequencyLongArg = "--freq";
 const char* kFrequencyShortArg = "-f";
+const char* kScheduleLongArg = "--schedule";
+const char* kScheduleShortArg = "-q";
 const char* kHelpLongArg = "--help";
 const char* kHelpShortArg = "-h";
+const char* kMemoryBudgetLongArg = "--memory-budget";
+const char* kMemoryBudgetShortArg = "-b";
+const char* kMemoryLimitLongArg = "--memory-limit";
+const char* kMemoryLimitShortArg = "-u";
+const char* kScratchDirectoryLongArg = "--scratch-dir";
+const char* kScratchDirectoryShortArg = "-s";
+const char* kHugePagesLongArg = "--huge-pages";
+const char* kHugePagesShortArg = "-g";
+const char* kNumaLongArg = "--numa";
+const char* kNumaShortArg = "-w";
+const char* kActivityMapLongArg = "--activity-map";
+const char* kActivityMapShortArg = "-a";
+const char* kStatisticsLongArg = "--stats";
+const char* kStatisticsShortArg = "-x";
 const char* kOutputFilePrefixLongArg = "--output-prefix";
 const char* kOutputFilePrefixShortArg = "-p";
 const char* kOutputFileExtensionLongArg = "--output-extension";
 const char* kOutputFileExtensionShortArg = "-e";
+const char* kPngLevelLongArg = "--png-level";
+const char* kPngLevelShortArg = "-z";
+const char* kDeltaLongArg = "--delta";
+const char* kDeltaShortArg = "-d";
+const char* kRecordLongArg = "--record";
+const char* kRecordShortArg = "-j";
+const char* kStreamLongArg = "--stream";
+const char* kStreamShortArg = "-t";
+const char* kPreviewLongArg = "--preview";
+const char* kPreviewShortArg = "-k";
+const char* kDomainLongArg = "--domain";
+const char* kDomainShortArg = "-r";
+const char* kGroupLongArg = "--group";
+const char* kGroupShortArg = "-y";
+const char* kCheckerboardLongArg = "--checkerboard";
+const char* kCheckerboardShortArg = "-c";
+const char* kEngineLongArg = "--engine";
+const char* kEngineShortArg = "-v";
+const char* kServeLongArg = "--serve";
+const char* kServeShortArg = "-l";
+const char* kConnectLongArg = "--connect";
+const char* kConnectShortArg = "-n";
 
 const char* kMissingArgumentMsg = "Unspecified argument value (unexpected end of argument sequence)";
 
@@ -26,6 +64,15 @@ bool SetFlag(Parameters& parameters, std::string_view argument) {
     if (argument == kHelpLongArg || argument == kHelpShortArg) {
         parameters.need_help = true;
         return true;
+    } else if (argument == kActivityMapLongArg || argument == kActivityMapShortArg) {
+        parameters.save_activity_map = true;
+        return true;
+    } else if (argument == kStatisticsLongArg || argument == kStatisticsShortArg) {
+        parameters.save_statistics = true;
+        return true;
+    } else if (argument == kCheckerboardLongArg || argument == kCheckerboardShortArg) {
+        parameters.checkerboard_relaxation = true;
+        return true;
     }
 
     return false;
@@ -91,6 +138,113 @@ std::optional<ParametersParseError> ParseOption(
         return std::nullopt;
     } else if (argument_name == kOutputFileExtensionLongArg || argument_name == kOutputFileExtensionShortArg) {
         parameters.output_file_extension = raw_value.data();
+        return std::nullopt;
+    } else if (argument_name == kStreamLongArg || argument_name == kStreamShortArg) {
+        if (parameters.stream_files_count == kMaxStreamFiles) {
+            return ParametersParseError{"Too many stream files (at most 16)", argument_name.data(), raw_value.data()};
+        }
+
+        parameters.stream_files[parameters.stream_files_count++] = raw_value.data();
+        return std::nullopt;
+    } else if (argument_name == kServeLongArg || argument_name == kServeShortArg) {
+        parameters.server_socket = raw_value.data();
+        return std::nullopt;
+    } else if (argument_name == kConnectLongArg || argument_name == kConnectShortArg) {
+        parameters.client_socket = raw_value.data();
+        return std::nullopt;
+    } else if (argument_name == kScratchDirectoryLongArg || argument_name == kScratchDirectoryShortArg) {
+        parameters.scratch_directory = raw_value.data();
+        return std::nullopt;
+    } else if (argument_name == kDomainLongArg || argument_name == kDomainShortArg) {
+        size_t separator = raw_value.find('x');
+
+        if (separator == std::string_view::npos) {
+            return ParametersParseError{"The domain must be given as <width>x<height>", argument_name.data(), raw_value.data()};
+        }
+
+        std::expected<uint32_t, const char*> width = ParseNumber<uint32_t>(raw_value.substr(0, separator));
+        std::expected<uint32_t, const char*> height = ParseNumber<uint32_t>(raw_value.substr(separator + 1));
+
+        if (!width.has_value() || !height.has_value() || width.value() == 0 || height.value() == 0
+            || width.value() > kMaxDomainSize || height.value() > kMaxDomainSize) {
+            return ParametersParseError{"The domain size must be from 1x1 to 32768x32768", argument_name.data(), raw_value.data()};
+        }
+
+        parameters.domain_width = width.value();
+        parameters.domain_height = height.value();
+        return std::nullopt;
+    } else if (argument_name == kScheduleLongArg || argument_name == kScheduleShortArg) {
+        size_t separator = raw_value.find(':');
+
+        if (separator == std::string_view::npos) {
+            return ParametersParseError{"The schedule must be given as <kind>:<n>", argument_name.data(), raw_value.data()};
+        }
+
+        std::string_view kind = raw_value.substr(0, separator);
+        std::expected<uint64_t, const char*> number = ParseNumber<uint64_t>(raw_value.substr(separator + 1));
+
+        if (!number.has_value()) {
+            return ParametersParseError{"Cannot parse integer value", argument_name.data(), raw_value.data()};
+        } else if (number.value() == 0) {
+            return ParametersParseError{"The schedule value must be positive", argument_name.data(), raw_value.data()};
+        }
+
+        if (kind == "log") {
+            parameters.log_snapshots_per_decade = number.value();
+        } else if (kind == "time") {
+            parameters.snapshot_interval_ms = number.value();
+        } else if (kind == "topplings") {
+            parameters.snapshot_topplings_threshold = number.value();
+        } else {
+            return ParametersParseError{"Unknown snapshot schedule", argument_name.data(), raw_value.data()};
+        }
+
+        return std::nullopt;
+    } else if (argument_name == kGroupLongArg || argument_name == kGroupShortArg) {
+        if (raw_value == "identity") {
+            parameters.group_operation = kAddIdentity;
+        } else if (raw_value == "recurrent") {
+            parameters.group_operation = kCheckRecurrence;
+        } else {
+            return ParametersParseError{"Unknown group operation", argument_name.data(), raw_value.data()};
+        }
+
+        return std::nullopt;
+    } else if (argument_name == kHugePagesLongArg || argument_name == kHugePagesShortArg) {
+        if (raw_value == "none") {
+            parameters.huge_pages_mode = kNoHugePages;
+        } else if (raw_value == "transparent") {
+            parameters.huge_pages_mode = kTransparentHugePages;
+        } else if (raw_value == "explicit") {
+            parameters.huge_pages_mode = kExplicitHugePages;
+        } else {
+            return ParametersParseError{"Unknown huge pages mode", argument_name.data(), raw_value.data()};
+        }
+
+        return std::nullopt;
+    } else if (argument_name == kNumaLongArg || argument_name == kNumaShortArg) {
+        if (raw_value == "none") {
+            parameters.numa_policy = kNoNumaPolicy;
+        } else if (raw_value == "first-touch") {
+            parameters.numa_policy = kNumaFirstTouch;
+        } else if (raw_value == "pinned") {
+            parameters.numa_policy = kNumaPinned;
+        } else {
+            return ParametersParseError{"Unknown NUMA policy", argument_name.data(), raw_value.data()};
+        }
+
+        return std::nullopt;
+    } else if (argument_name == kEngineLongArg || argument_name == kEngineShortArg) {
+        if (raw_value == "auto") {
+            parameters.iteration_engine = kAutoEngine;
+        } else if (raw_value == "wavefront") {
+            parameters.iteration_engine = kWavefrontEngine;
+        } else if (raw_value == "sweep") {
+            parameters.iteration_engine = kSweepEngine;
+        } else {
+            return ParametersParseError{"Unknown iteration engine", argument_name.data(), raw_value.data()};
+        }
+
         return std::nullopt;
     }
 
@@ -104,6 +258,22 @@ std::optional<ParametersParseError> ParseOption(
         parameters.max_iterations = number.value();
     } else if (argument_name == kFrequencyLongArg || argument_name == kFrequencyShortArg) {
         parameters.state_saving_frequency = number.value();
+    } else if (argument_name == kMemoryBudgetLongArg || argument_name == kMemoryBudgetShortArg) {
+        parameters.memory_budget_mb = number.value();
+    } else if (argument_name == kMemoryLimitLongArg || argument_name == kMemoryLimitShortArg) {
+        parameters.memory_limit_mb = number.value();
+    } else if (argument_name == kPngLevelLongArg || argument_name == kPngLevelShortArg) {
+        if (number.value() > 9) {
+            return ParametersParseError{"PNG compression level must be from 0 to 9", argument_name.data(), raw_value.data()};
+        }
+
+        parameters.png_compression_level = number.value();
+    } else if (argument_name == kDeltaLongArg || argument_name == kDeltaShortArg) {
+        parameters.delta_keyframe_interval = number.value();
+    } else if (argument_name == kRecordLongArg || argument_name == kRecordShortArg) {
+        parameters.event_checkpoint_interval = number.value();
+    } else if (argument_name == kPreviewLongArg || argument_name == kPreviewShortArg) {
+        parameters.preview_block_size = number.value();
     } else {
         return ParametersParseError{"Unknown argument", argument_name.data(), raw_value.data()};
     }
@@ -112,7 +282,8 @@ std::optional<ParametersParseError> ParseOption(
 }
 
 std::optional<ParametersParseError> ValidateParameters(const Parameters& parameters) {
-    if (parameters.need_help) {
+    // jobs of the server are validated when they come
+    if (parameters.need_help || parameters.server_socket != nullptr) {
         return std::nullopt;
     }
 
@@ -120,8 +291,14 @@ std::optional<ParametersParseError> ValidateParameters(const Parameters& paramet
         return ParametersParseError{"No input file is specified"};
     } else if (parameters.output_directory == nullptr) {
         return ParametersParseError{"No output directory is specified"};
+    } else if (parameters.group_operation != kNoGroupOperation && parameters.domain_width == 0) {
+        return ParametersParseError{"Group operations need a bounded domain (--domain)"};
     }
     
+    if (std::string_view{parameters.input_file} == kStandardInputFileName) {
+        return std::nullopt;
+    }
+
     std::fstream file(parameters.input_file);
 
     if (!file.good()) {
@@ -134,7 +311,7 @@ std::optional<ParametersParseError> ValidateParameters(const Parameters& paramet
 std::expected<const char*, const char*> GetParameterInfo(std::string_view parameter) {
     if (parameter == kInputFileLongArg || parameter == kInputFileShortArg) {
         return "--input=<path> | -i <path>              [string]                        "
-            "Path to the .tsv file with the sandpile initial state";
+            "Path to the .tsv file with the sandpile initial state, or - for the standard input";
     } else if (parameter == kOutputDirectoryLongArg || parameter == kOutputDirectoryShortArg) {
         return "--output=<path> | -o <path>             [string]                        "
             "Path to the directory where to save states of the sandpile (including the directory separator)";
@@ -144,6 +321,9 @@ std::expected<const char*, const char*> GetParameterInfo(std::string_view parame
     } else if (parameter == kFrequencyLongArg || parameter == kFrequencyShortArg) {
         return "--freq=<n> | -f <n>                     [int, >= 0, default=0]          "
             "Frequency of saving the intermediate states. If zero, only the final state is saved";
+    } else if (parameter == kScheduleLongArg || parameter == kScheduleShortArg) {
+        return "--schedule=<kind>:<n> | -q <kind>:<n>   [string, repeatable]            "
+            "Also save states: n per power of 10 of iterations (log), every n ms (time), after more than n topplings (topplings)";
     } else if (parameter == kHelpLongArg || parameter == kHelpShortArg) {
         return "--help | -h                             [flag]                          "
             "Show help and exit";
@@ -152,20 +332,93 @@ std::expected<const char*, const char*> GetParameterInfo(std::string_view parame
             "Prexif for output files";
     } else if (parameter == kOutputFileExtensionLongArg || parameter == kOutputFileExtensionShortArg) {
         return "--output-extension=<ext> | -e <ext>     [string, default=.bmp]          "
-            "Extension for output files (only an addition to the filename)";
+            "Extension for output files (only an addition to the filename). Files are saved as png if it ends with .png";
+    } else if (parameter == kPngLevelLongArg || parameter == kPngLevelShortArg) {
+        return "--png-level=<n> | -z <n>                [int, 0-9, default=6]           "
+            "Compression level for png files: 0 is the fastest, 9 gives the smallest files";
+    } else if (parameter == kDeltaLongArg || parameter == kDeltaShortArg) {
+        return "--delta=<n> | -d <n>                    [int, >= 0, default=0]          "
+            "Save states as changed tiles into <prefix>frames.delta, every n-th one in full. If zero, states are saved as images";
+    } else if (parameter == kRecordLongArg || parameter == kRecordShortArg) {
+        return "--record=<k> | -j <k>                   [int, >= 0, default=0]          "
+            "Record every toppling into <prefix>events.log with a checkpoint every k iterations, so SandpileReplay can rebuild any state";
+    } else if (parameter == kPreviewLongArg || parameter == kPreviewShortArg) {
+        return "--preview=<k> | -k <k>                  [int, >= 0, default=0]          "
+            "Before the run, save previews of the final state for blocks of k x k, k / 2 x k / 2, ... cells. If zero or one, no previews";
+    } else if (parameter == kStreamLongArg || parameter == kStreamShortArg) {
+        return "--stream=<path> | -t <path>             [string, repeatable]            "
+            "A .tsv file or a named pipe whose grains are added while the model runs. The run ends when all streams end";
+    } else if (parameter == kDomainLongArg || parameter == kDomainShortArg) {
+        return "--domain=<w>x<h> | -r <w>x<h>           [string]                        "
+            "Run on the rectangle from (0, 0) to (w - 1, h - 1): grains falling off its edge are lost, the grid never grows";
+    } else if (parameter == kGroupLongArg || parameter == kGroupShortArg) {
+        return "--group=<operation> | -y <operation>    [identity|recurrent]            "
+            "Sandpile group operation on the domain: add its identity to the input, or check if the final state is recurrent";
+    } else if (parameter == kMemoryBudgetLongArg || parameter == kMemoryBudgetShortArg) {
+        return "--memory-budget=<n> | -b <n>            [int, >= 0, default=0]          "
+            "Memory limit for the grid in MiB. Larger grids are stored in a scratch file. If zero, there is no limit";
+    } else if (parameter == kMemoryLimitLongArg || parameter == kMemoryLimitShortArg) {
+        return "--memory-limit=<n> | -u <n>             [int, >= 0, default=0]          "
+            "Memory limit for the whole run in MiB. Near it, more compact representations are used instead of failing";
+    } else if (parameter == kScratchDirectoryLongArg || parameter == kScratchDirectoryShortArg) {
+        return "--scratch-dir=<path> | -s <path>        [string, default=output path]   "
+            "Path to the directory for the scratch file (including the directory separator)";
+    } else if (parameter == kHugePagesLongArg || parameter == kHugePagesShortArg) {
+        return "--huge-pages=<mode> | -g <mode>         [none|transparent|explicit]     "
+            "Huge pages for large buffers (default=transparent). Explicit ones fall back to transparent if not reserved";
+    } else if (parameter == kNumaLongArg || parameter == kNumaShortArg) {
+        return "--numa=<policy> | -w <policy>           [none|first-touch|pinned]       "
+            "NUMA placement for --checkerboard: the grid is filled by the threads working on it, pinned ones stay on their CPUs";
+    } else if (parameter == kCheckerboardLongArg || parameter == kCheckerboardShortArg) {
+        return "--checkerboard | -c                     [flag]                          "
+            "Relax the grid in parallel over a checkerboard if no intermediate states are saved (same result, other iterations count)";
+    } else if (parameter == kEngineLongArg || parameter == kEngineShortArg) {
+        return "--engine=<kind> | -v <kind>             [auto|wavefront|sweep]          "
+            "Engine of intermediate states: temporal blocks and bit planes (auto), temporal blocks only, or one sweep per iteration";
+    } else if (parameter == kServeLongArg || parameter == kServeShortArg) {
+        return "--serve=<socket> | -l <socket>          [string]                        "
+            "Run as a server accepting jobs on the Unix domain socket. Other options are given with each job";
+    } else if (parameter == kConnectLongArg || parameter == kConnectShortArg) {
+        return "--connect=<socket> | -n <socket>        [string]                        "
+            "Run the job with the other options on the server listening on the socket. Input - is sent along with the job";
+    } else if (parameter == kStatisticsLongArg || parameter == kStatisticsShortArg) {
+        return "--stats | -x                            [flag]                          "
+            "Save the height histogram, mass, unstable cells count and radius of each state to <prefix>stats.csv";
+    } else if (parameter == kActivityMapLongArg || parameter == kActivityMapShortArg) {
+        return "--activity-map | -a                     [flag]                          "
+            "Save the tile activity map along with each state (debug)";
     }
 
     return std::unexpected{"Cannot get parameter info: unknown parameter"};
 }
 
-void ShowHelpMessage() {
-    std::cout << "Usage: Sandpile [OPTIONS]" << std::endl << 
+void ShowHelpMessage(std::ostream& output) {
+    output << "Usage: Sandpile [OPTIONS]" << std::endl << 
         "Possible options:" << std::endl << "\t";
-    std::cout << *GetParameterInfo(kInputFileShortArg) << std::endl << '\t';
-    std::cout << *GetParameterInfo(kOutputDirectoryShortArg) << std::endl << '\t';
-    std::cout << *GetParameterInfo(kMaxIterShortArg) << std::endl << '\t';
-    std::cout << *GetParameterInfo(kFrequencyShortArg) << std::endl << '\t';
-    std::cout << *GetParameterInfo(kOutputFilePrefixShortArg) << std::endl << '\t';
-    std::cout << *GetParameterInfo(kOutputFileExtensionShortArg) << std::endl << '\t';
-    std::cout << *GetParameterInfo(kHelpShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kInputFileShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kOutputDirectoryShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kMaxIterShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kFrequencyShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kScheduleShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kOutputFilePrefixShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kOutputFileExtensionShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kPngLevelShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kDeltaShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kRecordShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kStreamShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kPreviewShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kDomainShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kGroupShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kMemoryBudgetShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kMemoryLimitShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kScratchDirectoryShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kHugePagesShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kCheckerboardShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kNumaShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kEngineShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kServeShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kConnectShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kStatisticsShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kActivityMapShortArg) << std::endl << '\t';
+    output << *GetParameterInfo(kHelpShortArg) << std::endl << '\t';
 }
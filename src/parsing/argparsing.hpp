@@ -1,20 +1,77 @@
 #pragma once
 
+#include "memory/BufferPool.hpp"
+#include "memory/NumaTopology.hpp"
+
 #include <cstdint>
+#include <iostream>
 #include <expected>
 #include <string_view>
 #include <optional>
 
+const uint32_t kMaxStreamFiles = 16;
+
+// the input file name which stands for the standard input (or the inline grid of a job, see jobs/JobProtocol.hpp)
+const char* const kStandardInputFileName = "-";
+
+// coordinates of a bounded domain must fit into int16_t
+const uint32_t kMaxDomainSize = 1 << 15;
+
+enum GroupOperation {
+    kNoGroupOperation = 0,
+    kAddIdentity = 1,
+    kCheckRecurrence = 2
+};
+
+// engine of the per-iteration mode, the slower ones are the reference for the faster ones
+enum IterationEngine {
+    kAutoEngine = 0,
+    kWavefrontEngine = 1,
+    kSweepEngine = 2
+};
+
 struct Parameters {
     const char* input_file = nullptr;
     const char* output_directory = nullptr;
     uint64_t max_iterations = 0;
     uint64_t state_saving_frequency = 0;
 
+    // snapshot schedules in addition to the frequency, zero turns a schedule off
+    uint64_t log_snapshots_per_decade = 0;
+    uint64_t snapshot_interval_ms = 0;
+    uint64_t snapshot_topplings_threshold = 0;
+
     const char* output_file_prefix = "sandpile_";
     const char* output_file_extension = ".bmp";
+    uint64_t png_compression_level = 6;
+    uint64_t delta_keyframe_interval = 0;
+    uint64_t event_checkpoint_interval = 0;
+    uint64_t preview_block_size = 0;
+
+    // each file is read by its own producer thread while the model runs
+    const char* stream_files[kMaxStreamFiles] = {};
+    uint32_t stream_files_count = 0;
+
+    // a bounded domain from (0, 0) to (domain_width - 1, domain_height - 1) with the sink boundary, if not zero
+    uint32_t domain_width = 0;
+    uint32_t domain_height = 0;
+    GroupOperation group_operation = kNoGroupOperation;
+
+    uint64_t memory_budget_mb = 0;
+    uint64_t memory_limit_mb = 0;
+    const char* scratch_directory = nullptr;
+    HugePagesMode huge_pages_mode = kTransparentHugePages;
+    NumaPolicy numa_policy = kNoNumaPolicy;
+    IterationEngine iteration_engine = kAutoEngine;
+
+    // Unix domain sockets: runs a job server on the first one, or sends the job to the server on the second one
+    const char* server_socket = nullptr;
+    const char* client_socket = nullptr;
 
     bool need_help = false;
+    bool save_activity_map = false;
+    bool save_statistics = false;
+    bool checkerboard_relaxation = false;
 };
 
 struct ParametersParseError {
@@ -27,7 +84,7 @@ std::expected<Parameters, ParametersParseError> ParseArguments(int argc, char**
 
 std::expected<const char*, const char*> GetParameterInfo(std::string_view parameter);
 
-void ShowHelpMessage();
+void ShowHelpMessage(std::ostream& output = std::cout);
 
 std::optional<ParametersParseError> ParseOption(
     Parameters& parameters, 
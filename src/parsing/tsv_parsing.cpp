@@ -1,27 +1,42 @@
 #include "parsing/tsv_parsing.hpp"
+#include "parsing/argparsing.hpp"
 #include "parsing/utils.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
 const uint8_t kMaxUint64DecimalLength = 20;
 const uint8_t kLineBufferSize = 64; // kMaxUint64DecimalLength * 3 + 3 '\t' + '\0'
 
-std::optional<TsvParsingError> FillGrid(Grid& grid, const char* input_file_name) {
-    std::ifstream file(input_file_name);
-    if (!file.good()) {
+/**
+ * Calls %consume% with (x, y, sand) of each line of the file.
+ * Stops early if it returns false
+ */
+template<typename Consumer>
+std::optional<TsvParsingError> ReadTsv(const char* input_file_name, const Consumer& consume) {
+    bool is_standard_input = std::string_view{input_file_name} == kStandardInputFileName;
+    std::ifstream file;
+
+    if (!is_standard_input) {
+        file.open(input_file_name);
+    }
+
+    std::istream& input = is_standard_input ? std::cin : file;
+
+    if (!input.good()) {
         return TsvParsingError{"Unable to open the input file"};
     }
 
     char line_buffer[kLineBufferSize];
     uint64_t current_line = 0;
 
-    while (file.good()) {
-        file.getline(line_buffer, kLineBufferSize);
+    while (input.good()) {
+        input.getline(line_buffer, kLineBufferSize);
         ++current_line;
 
-        if (file.fail()) {
-            if (file.eof()) {
+        if (input.fail()) {
+            if (input.eof()) {
                 return std::nullopt;
             }
 
@@ -55,9 +70,29 @@ std::optional<TsvParsingError> FillGrid(Grid& grid, const char* input_file_name)
             return TsvParsingError{sand.error(), current_line};
         }
 
-        grid.SetSand(x.value(), y.value(), sand.value());
+        if (!consume(x.value(), y.value(), sand.value())) {
+            return std::nullopt;
+        }
     }
 
     return std::nullopt;
 }
 
+std::optional<TsvParsingError> FillGrid(Grid& grid, const char* input_file_name) {
+    return ReadTsv(input_file_name, [&grid](int16_t x, int16_t y, uint64_t sand) {
+        grid.SetSand(x, y, sand);
+        return true;
+    });
+}
+
+std::optional<TsvParsingError> StreamGrains(GrainQueue& queue, uint32_t producer, const char* input_file_name) {
+    std::optional<TsvParsingError> reading_result
+        = ReadTsv(input_file_name, [&queue, producer](int16_t x, int16_t y, uint64_t sand) {
+            return queue.Push(producer, Grain{x, y, sand});
+        });
+
+    queue.Finish(producer);
+
+    return reading_result;
+}
+
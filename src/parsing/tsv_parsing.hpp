@@ -1,6 +1,7 @@
 #pragma once
 
 #include "model/Grid.hpp"
+#include "model/GrainQueue.hpp"
 
 #include <optional>
 
@@ -10,3 +11,10 @@ struct TsvParsingError {
 };
 
 std::optional<TsvParsingError> FillGrid(Grid& grid, const char* input_file_name);
+
+/**
+ * Reads grains from a file in the same format as FillGrid() and pushes them to %queue% as producer %producer%
+ * until the end of the file or cancellation of the queue. The file may be a named pipe, so grains can be
+ * added by another process while the model runs. The producer is marked finished in any case
+ */
+std::optional<TsvParsingError> StreamGrains(GrainQueue& queue, uint32_t producer, const char* input_file_name);
@@ -0,0 +1,942 @@
+#include "png/Deflate.hpp"
+#include "memory/BufferPool.hpp"
+
+#include <algorithm>
+
+const uint16_t kLengthBases[] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+const uint8_t kLengthExtraBits[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+const uint16_t kDistanceBases[] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+    193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+const uint8_t kDistanceExtraBits[] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// order in which code length code lengths are stored
+const uint8_t kCodeLengthsOrder[] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// max chain length and "nice" match length for each level, like in zlib
+const uint32_t kMaxChainLengths[] = {0, 4, 8, 32, 16, 32, 128, 256, 1024, 4096};
+const uint32_t kNiceLengths[] = {0, 8, 16, 32, 16, 32, 128, 128, 258, 258};
+const uint8_t kMinLazyLevel = 4;
+
+const uint8_t kMaxCodeLength = 15;
+const uint8_t kMaxCodeLengthCodeLength = 7;
+
+const uint32_t kAdlerBase = 65521;
+
+struct Crc32Table {
+    uint32_t values[256];
+};
+
+constexpr Crc32Table MakeCrc32Table() {
+    Crc32Table table{};
+
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t value = i;
+
+        for (uint8_t bit = 0; bit < 8; ++bit) {
+            value = (value & 1) ? (0xEDB88320u ^ (value >> 1)) : (value >> 1);
+        }
+
+        table.values[i] = value;
+    }
+
+    return table;
+}
+
+constexpr Crc32Table kCrc32Table = MakeCrc32Table();
+
+uint32_t Crc32(const uint8_t* data, uint64_t size, uint32_t crc) {
+    crc = ~crc;
+
+    for (uint64_t i = 0; i < size; ++i) {
+        crc = kCrc32Table.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+uint32_t Adler32(const uint8_t* data, uint64_t size, uint32_t adler) {
+    // 5552 is the largest amount of bytes which can be summed without overflowing 32 bits
+    const uint64_t kMaxBlockSize = 5552;
+
+    uint32_t first_sum = adler & 0xffff;
+    uint32_t second_sum = adler >> 16;
+
+    while (size != 0) {
+        uint64_t block_size = std::min(size, kMaxBlockSize);
+        size -= block_size;
+
+        for (uint64_t i = 0; i < block_size; ++i) {
+            first_sum += data[i];
+            second_sum += first_sum;
+        }
+
+        data += block_size;
+        first_sum %= kAdlerBase;
+        second_sum %= kAdlerBase;
+    }
+
+    return (second_sum << 16) | first_sum;
+}
+
+uint32_t CombineAdler32(uint32_t first, uint32_t second, uint64_t second_size) {
+    uint64_t remainder = second_size % kAdlerBase;
+
+    uint64_t first_sum = first & 0xffff;
+    uint64_t second_sum = (remainder * first_sum) % kAdlerBase;
+
+    first_sum += (second & 0xffff) + kAdlerBase - 1;
+    second_sum += (first >> 16) + (second >> 16) + kAdlerBase - remainder;
+
+    first_sum %= kAdlerBase;
+    second_sum %= kAdlerBase;
+
+    return (second_sum << 16) | first_sum;
+}
+
+uint64_t GetDeflateBound(uint64_t size) {
+    // in the worst case data is stored as is: 5 bytes of a header and up to 1 byte of padding per stored block,
+    // and an empty stored block may be added at the end
+    return size + 6 * (size / 65535 + 2) + 16;
+}
+
+DeflateEncoder::DeflateEncoder(uint8_t level, bool is_huffman_only)
+    : level_(std::min(level, kMaxCompressionLevel)),
+      max_chain_length_(kMaxChainLengths[level_]),
+      nice_length_(kNiceLengths[level_]),
+      is_lazy_(level_ >= kMinLazyLevel),
+      is_huffman_only_(is_huffman_only) {
+    head_ = BufferPool::GetInstance().Allocate<uint32_t>(kHashSize);
+    previous_ = BufferPool::GetInstance().Allocate<uint32_t>(kWindowSize);
+    token_lengths_ = BufferPool::GetInstance().Allocate<uint16_t>(kMaxBlockTokens);
+    token_distances_ = BufferPool::GetInstance().Allocate<uint16_t>(kMaxBlockTokens);
+}
+
+DeflateEncoder::~DeflateEncoder() {
+    BufferPool::GetInstance().Release(head_);
+    BufferPool::GetInstance().Release(previous_);
+    BufferPool::GetInstance().Release(token_lengths_);
+    BufferPool::GetInstance().Release(token_distances_);
+}
+
+uint64_t DeflateEncoder::GetByteSize() {
+    return (kHashSize + kWindowSize) * sizeof(uint32_t) + 2 * kMaxBlockTokens * sizeof(uint16_t);
+}
+
+uint64_t DeflateEncoder::Compress(const uint8_t* data, uint64_t size, uint64_t dictionary_size, bool is_last, uint8_t* output) {
+    dictionary_size = std::min<uint64_t>(dictionary_size, kWindowSize);
+
+    // positions are counted from the beginning of the dictionary, 0 in head_ means no position
+    window_ = data - dictionary_size;
+    output_ = output;
+    bit_buffer_ = 0;
+    bit_count_ = 0;
+    tokens_count_ = 0;
+    extra_bits_count_ = 0;
+
+    if (!is_huffman_only_) {
+        std::fill(head_, head_ + kHashSize, 0);
+    }
+
+    std::fill(literal_frequencies_, literal_frequencies_ + kLiteralsCount, 0);
+    std::fill(distance_frequencies_, distance_frequencies_ + kDistancesCount, 0);
+
+    uint64_t end = dictionary_size + size;
+    uint64_t block_begin = dictionary_size;
+
+    if (level_ == 0) {
+        WriteStoredBlocks(dictionary_size, end, is_last);
+    } else if (is_huffman_only_) {
+        for (uint64_t position = dictionary_size; position < end; ++position) {
+            AddLiteral(window_[position]);
+
+            if (tokens_count_ == kMaxBlockTokens) {
+                FlushBlock(block_begin, position + 1, is_last && position + 1 == end);
+                block_begin = position + 1;
+            }
+        }
+
+        if (tokens_count_ != 0 || block_begin == dictionary_size || !is_last) {
+            FlushBlock(block_begin, end, is_last);
+        }
+    } else {
+        for (uint64_t position = 0; position + kMinMatch <= dictionary_size; ++position) {
+            Insert(position);
+        }
+
+        uint64_t position = dictionary_size;
+
+        while (position < end) {
+            uint32_t distance = 0;
+            uint32_t length = 0;
+
+            if (position + kMinMatch <= end) {
+                length = FindMatch(position, end, distance);
+                Insert(position);
+            }
+
+            // lazy matching: a literal is emitted if the match starting from the next byte is longer
+            while (is_lazy_ && length >= kMinMatch && length < nice_length_ && position + 1 + kMinMatch <= end) {
+                uint32_t next_distance = 0;
+                uint32_t next_length = FindMatch(position + 1, end, next_distance);
+
+                if (next_length <= length) {
+                    break;
+                }
+
+                AddLiteral(window_[position]);
+                ++position;
+                Insert(position);
+
+                length = next_length;
+                distance = next_distance;
+            }
+
+            if (length >= kMinMatch) {
+                AddMatch(length, distance);
+
+                for (uint64_t i = position + 1; i < position + length && i + kMinMatch <= end; ++i) {
+                    Insert(i);
+                }
+
+                position += length;
+            } else {
+                AddLiteral(window_[position]);
+                ++position;
+            }
+
+            // lazy matching adds up to kMaxMatch literals before a match, so the block is flushed in advance
+            if (tokens_count_ + kMaxMatch + 1 >= kMaxBlockTokens) {
+                FlushBlock(block_begin, position, is_last && position == end);
+                block_begin = position;
+            }
+        }
+
+        if (tokens_count_ != 0 || block_begin == dictionary_size || !is_last) {
+            FlushBlock(block_begin, end, is_last);
+        }
+    }
+
+    if (!is_last) {
+        // empty stored block
+        WriteBits(0, 3);
+        AlignToByte();
+        WriteBits(0, 16);
+        WriteBits(0xffff, 16);
+    }
+
+    AlignToByte();
+    return output_ - output;
+}
+
+uint32_t DeflateEncoder::Hash(uint64_t position) const {
+    return ((window_[position] << 10) ^ (window_[position + 1] << 5) ^ window_[position + 2]) & (kHashSize - 1);
+}
+
+void DeflateEncoder::Insert(uint64_t position) {
+    uint32_t hash = Hash(position);
+    previous_[position % kWindowSize] = head_[hash];
+    head_[hash] = position + 1;
+}
+
+uint32_t DeflateEncoder::FindMatch(uint64_t position, uint64_t end, uint32_t& distance) const {
+    uint32_t max_length = std::min<uint64_t>(kMaxMatch, end - position);
+    uint32_t best_length = 0;
+    uint32_t chain_length = max_chain_length_;
+
+    uint64_t candidate = head_[Hash(position)];
+
+    while (candidate != 0 && chain_length-- > 0) {
+        --candidate;
+
+        if (candidate >= position || position - candidate >= kWindowSize) {
+            break;
+        }
+
+        if (window_[candidate + best_length] == window_[position + best_length]) {
+            uint32_t length = 0;
+
+            while (length < max_length && window_[candidate + length] == window_[position + length]) {
+                ++length;
+            }
+
+            if (length > best_length) {
+                best_length = length;
+                distance = position - candidate;
+
+                if (length >= nice_length_ || length == max_length) {
+                    break;
+                }
+            }
+        }
+
+        uint64_t next_candidate = previous_[candidate % kWindowSize];
+
+        // the slot may be already reused by a newer position
+        if (next_candidate > candidate) {
+            break;
+        }
+
+        candidate = next_candidate;
+    }
+
+    return best_length;
+}
+
+void DeflateEncoder::AddLiteral(uint8_t literal) {
+    token_lengths_[tokens_count_] = literal;
+    token_distances_[tokens_count_] = 0;
+    ++tokens_count_;
+
+    ++literal_frequencies_[literal];
+}
+
+void DeflateEncoder::AddMatch(uint32_t length, uint32_t distance) {
+    token_lengths_[tokens_count_] = length;
+    token_distances_[tokens_count_] = distance;
+    ++tokens_count_;
+
+    uint16_t length_symbol = GetLengthSymbol(length);
+    uint16_t distance_symbol = GetDistanceSymbol(distance);
+
+    ++literal_frequencies_[257 + length_symbol];
+    ++distance_frequencies_[distance_symbol];
+    extra_bits_count_ += kLengthExtraBits[length_symbol] + kDistanceExtraBits[distance_symbol];
+}
+
+void DeflateEncoder::FlushBlock(uint64_t begin, uint64_t end, bool is_final) {
+    ++literal_frequencies_[kEndOfBlock];
+
+    uint8_t literal_lengths[kLiteralsCount];
+    uint8_t distance_lengths[kDistancesCount];
+    BuildCodeLengths(literal_frequencies_, kLiteralsCount, kMaxCodeLength, literal_lengths);
+    BuildCodeLengths(distance_frequencies_, kDistancesCount, kMaxCodeLength, distance_lengths);
+
+    uint16_t literals_count = kLiteralsCount;
+    while (literals_count > 257 && literal_lengths[literals_count - 1] == 0) {
+        --literals_count;
+    }
+
+    uint16_t distances_count = kDistancesCount;
+    while (distances_count > 1 && distance_lengths[distances_count - 1] == 0) {
+        --distances_count;
+    }
+
+    // run-length encoding of the code lengths
+    uint8_t all_lengths[kLiteralsCount + kDistancesCount];
+    std::copy(literal_lengths, literal_lengths + literals_count, all_lengths);
+    std::copy(distance_lengths, distance_lengths + distances_count, all_lengths + literals_count);
+    uint16_t all_lengths_count = literals_count + distances_count;
+
+    uint8_t run_symbols[kLiteralsCount + kDistancesCount];
+    uint8_t run_extras[kLiteralsCount + kDistancesCount];
+    uint16_t runs_count = 0;
+    uint32_t code_length_frequencies[kCodeLengthsCount] = {};
+
+    for (uint16_t i = 0; i < all_lengths_count;) {
+        uint16_t run = 1;
+        while (i + run < all_lengths_count && all_lengths[i + run] == all_lengths[i]) {
+            ++run;
+        }
+
+        if (all_lengths[i] == 0 && run >= 11) {
+            run = std::min<uint16_t>(run, 138);
+            run_symbols[runs_count] = 18;
+            run_extras[runs_count] = run - 11;
+        } else if (all_lengths[i] == 0 && run >= 3) {
+            run_symbols[runs_count] = 17;
+            run_extras[runs_count] = run - 3;
+        } else if (all_lengths[i] != 0 && run >= 4) {
+            // the first length is written explicitly, then repeated
+            run_symbols[runs_count] = all_lengths[i];
+            run_extras[runs_count] = 0;
+            ++code_length_frequencies[all_lengths[i]];
+            ++runs_count;
+
+            run = std::min<uint16_t>(run - 1, 6);
+            run_symbols[runs_count] = 16;
+            run_extras[runs_count] = run - 3;
+            ++run;
+        } else {
+            run = 1;
+            run_symbols[runs_count] = all_lengths[i];
+            run_extras[runs_count] = 0;
+        }
+
+        ++code_length_frequencies[run_symbols[runs_count]];
+        ++runs_count;
+        i += run;
+    }
+
+    uint8_t code_length_lengths[kCodeLengthsCount];
+    BuildCodeLengths(code_length_frequencies, kCodeLengthsCount, kMaxCodeLengthCodeLength, code_length_lengths);
+
+    uint8_t code_lengths_count = kCodeLengthsCount;
+    while (code_lengths_count > 4 && code_length_lengths[kCodeLengthsOrder[code_lengths_count - 1]] == 0) {
+        --code_lengths_count;
+    }
+
+    // sizes of the block in bits for each block type
+    uint64_t dynamic_bits_count = 3 + 5 + 5 + 4 + 3 * code_lengths_count + GetDataBitsCount(literal_lengths, distance_lengths);
+    for (uint16_t i = 0; i < runs_count; ++i) {
+        dynamic_bits_count += code_length_lengths[run_symbols[i]];
+        dynamic_bits_count += (run_symbols[i] == 16) ? 2 : ((run_symbols[i] == 17) ? 3 : ((run_symbols[i] == 18) ? 7 : 0));
+    }
+
+    uint8_t fixed_literal_lengths[288];
+    uint8_t fixed_distance_lengths[kDistancesCount];
+    std::fill(fixed_literal_lengths, fixed_literal_lengths + 144, 8);
+    std::fill(fixed_literal_lengths + 144, fixed_literal_lengths + 256, 9);
+    std::fill(fixed_literal_lengths + 256, fixed_literal_lengths + 280, 7);
+    std::fill(fixed_literal_lengths + 280, fixed_literal_lengths + 288, 8);
+    std::fill(fixed_distance_lengths, fixed_distance_lengths + kDistancesCount, 5);
+
+    uint64_t fixed_bits_count = 3 + GetDataBitsCount(fixed_literal_lengths, fixed_distance_lengths);
+
+    uint64_t stored_blocks_count = std::max<uint64_t>(1, (end - begin + kMaxStoredBlockSize - 1) / kMaxStoredBlockSize);
+    uint64_t stored_bits_count = stored_blocks_count * (3 + 7 + 32) + 8 * (end - begin);
+
+    if (stored_bits_count <= dynamic_bits_count && stored_bits_count <= fixed_bits_count) {
+        WriteStoredBlocks(begin, end, is_final);
+    } else if (fixed_bits_count <= dynamic_bits_count) {
+        uint16_t fixed_literal_codes[288];
+        uint16_t fixed_distance_codes[kDistancesCount];
+        BuildCodes(fixed_literal_lengths, 288, fixed_literal_codes);
+        BuildCodes(fixed_distance_lengths, kDistancesCount, fixed_distance_codes);
+
+        WriteBits(is_final, 1);
+        WriteBits(1, 2);
+        WriteTokens(fixed_literal_lengths, fixed_literal_codes, fixed_distance_lengths, fixed_distance_codes);
+    } else {
+        uint16_t literal_codes[kLiteralsCount];
+        uint16_t distance_codes[kDistancesCount];
+        uint16_t code_length_codes[kCodeLengthsCount];
+        BuildCodes(literal_lengths, kLiteralsCount, literal_codes);
+        BuildCodes(distance_lengths, kDistancesCount, distance_codes);
+        BuildCodes(code_length_lengths, kCodeLengthsCount, code_length_codes);
+
+        WriteBits(is_final, 1);
+        WriteBits(2, 2);
+        WriteBits(literals_count - 257, 5);
+        WriteBits(distances_count - 1, 5);
+        WriteBits(code_lengths_count - 4, 4);
+
+        for (uint8_t i = 0; i < code_lengths_count; ++i) {
+            WriteBits(code_length_lengths[kCodeLengthsOrder[i]], 3);
+        }
+
+        for (uint16_t i = 0; i < runs_count; ++i) {
+            WriteBits(code_length_codes[run_symbols[i]], code_length_lengths[run_symbols[i]]);
+
+            if (run_symbols[i] == 16) {
+                WriteBits(run_extras[i], 2);
+            } else if (run_symbols[i] == 17) {
+                WriteBits(run_extras[i], 3);
+            } else if (run_symbols[i] == 18) {
+                WriteBits(run_extras[i], 7);
+            }
+        }
+
+        WriteTokens(literal_lengths, literal_codes, distance_lengths, distance_codes);
+    }
+
+    tokens_count_ = 0;
+    extra_bits_count_ = 0;
+    std::fill(literal_frequencies_, literal_frequencies_ + kLiteralsCount, 0);
+    std::fill(distance_frequencies_, distance_frequencies_ + kDistancesCount, 0);
+}
+
+void DeflateEncoder::WriteStoredBlocks(uint64_t begin, uint64_t end, bool is_final) {
+    do {
+        uint64_t block_size = std::min<uint64_t>(end - begin, kMaxStoredBlockSize);
+        bool is_final_block = is_final && begin + block_size == end;
+
+        WriteBits(is_final_block, 1);
+        WriteBits(0, 2);
+        AlignToByte();
+        WriteBits(block_size, 16);
+        WriteBits(~block_size & 0xffff, 16);
+
+        std::copy(window_ + begin, window_ + begin + block_size, output_);
+        output_ += block_size;
+        begin += block_size;
+    } while (begin < end);
+}
+
+void DeflateEncoder::WriteTokens(const uint8_t* literal_lengths, const uint16_t* literal_codes,
+                                 const uint8_t* distance_lengths, const uint16_t* distance_codes) {
+    for (uint32_t i = 0; i < tokens_count_; ++i) {
+        if (token_distances_[i] == 0) {
+            WriteBits(literal_codes[token_lengths_[i]], literal_lengths[token_lengths_[i]]);
+            continue;
+        }
+
+        uint16_t length_symbol = GetLengthSymbol(token_lengths_[i]);
+        uint16_t distance_symbol = GetDistanceSymbol(token_distances_[i]);
+
+        WriteBits(literal_codes[257 + length_symbol], literal_lengths[257 + length_symbol]);
+        WriteBits(token_lengths_[i] - kLengthBases[length_symbol], kLengthExtraBits[length_symbol]);
+        WriteBits(distance_codes[distance_symbol], distance_lengths[distance_symbol]);
+        WriteBits(token_distances_[i] - kDistanceBases[distance_symbol], kDistanceExtraBits[distance_symbol]);
+    }
+
+    WriteBits(literal_codes[kEndOfBlock], literal_lengths[kEndOfBlock]);
+}
+
+void DeflateEncoder::WriteBits(uint32_t value, uint8_t count) {
+    bit_buffer_ |= static_cast<uint64_t>(value) << bit_count_;
+    bit_count_ += count;
+
+    while (bit_count_ >= 8) {
+        *output_++ = bit_buffer_ & 0xff;
+        bit_buffer_ >>= 8;
+        bit_count_ -= 8;
+    }
+}
+
+void DeflateEncoder::AlignToByte() {
+    if (bit_count_ != 0) {
+        *output_++ = bit_buffer_ & 0xff;
+    }
+
+    bit_buffer_ = 0;
+    bit_count_ = 0;
+}
+
+uint64_t DeflateEncoder::GetDataBitsCount(const uint8_t* literal_lengths, const uint8_t* distance_lengths) const {
+    uint64_t bits_count = extra_bits_count_;
+
+    for (uint16_t i = 0; i < kLiteralsCount; ++i) {
+        bits_count += static_cast<uint64_t>(literal_frequencies_[i]) * literal_lengths[i];
+    }
+
+    for (uint16_t i = 0; i < kDistancesCount; ++i) {
+        bits_count += static_cast<uint64_t>(distance_frequencies_[i]) * distance_lengths[i];
+    }
+
+    return bits_count;
+}
+
+void DeflateEncoder::BuildCodeLengths(const uint32_t* frequencies, uint16_t count, uint8_t max_length, uint8_t* lengths) {
+    // at least 2 symbols are always given a code, so the code is complete (some decoders reject incomplete ones)
+    uint32_t adjusted_frequencies[kLiteralsCount];
+    std::copy(frequencies, frequencies + count, adjusted_frequencies);
+
+    uint16_t used_count = count - std::count(adjusted_frequencies, adjusted_frequencies + count, 0);
+    for (uint16_t i = 0; i < count && used_count < 2; ++i) {
+        if (adjusted_frequencies[i] == 0) {
+            adjusted_frequencies[i] = 1;
+            ++used_count;
+        }
+    }
+
+    // Huffman tree is built with two queues: sorted leaves and internal nodes, which are created in sorted order
+    uint16_t symbols[kLiteralsCount];
+    uint16_t leaves_count = 0;
+    for (uint16_t i = 0; i < count; ++i) {
+        if (adjusted_frequencies[i] != 0) {
+            symbols[leaves_count++] = i;
+        }
+    }
+
+    std::fill(lengths, lengths + count, 0);
+
+    // only possible if the alphabet itself has less than 2 symbols
+    if (leaves_count < 2) {
+        return;
+    }
+
+    std::stable_sort(symbols, symbols + leaves_count, [&](uint16_t left, uint16_t right) {
+        return adjusted_frequencies[left] < adjusted_frequencies[right];
+    });
+
+    // nodes [0, leaves_count) are leaves, the rest are internal
+    uint64_t weights[2 * kLiteralsCount];
+    uint16_t parents[2 * kLiteralsCount];
+    for (uint16_t i = 0; i < leaves_count; ++i) {
+        weights[i] = adjusted_frequencies[symbols[i]];
+    }
+
+    uint16_t next_leaf = 0;
+    uint16_t next_internal = leaves_count;
+    uint16_t nodes_count = leaves_count;
+
+    auto take_smallest = [&]() {
+        if (next_leaf < leaves_count && (next_internal == nodes_count || weights[next_leaf] <= weights[next_internal])) {
+            return next_leaf++;
+        }
+
+        return next_internal++;
+    };
+
+    while (nodes_count < 2 * leaves_count - 1) {
+        uint16_t first = take_smallest();
+        uint16_t second = take_smallest();
+
+        weights[nodes_count] = weights[first] + weights[second];
+        parents[first] = nodes_count;
+        parents[second] = nodes_count;
+        ++nodes_count;
+    }
+
+    // depths are computed from the root, which is the last node
+    uint8_t depths[2 * kLiteralsCount];
+    uint16_t root = nodes_count - 1;
+
+    depths[root] = 0;
+    for (uint16_t i = root; i-- > 0;) {
+        depths[i] = depths[parents[i]] + 1;
+    }
+
+    for (uint16_t i = 0; i < leaves_count; ++i) {
+        lengths[symbols[i]] = std::min(depths[i], max_length);
+    }
+
+    // limiting lengths breaks the Kraft equality: longest codes under the limit are made longer until it holds,
+    // then the codes are made shorter while there is a free space
+    uint64_t kraft_limit = uint64_t{1} << max_length;
+    uint64_t kraft_sum = 0;
+    for (uint16_t i = 0; i < leaves_count; ++i) {
+        kraft_sum += uint64_t{1} << (max_length - lengths[symbols[i]]);
+    }
+
+    while (kraft_sum > kraft_limit) {
+        // leaves are sorted by frequency, so the rarest of the longest codes is taken
+        uint16_t longest = leaves_count;
+        for (uint16_t i = 0; i < leaves_count; ++i) {
+            uint8_t length = lengths[symbols[i]];
+
+            if (length < max_length && (longest == leaves_count || length > lengths[symbols[longest]])) {
+                longest = i;
+            }
+        }
+
+        kraft_sum -= uint64_t{1} << (max_length - lengths[symbols[longest]] - 1);
+        ++lengths[symbols[longest]];
+    }
+
+    while (kraft_sum < kraft_limit) {
+        uint16_t longest = leaves_count;
+        for (uint16_t i = leaves_count; i-- > 0;) {
+            uint8_t length = lengths[symbols[i]];
+
+            if (length > 1 && (uint64_t{1} << (max_length - length)) <= kraft_limit - kraft_sum
+                && (longest == leaves_count || length > lengths[symbols[longest]])) {
+                longest = i;
+            }
+        }
+
+        if (longest == leaves_count) {
+            break;
+        }
+
+        kraft_sum += uint64_t{1} << (max_length - lengths[symbols[longest]]);
+        --lengths[symbols[longest]];
+    }
+}
+
+void DeflateEncoder::BuildCodes(const uint8_t* lengths, uint16_t count, uint16_t* codes) {
+    uint16_t lengths_counts[kMaxCodeLength + 1] = {};
+    for (uint16_t i = 0; i < count; ++i) {
+        ++lengths_counts[lengths[i]];
+    }
+
+    lengths_counts[0] = 0;
+
+    uint16_t next_codes[kMaxCodeLength + 1] = {};
+    uint16_t code = 0;
+    for (uint8_t length = 1; length <= kMaxCodeLength; ++length) {
+        code = (code + lengths_counts[length - 1]) << 1;
+        next_codes[length] = code;
+    }
+
+    // Huffman codes are written starting from the most significant bit, while other data from the least one
+    for (uint16_t i = 0; i < count; ++i) {
+        if (lengths[i] == 0) {
+            codes[i] = 0;
+            continue;
+        }
+
+        uint16_t canonical_code = next_codes[lengths[i]]++;
+        uint16_t reversed_code = 0;
+
+        for (uint8_t bit = 0; bit < lengths[i]; ++bit) {
+            reversed_code |= ((canonical_code >> bit) & 1) << (lengths[i] - 1 - bit);
+        }
+
+        codes[i] = reversed_code;
+    }
+}
+
+uint16_t DeflateEncoder::GetLengthSymbol(uint32_t length) {
+    return std::upper_bound(kLengthBases, kLengthBases + 29, length) - kLengthBases - 1;
+}
+
+uint16_t DeflateEncoder::GetDistanceSymbol(uint32_t distance) {
+    return std::upper_bound(kDistanceBases, kDistanceBases + kDistancesCount, distance) - kDistanceBases - 1;
+}
+
+bool DeflateDecoder::Decompress(const uint8_t* data, uint64_t size, uint8_t* output, uint64_t output_size) {
+    input_ = data;
+    input_size_ = size;
+    input_position_ = 0;
+    bit_buffer_ = 0;
+    bit_count_ = 0;
+
+    output_ = output;
+    output_size_ = output_size;
+    output_position_ = 0;
+    is_corrupted_ = false;
+
+    bool is_final = false;
+
+    while (!is_final) {
+        is_final = ReadBits(1);
+        uint32_t block_type = ReadBits(2);
+        bool is_decompressed = false;
+
+        if (block_type == 0) {
+            is_decompressed = DecompressStoredBlock();
+        } else if (block_type == 1) {
+            uint8_t literal_lengths[288];
+            uint8_t distance_lengths[30];
+            std::fill(literal_lengths, literal_lengths + 144, 8);
+            std::fill(literal_lengths + 144, literal_lengths + 256, 9);
+            std::fill(literal_lengths + 256, literal_lengths + 280, 7);
+            std::fill(literal_lengths + 280, literal_lengths + 288, 8);
+            std::fill(distance_lengths, distance_lengths + 30, 5);
+
+            HuffmanCode literal_code;
+            HuffmanCode distance_code;
+            BuildCode(literal_lengths, 288, literal_code);
+            BuildCode(distance_lengths, 30, distance_code);
+
+            is_decompressed = DecompressCodes(literal_code, distance_code);
+        } else if (block_type == 2) {
+            HuffmanCode literal_code;
+            HuffmanCode distance_code;
+
+            is_decompressed = ReadDynamicCodes(literal_code, distance_code) && DecompressCodes(literal_code, distance_code);
+        }
+
+        if (!is_decompressed || is_corrupted_) {
+            return false;
+        }
+    }
+
+    return output_position_ == output_size_;
+}
+
+uint32_t DeflateDecoder::ReadBits(uint8_t count) {
+    while (bit_count_ < count) {
+        if (input_position_ == input_size_) {
+            is_corrupted_ = true;
+            return 0;
+        }
+
+        bit_buffer_ |= static_cast<uint64_t>(input_[input_position_++]) << bit_count_;
+        bit_count_ += 8;
+    }
+
+    uint32_t value = bit_buffer_ & ((uint64_t{1} << count) - 1);
+    bit_buffer_ >>= count;
+    bit_count_ -= count;
+
+    return value;
+}
+
+bool DeflateDecoder::DecompressStoredBlock() {
+    // the rest of the current byte is skipped
+    bit_buffer_ = 0;
+    bit_count_ = 0;
+
+    uint32_t block_size = ReadBits(16);
+    uint32_t inverted_block_size = ReadBits(16);
+
+    if (is_corrupted_ || block_size != (~inverted_block_size & 0xffff)
+        || block_size > input_size_ - input_position_ || block_size > output_size_ - output_position_) {
+        return false;
+    }
+
+    std::copy(input_ + input_position_, input_ + input_position_ + block_size, output_ + output_position_);
+    input_position_ += block_size;
+    output_position_ += block_size;
+
+    return true;
+}
+
+bool DeflateDecoder::DecompressCodes(const HuffmanCode& literal_code, const HuffmanCode& distance_code) {
+    while (true) {
+        int32_t symbol = DecodeSymbol(literal_code);
+
+        if (symbol < 0) {
+            return false;
+        } else if (symbol < 256) {
+            if (output_position_ == output_size_) {
+                return false;
+            }
+
+            output_[output_position_++] = symbol;
+            continue;
+        } else if (symbol == 256) {
+            return true;
+        }
+
+        uint32_t length_symbol = symbol - 257;
+
+        if (length_symbol >= 29) {
+            return false;
+        }
+
+        uint32_t length = kLengthBases[length_symbol] + ReadBits(kLengthExtraBits[length_symbol]);
+        int32_t distance_symbol = DecodeSymbol(distance_code);
+
+        if (distance_symbol < 0 || distance_symbol >= 30) {
+            return false;
+        }
+
+        uint32_t distance = kDistanceBases[distance_symbol] + ReadBits(kDistanceExtraBits[distance_symbol]);
+
+        if (is_corrupted_ || distance > output_position_ || length > output_size_ - output_position_) {
+            return false;
+        }
+
+        // matches may overlap the bytes they produce, so they are copied byte by byte
+        for (uint32_t i = 0; i < length; ++i) {
+            output_[output_position_] = output_[output_position_ - distance];
+            ++output_position_;
+        }
+    }
+}
+
+bool DeflateDecoder::ReadDynamicCodes(HuffmanCode& literal_code, HuffmanCode& distance_code) {
+    uint16_t literals_count = ReadBits(5) + 257;
+    uint16_t distances_count = ReadBits(5) + 1;
+    uint8_t code_lengths_count = ReadBits(4) + 4;
+
+    if (literals_count > 286 || distances_count > 30) {
+        return false;
+    }
+
+    uint8_t code_length_lengths[19] = {};
+
+    for (uint8_t i = 0; i < code_lengths_count; ++i) {
+        code_length_lengths[kCodeLengthsOrder[i]] = ReadBits(3);
+    }
+
+    HuffmanCode code_length_code;
+
+    if (!BuildCode(code_length_lengths, 19, code_length_code)) {
+        return false;
+    }
+
+    uint8_t lengths[286 + 30];
+    uint16_t lengths_count = literals_count + distances_count;
+
+    for (uint16_t i = 0; i < lengths_count;) {
+        int32_t symbol = DecodeSymbol(code_length_code);
+
+        if (symbol < 0) {
+            return false;
+        } else if (symbol < 16) {
+            lengths[i++] = symbol;
+            continue;
+        }
+
+        uint8_t repeated_length = 0;
+        uint16_t run = 0;
+
+        if (symbol == 16) {
+            if (i == 0) {
+                return false;
+            }
+
+            repeated_length = lengths[i - 1];
+            run = 3 + ReadBits(2);
+        } else if (symbol == 17) {
+            run = 3 + ReadBits(3);
+        } else {
+            run = 11 + ReadBits(7);
+        }
+
+        if (run > lengths_count - i) {
+            return false;
+        }
+
+        std::fill(lengths + i, lengths + i + run, repeated_length);
+        i += run;
+    }
+
+    // a block without the end of block code can't end
+    return !is_corrupted_ && lengths[256] != 0
+        && BuildCode(lengths, literals_count, literal_code)
+        && BuildCode(lengths + literals_count, distances_count, distance_code);
+}
+
+int32_t DeflateDecoder::DecodeSymbol(const HuffmanCode& code) {
+    // canonical codes of each length are consecutive numbers following the codes of the previous length
+    int32_t value = 0;
+    int32_t first = 0;
+    int32_t index = 0;
+
+    for (uint8_t length = 1; length <= kMaxCodeLength; ++length) {
+        value |= ReadBits(1);
+        int32_t count = code.counts[length];
+
+        if (value - first < count) {
+            return code.symbols[index + value - first];
+        }
+
+        index += count;
+        first = (first + count) << 1;
+        value <<= 1;
+    }
+
+    return -1;
+}
+
+bool DeflateDecoder::BuildCode(const uint8_t* lengths, uint16_t count, HuffmanCode& code) {
+    std::fill(code.counts, code.counts + kMaxCodeLength + 1, 0);
+
+    for (uint16_t symbol = 0; symbol < count; ++symbol) {
+        ++code.counts[lengths[symbol]];
+    }
+
+    int32_t left = 1;
+
+    for (uint8_t length = 1; length <= kMaxCodeLength; ++length) {
+        left = (left << 1) - code.counts[length];
+
+        if (left < 0) {
+            return false;
+        }
+    }
+
+    uint16_t offsets[16];
+    offsets[1] = 0;
+
+    for (uint8_t length = 1; length < kMaxCodeLength; ++length) {
+        offsets[length + 1] = offsets[length] + code.counts[length];
+    }
+
+    for (uint16_t symbol = 0; symbol < count; ++symbol) {
+        if (lengths[symbol] != 0) {
+            code.symbols[offsets[lengths[symbol]]++] = symbol;
+        }
+    }
+
+    return true;
+}
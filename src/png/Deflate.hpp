@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+const uint8_t kMaxCompressionLevel = 9;
+
+/** CRC-32 as used in PNG chunks. To continue a checksum, pass the previous result as %crc% */
+uint32_t Crc32(const uint8_t* data, uint64_t size, uint32_t crc = 0);
+
+/** Adler-32 as used in zlib streams. To continue a checksum, pass the previous result as %adler% */
+uint32_t Adler32(const uint8_t* data, uint64_t size, uint32_t adler = 1);
+
+/** @return Adler-32 of concatenated data, given checksums of both parts */
+uint32_t CombineAdler32(uint32_t first, uint32_t second, uint64_t second_size);
+
+/** @return Maximal size of %size% bytes compressed by DeflateEncoder::Compress */
+uint64_t GetDeflateBound(uint64_t size);
+
+/**
+ * Compressor producing raw deflate data (RFC 1951).
+ *
+ * Level 0 only produces stored blocks. Higher levels use LZ77 with hash chains
+ * (longer chains and lazy matching on higher levels) followed by the cheapest
+ * of stored, fixed and dynamic Huffman blocks.
+ *
+ * Independent chunks of data can be compressed by separate encoders and concatenated,
+ * which allows compressing in parallel.
+ *
+ * With %is_huffman_only% no matches are searched for, and the data is only Huffman-coded byte by byte.
+ * That is several times faster and almost as good for data without long repetitions, like noisy bitmaps
+ */
+class DeflateEncoder {
+public:
+    explicit DeflateEncoder(uint8_t level, bool is_huffman_only = false);
+    ~DeflateEncoder();
+
+    DeflateEncoder(const DeflateEncoder& other) = delete;
+    DeflateEncoder& operator=(const DeflateEncoder& other) = delete;
+
+    /**
+     * Compresses %size% bytes starting from %data%.
+     *
+     * @param dictionary_size Amount of bytes right before %data% which can be referenced by matches
+     * (only the last 32 KiB are used), so chunks compressed separately still share the window
+     * @param is_last If false, the output ends with an empty stored block, so it's byte-aligned
+     * and can be followed by the next chunk; otherwise the last block is marked as final
+     * @param output At least GetDeflateBound(%size%) bytes
+     * @return Size of the output
+     */
+    uint64_t Compress(const uint8_t* data, uint64_t size, uint64_t dictionary_size, bool is_last, uint8_t* output);
+
+    /** @return Amount of memory taken by an encoder */
+    static uint64_t GetByteSize();
+
+private:
+    static const uint32_t kWindowSize = 1 << 15;
+    static const uint32_t kHashSize = 1 << 15;
+    static const uint32_t kMinMatch = 3;
+    static const uint32_t kMaxMatch = 258;
+    static const uint32_t kMaxBlockTokens = 1 << 15;
+    static const uint32_t kMaxStoredBlockSize = 65535;
+
+    static const uint16_t kLiteralsCount = 286;
+    static const uint16_t kDistancesCount = 30;
+    static const uint16_t kCodeLengthsCount = 19;
+    static const uint16_t kEndOfBlock = 256;
+
+    uint8_t level_;
+    uint32_t max_chain_length_;
+    uint32_t nice_length_;
+    bool is_lazy_;
+    bool is_huffman_only_;
+
+    const uint8_t* window_ = nullptr;
+    uint32_t* head_ = nullptr;
+    uint32_t* previous_ = nullptr;
+
+    // literal if the distance is 0
+    uint16_t* token_lengths_ = nullptr;
+    uint16_t* token_distances_ = nullptr;
+    uint32_t tokens_count_ = 0;
+
+    uint32_t literal_frequencies_[kLiteralsCount];
+    uint32_t distance_frequencies_[kDistancesCount];
+    uint64_t extra_bits_count_ = 0;
+
+    uint8_t* output_ = nullptr;
+    uint64_t bit_buffer_ = 0;
+    uint8_t bit_count_ = 0;
+
+    uint32_t Hash(uint64_t position) const;
+    void Insert(uint64_t position);
+    uint32_t FindMatch(uint64_t position, uint64_t end, uint32_t& distance) const;
+
+    void AddLiteral(uint8_t literal);
+    void AddMatch(uint32_t length, uint32_t distance);
+    void FlushBlock(uint64_t begin, uint64_t end, bool is_final);
+
+    void WriteStoredBlocks(uint64_t begin, uint64_t end, bool is_final);
+    void WriteTokens(const uint8_t* literal_lengths, const uint16_t* literal_codes,
+                     const uint8_t* distance_lengths, const uint16_t* distance_codes);
+
+    void WriteBits(uint32_t value, uint8_t count);
+    void AlignToByte();
+
+    uint64_t GetDataBitsCount(const uint8_t* literal_lengths, const uint8_t* distance_lengths) const;
+
+    static void BuildCodeLengths(const uint32_t* frequencies, uint16_t count, uint8_t max_length, uint8_t* lengths);
+    static void BuildCodes(const uint8_t* lengths, uint16_t count, uint16_t* codes);
+
+    static uint16_t GetLengthSymbol(uint32_t length);
+    static uint16_t GetDistanceSymbol(uint32_t distance);
+};
+
+/**
+ * Decompressor of raw deflate data (RFC 1951), the counterpart of DeflateEncoder.
+ *
+ * Huffman codes are decoded bit by bit over canonical code counts, which is slow but needs no tables
+ * larger than the alphabets. Fits data read back by the program itself, not bulk decompression
+ */
+class DeflateDecoder {
+public:
+    /**
+     * Decompresses %size% bytes starting from %data% into exactly %output_size% bytes of %output%.
+     * @return false if the data is corrupted or decompresses into another amount of bytes
+     */
+    bool Decompress(const uint8_t* data, uint64_t size, uint8_t* output, uint64_t output_size);
+
+private:
+    struct HuffmanCode {
+        // amount of codes of each length and the symbols ordered by their codes
+        uint16_t counts[16];
+        uint16_t symbols[288];
+    };
+
+    const uint8_t* input_ = nullptr;
+    uint64_t input_size_ = 0;
+    uint64_t input_position_ = 0;
+    uint64_t bit_buffer_ = 0;
+    uint8_t bit_count_ = 0;
+
+    uint8_t* output_ = nullptr;
+    uint64_t output_size_ = 0;
+    uint64_t output_position_ = 0;
+
+    // set on reading past the end of the input
+    bool is_corrupted_ = false;
+
+    uint32_t ReadBits(uint8_t count);
+
+    bool DecompressStoredBlock();
+    bool DecompressCodes(const HuffmanCode& literal_code, const HuffmanCode& distance_code);
+    bool ReadDynamicCodes(HuffmanCode& literal_code, HuffmanCode& distance_code);
+
+    /** @return Decoded symbol or -1 if the code is invalid */
+    int32_t DecodeSymbol(const HuffmanCode& code);
+
+    /** @return false if the lengths are over-subscribed, so they don't form a prefix code */
+    static bool BuildCode(const uint8_t* lengths, uint16_t count, HuffmanCode& code);
+};
@@ -0,0 +1,425 @@
+#include "PngWriter.hpp"
+#include "png/Deflate.hpp"
+#include "memory/BufferPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+const uint8_t kPngSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+// 2 bytes of the zlib header before the deflate data and 4 bytes of Adler-32 after it
+const uint8_t kZlibHeaderByteSize = 2;
+const uint8_t kZlibTrailerByteSize = 4;
+
+// matches of deflate reference at most 32 KiB back
+const uint32_t kDeflateWindowByteSize = 1 << 15;
+
+/**
+ * Calls %task% for each index below %tasks_count%, the tasks are distributed between all hardware threads.
+ * If a task takes %task_byte_size% bytes of memory, not more tasks run at once than fit into the memory limit of BufferPool
+ */
+template<typename Task>
+void RunInParallel(uint64_t tasks_count, uint64_t task_byte_size, const Task& task) {
+    uint64_t threads_count = std::max(1u, std::thread::hardware_concurrency());
+    threads_count = std::min(threads_count, tasks_count);
+
+    if (task_byte_size != 0) {
+        threads_count = std::min(threads_count, std::max<uint64_t>(1, BufferPool::GetInstance().GetAvailableByteSize() / task_byte_size));
+    }
+
+    std::atomic<uint64_t> next_task{0};
+
+    auto run_tasks = [&]() {
+        for (uint64_t i = next_task++; i < tasks_count; i = next_task++) {
+            task(i);
+        }
+    };
+
+    std::thread* workers = new std::thread[threads_count - 1];
+
+    for (uint64_t i = 0; i + 1 < threads_count; ++i) {
+        workers[i] = std::thread{run_tasks};
+    }
+
+    run_tasks();
+
+    for (uint64_t i = 0; i + 1 < threads_count; ++i) {
+        workers[i].join();
+    }
+
+    delete[] workers;
+}
+
+std::optional<PngWriterError> PngWriter::Save(const char* path) const {
+    if (color_table_size_ < 2) {
+        return PngWriterError{"Unable to create a png file: color table size must be at least 2"};
+    } else if (width_ == 0 || height_ == 0) {
+        // png doesn't allow empty images, so an empty one is saved as a single pixel of the first color
+        PngWriter pixel_writer{1, 1, color_table_size_};
+        std::copy(color_table_, color_table_ + color_table_size_, pixel_writer.color_table_);
+        pixel_writer.SetCompressionLevel(compression_level_);
+
+        return pixel_writer.Save(path);
+    }
+
+    uint8_t header[13];
+    uint8_t* current_byte = header;
+    WriteBytes(current_byte, width_);
+    WriteBytes(current_byte, height_);
+    *current_byte++ = GetBitDepth();
+    *current_byte++ = 3; // color type: indexed
+    *current_byte++ = 0; // compression method: deflate
+    *current_byte++ = 0; // filter method: adaptive (only "None" filter is used)
+    *current_byte++ = 0; // interlace method: none
+
+    uint8_t* palette = new uint8_t[color_table_size_ * 3];
+    for (size_t i = 0; i < color_table_size_; ++i) {
+        palette[i * 3] = color_table_[i].red;
+        palette[i * 3 + 1] = color_table_[i].green;
+        palette[i * 3 + 2] = color_table_[i].blue;
+    }
+
+    int file = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool is_written = (file != -1);
+
+    is_written = is_written && WriteAll(file, kPngSignature, sizeof(kPngSignature));
+    is_written = is_written && WriteChunk(file, "IHDR", header, sizeof(header));
+    is_written = is_written && WriteChunk(file, "PLTE", palette, color_table_size_ * 3);
+    is_written = is_written && ((get_row_ != nullptr) ? WriteStreamedImageData(file) : WriteImageData(file));
+    is_written = is_written && WriteChunk(file, "IEND", nullptr, 0);
+
+    delete[] palette;
+
+    if (file == -1) {
+        return PngWriterError{"Unable to open the output file"};
+    } else if (close(file) != 0 || !is_written) {
+        return PngWriterError{"Unable to write to the output file"};
+    }
+
+    return std::nullopt;
+}
+
+bool PngWriter::WriteImageData(int file) const {
+    uint8_t* image_data = EncodeRows();
+    uint64_t image_byte_size = static_cast<uint64_t>(height_) * (GetRowByteSize() + 1);
+
+    // Chunks are compressed independently, but each of them may reference the data of the previous ones,
+    // so the compression ratio is almost the same as of a single stream
+    uint64_t chunks_count = (image_byte_size + kChunkByteSize - 1) / kChunkByteSize;
+    uint8_t** compressed_chunks = new uint8_t*[chunks_count];
+    uint64_t* compressed_sizes = new uint64_t[chunks_count];
+    uint32_t* checksums = new uint32_t[chunks_count];
+
+    // the compressed chunks are kept until the end anyway, only the encoders are freed after each chunk
+    RunInParallel(chunks_count, DeflateEncoder::GetByteSize(), [&](uint64_t chunk) {
+        uint64_t begin = chunk * kChunkByteSize;
+        uint64_t size = std::min<uint64_t>(kChunkByteSize, image_byte_size - begin);
+        bool is_last = (chunk + 1 == chunks_count);
+
+        compressed_chunks[chunk] = BufferPool::GetInstance().Allocate<uint8_t>(
+            kZlibHeaderByteSize + GetDeflateBound(size) + kZlibTrailerByteSize);
+
+        // the zlib header goes before the first chunk
+        uint8_t* output = compressed_chunks[chunk] + ((chunk == 0) ? kZlibHeaderByteSize : 0);
+
+        DeflateEncoder encoder{compression_level_};
+        compressed_sizes[chunk] = (output - compressed_chunks[chunk])
+            + encoder.Compress(image_data + begin, size, begin, is_last, output);
+        checksums[chunk] = Adler32(image_data + begin, size);
+    });
+
+    WriteZlibHeader(compressed_chunks[0]);
+
+    uint32_t checksum = checksums[0];
+    for (uint64_t i = 1; i < chunks_count; ++i) {
+        uint64_t size = std::min<uint64_t>(kChunkByteSize, image_byte_size - i * kChunkByteSize);
+        checksum = CombineAdler32(checksum, checksums[i], size);
+    }
+
+    uint8_t* trailer = compressed_chunks[chunks_count - 1] + compressed_sizes[chunks_count - 1];
+    WriteBytes(trailer, checksum);
+    compressed_sizes[chunks_count - 1] += kZlibTrailerByteSize;
+
+    BufferPool::GetInstance().Release(image_data);
+
+    bool is_written = true;
+
+    for (uint64_t i = 0; i < chunks_count; ++i) {
+        is_written = is_written && WriteChunk(file, "IDAT", compressed_chunks[i], compressed_sizes[i]);
+        BufferPool::GetInstance().Release(compressed_chunks[i]);
+    }
+
+    delete[] compressed_chunks;
+    delete[] compressed_sizes;
+    delete[] checksums;
+
+    return is_written;
+}
+
+bool PngWriter::WriteStreamedImageData(int file) const {
+    uint64_t stride = GetRowByteSize() + 1;
+    uint32_t rows_per_chunk = std::max<uint64_t>(1, kStreamedChunkByteSize / stride);
+    uint64_t chunk_byte_size = static_cast<uint64_t>(rows_per_chunk) * stride;
+
+    // the end of the previous data is kept before each chunk, so the chunks share the window
+    uint8_t* data = BufferPool::GetInstance().Allocate<uint8_t>(kDeflateWindowByteSize + chunk_byte_size);
+    uint8_t* output = BufferPool::GetInstance().Allocate<uint8_t>(
+        kZlibHeaderByteSize + GetDeflateBound(chunk_byte_size) + kZlibTrailerByteSize);
+    uint8_t* row_indeces = BufferPool::GetInstance().Allocate<uint8_t>(width_);
+
+    DeflateEncoder encoder{compression_level_};
+    uint64_t dictionary_size = 0;
+    uint32_t checksum = Adler32(data, 0);
+    bool is_written = true;
+
+    for (uint32_t first_row = 0; first_row < height_ && is_written; first_row += rows_per_chunk) {
+        uint32_t rows_count = std::min(rows_per_chunk, height_ - first_row);
+        uint64_t size = static_cast<uint64_t>(rows_count) * stride;
+        uint8_t* chunk = data + dictionary_size;
+
+        for (uint32_t i = 0; i < rows_count; ++i) {
+            EncodeRow(GetRowIndeces(first_row + i, row_indeces), chunk + i * stride);
+        }
+
+        bool is_last = (first_row + rows_count == height_);
+
+        // the zlib header goes before the first chunk
+        uint8_t* compressed = output + ((first_row == 0) ? kZlibHeaderByteSize : 0);
+        uint64_t compressed_size = (compressed - output) + encoder.Compress(chunk, size, dictionary_size, is_last, compressed);
+
+        if (first_row == 0) {
+            WriteZlibHeader(output);
+        }
+
+        checksum = Adler32(chunk, size, checksum);
+
+        if (is_last) {
+            uint8_t* trailer = output + compressed_size;
+            WriteBytes(trailer, checksum);
+            compressed_size += kZlibTrailerByteSize;
+        }
+
+        is_written = WriteChunk(file, "IDAT", output, compressed_size);
+
+        uint64_t kept_size = std::min<uint64_t>(kDeflateWindowByteSize, dictionary_size + size);
+        std::copy(chunk + size - kept_size, chunk + size, data);
+        dictionary_size = kept_size;
+    }
+
+    BufferPool::GetInstance().Release(data);
+    BufferPool::GetInstance().Release(output);
+    BufferPool::GetInstance().Release(row_indeces);
+
+    return is_written;
+}
+
+uint8_t* PngWriter::EncodeRows() const {
+    uint64_t stride = GetRowByteSize() + 1;
+    uint8_t* image_data = BufferPool::GetInstance().Allocate<uint8_t>(static_cast<uint64_t>(height_) * stride);
+
+    uint32_t rows_per_block = std::max<uint64_t>(1, kBlockByteSize / stride);
+    uint64_t blocks_count = (height_ + rows_per_block - 1) / rows_per_block;
+
+    RunInParallel(blocks_count, 0, [&](uint64_t block) {
+        uint32_t first_row = block * rows_per_block;
+        uint32_t last_row = std::min<uint64_t>(height_, static_cast<uint64_t>(first_row) + rows_per_block);
+        uint8_t* row_indeces = (pixel_table_indeces_ == nullptr) ? BufferPool::GetInstance().Allocate<uint8_t>(width_) : nullptr;
+
+        for (uint32_t row = first_row; row < last_row; ++row) {
+            EncodeRow(GetRowIndeces(row, row_indeces), image_data + row * stride);
+        }
+
+        BufferPool::GetInstance().Release(row_indeces);
+    });
+
+    return image_data;
+}
+
+const uint8_t* PngWriter::GetRowIndeces(uint32_t row, uint8_t* buffer) const {
+    if (get_row_ != nullptr) {
+        // png rows go from top to bottom
+        get_row_(get_row_context_, height_ - 1 - row, buffer);
+        return buffer;
+    } else if (pixel_table_indeces_ == nullptr) {
+        // no pixels are set
+        std::fill(buffer, buffer + width_, 0);
+        return buffer;
+    }
+
+    return pixel_table_indeces_ + static_cast<uint64_t>(row) * width_;
+}
+
+void PngWriter::EncodeRow(const uint8_t* indeces, uint8_t* destination) const {
+    uint8_t bit_depth = GetBitDepth();
+
+    // filter type "None"
+    *destination++ = 0;
+    std::fill(destination, destination + GetRowByteSize(), 0);
+
+    // pixels are packed starting from the most significant bits of each byte
+    for (uint32_t x = 0; x < width_; ++x) {
+        uint64_t bit_in_row = static_cast<uint64_t>(x) * bit_depth;
+        destination[bit_in_row / 8] |= indeces[x] << (8 - bit_depth - bit_in_row % 8);
+    }
+}
+
+void PngWriter::WriteZlibHeader(uint8_t* destination) const {
+    // 32K window, deflate; the compression level is only informational
+    uint8_t compression_info = 0x78;
+    uint8_t level_flags = (compression_level_ < 2) ? 0 : ((compression_level_ < 6) ? 1 : ((compression_level_ == 6) ? 2 : 3));
+    uint8_t flags = level_flags << 6;
+    flags += 31 - (compression_info * 256 + flags) % 31;
+
+    destination[0] = compression_info;
+    destination[1] = flags;
+}
+
+bool PngWriter::WriteChunk(int file, const char* type, const uint8_t* data, uint32_t size) const {
+    uint8_t prefix[8];
+    uint8_t* current_byte = prefix;
+    WriteBytes(current_byte, size);
+    std::copy(type, type + 4, current_byte);
+
+    // the checksum covers the chunk type and data, but not the length
+    uint8_t suffix[4];
+    current_byte = suffix;
+    WriteBytes(current_byte, Crc32(data, size, Crc32(prefix + 4, 4)));
+
+    return WriteAll(file, prefix, sizeof(prefix)) && WriteAll(file, data, size) && WriteAll(file, suffix, sizeof(suffix));
+}
+
+bool PngWriter::WriteAll(int file, const uint8_t* data, uint64_t size) const {
+    while (size != 0) {
+        ssize_t written = write(file, data, size);
+
+        if (written <= 0) {
+            return false;
+        }
+
+        data += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+void PngWriter::WriteBytes(uint8_t*& destination, uint32_t bytes) const {
+    // png uses big-endian byte order
+    *destination++ = (bytes >> 24) & 0xff;
+    *destination++ = (bytes >> 16) & 0xff;
+    *destination++ = (bytes >> 8) & 0xff;
+    *destination++ = bytes & 0xff;
+}
+
+uint32_t PngWriter::GetRowByteSize() const {
+    return (static_cast<uint64_t>(width_) * GetBitDepth() + 7) / 8;
+}
+
+uint8_t PngWriter::GetBitDepth() const {
+    if (color_table_size_ <= 2) {
+        return 1;
+    } else if (color_table_size_ <= 4) {
+        return 2;
+    } else if (color_table_size_ <= 16) {
+        return 4;
+    }
+
+    return 8;
+}
+
+void PngWriter::SetCompressionLevel(uint8_t level) {
+    compression_level_ = std::min(level, kMaxCompressionLevel);
+}
+
+std::optional<PngWriterError> PngWriter::SetPixel(uint32_t x, uint32_t y, uint8_t color_table_index) {
+    if (x >= width_ || y >= height_) {
+        return PngWriterError{"Pixel index is out of bounds"};
+    } else if (color_table_index >= color_table_size_) {
+        return PngWriterError{"Color index is out of bounds"};
+    }
+
+    if (pixel_table_indeces_ == nullptr) [[unlikely]] {
+        pixel_table_indeces_ = BufferPool::GetInstance().Allocate<uint8_t>(GetPixelDataSize());
+        std::fill(pixel_table_indeces_, pixel_table_indeces_ + GetPixelDataSize(), 0);
+    }
+
+    // png rows go from top to bottom
+    pixel_table_indeces_[static_cast<uint64_t>(height_ - 1 - y) * width_ + x] = color_table_index;
+    return std::nullopt;
+}
+
+std::optional<PngWriterError> PngWriter::SetColor(uint32_t table_index, Color color) {
+    if (table_index >= color_table_size_) {
+        return PngWriterError{"Color index is out of bounds"};
+    }
+
+    color_table_[table_index] = color;
+    return std::nullopt;
+}
+
+uint64_t PngWriter::GetPixelDataSize() const {
+    return static_cast<uint64_t>(width_) * height_;
+}
+
+PngWriter::PngWriter(uint32_t width, uint32_t height, uint8_t color_table_size) {
+    width_ = width;
+    height_ = height;
+    color_table_size_ = color_table_size;
+
+    color_table_ = new Color[color_table_size];
+}
+
+PngWriter::PngWriter(const PngWriter& other)
+    : color_table_(new Color[other.color_table_size_]),
+      get_row_(other.get_row_),
+      get_row_context_(other.get_row_context_),
+      width_(other.width_),
+      height_(other.height_),
+      color_table_size_(other.color_table_size_),
+      compression_level_(other.compression_level_) {
+    std::copy(other.color_table_, other.color_table_ + color_table_size_, color_table_);
+
+    if (other.pixel_table_indeces_ != nullptr) {
+        pixel_table_indeces_ = BufferPool::GetInstance().Allocate<uint8_t>(GetPixelDataSize());
+        std::copy(other.pixel_table_indeces_, other.pixel_table_indeces_ + GetPixelDataSize(), pixel_table_indeces_);
+    }
+}
+
+PngWriter& PngWriter::operator=(const PngWriter& other) {
+    if (this == &other) {
+        return *this;
+    }
+
+    Color* new_color_table = new Color[other.color_table_size_];
+    std::copy(other.color_table_, other.color_table_ + other.color_table_size_, new_color_table);
+
+    uint8_t* new_pixel_table_indeces = nullptr;
+
+    if (other.pixel_table_indeces_ != nullptr) {
+        new_pixel_table_indeces = BufferPool::GetInstance().Allocate<uint8_t>(other.GetPixelDataSize());
+        std::copy(other.pixel_table_indeces_, other.pixel_table_indeces_ + other.GetPixelDataSize(), new_pixel_table_indeces);
+    }
+
+    delete[] color_table_;
+    BufferPool::GetInstance().Release(pixel_table_indeces_);
+
+    width_ = other.width_;
+    height_ = other.height_;
+    color_table_size_ = other.color_table_size_;
+    compression_level_ = other.compression_level_;
+    color_table_ = new_color_table;
+    pixel_table_indeces_ = new_pixel_table_indeces;
+    get_row_ = other.get_row_;
+    get_row_context_ = other.get_row_context_;
+
+    return *this;
+}
+
+PngWriter::~PngWriter() {
+    delete[] color_table_;
+    BufferPool::GetInstance().Release(pixel_table_indeces_);
+}
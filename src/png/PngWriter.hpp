@@ -0,0 +1,98 @@
+#pragma once
+
+#include "bmp/BmpWriter.hpp"
+
+#include <cstdint>
+#include <optional>
+
+struct PngWriterError {
+    const char* message = nullptr;
+};
+
+/**
+ * Class to generate .png files.
+ * Uses a palette, so only supports 1, 2, 4 and 8 bits per pixel.
+ * Pixel coordinates are the same as in BmpWriter: row 0 is the bottom one.
+ * Image data is compressed by independent chunks in parallel (see DeflateEncoder).
+ * An image with a row source is instead encoded and compressed chunk by chunk as it's written,
+ * so neither the pixels nor the image data are stored
+ */
+class PngWriter {
+public:
+    PngWriter(uint32_t width, uint32_t height, uint8_t color_table_size);
+
+    ~PngWriter();
+    PngWriter(const PngWriter& other);
+    PngWriter& operator=(const PngWriter& other);
+
+    /** Adds color to the palette */
+    std::optional<PngWriterError> SetColor(uint32_t table_index, Color color);
+    std::optional<PngWriterError> SetPixel(uint32_t x, uint32_t y, uint8_t color_table_index);
+
+    /**
+     * Makes Save() take the pixels from %get_row% instead of the ones set by SetPixel().
+     * %get_row%(y, indeces) fills the color table indices of the row y (row 0 is the bottom one).
+     * Each row is requested once, by a single thread. %get_row% has to outlive the writer
+     */
+    template<typename RowSource>
+    void SetRowSource(const RowSource& get_row);
+
+    /** 0 stores the data uncompressed, 9 is the slowest and the best compression. 6 by default */
+    void SetCompressionLevel(uint8_t level);
+
+    std::optional<PngWriterError> Save(const char* path) const;
+
+    uint64_t GetPixelDataSize() const;
+    uint32_t GetRowByteSize() const;
+    uint8_t GetBitDepth() const;
+
+private:
+    Color* color_table_ = nullptr;
+    uint8_t* pixel_table_indeces_ = nullptr;
+
+    // the row source, type-erased
+    void (*get_row_)(const void* context, uint32_t y, uint8_t* indeces) = nullptr;
+    const void* get_row_context_ = nullptr;
+
+    uint32_t width_;
+    uint32_t height_;
+    uint8_t color_table_size_;
+    uint8_t compression_level_ = 6;
+
+    // size of image data compressed by one thread at a time
+    static const uint32_t kChunkByteSize = 1 << 18;
+
+    // approximate size of a block of rows encoded by one thread at a time
+    static const uint32_t kBlockByteSize = 1 << 20;
+
+    // approximate size of image data compressed at a time from a row source
+    static const uint32_t kStreamedChunkByteSize = 1 << 15;
+
+    /** Writes IDAT chunks compressed in parallel from the stored pixels */
+    bool WriteImageData(int file) const;
+
+    /** Writes IDAT chunks compressed one by one from the row source */
+    bool WriteStreamedImageData(int file) const;
+
+    /** @return Rows with a filter type byte before each of them, as they are stored in a png file */
+    uint8_t* EncodeRows() const;
+
+    /** @return Color table indices of the row (counted from the top), %buffer% of the image width is used if they aren't stored */
+    const uint8_t* GetRowIndeces(uint32_t row, uint8_t* buffer) const;
+    void EncodeRow(const uint8_t* indeces, uint8_t* destination) const;
+
+    void WriteZlibHeader(uint8_t* destination) const;
+
+    bool WriteChunk(int file, const char* type, const uint8_t* data, uint32_t size) const;
+    bool WriteAll(int file, const uint8_t* data, uint64_t size) const;
+
+    void WriteBytes(uint8_t*& destination, uint32_t bytes) const;
+};
+
+template<typename RowSource>
+void PngWriter::SetRowSource(const RowSource& get_row) {
+    get_row_ = [](const void* context, uint32_t y, uint8_t* indeces) {
+        (*static_cast<const RowSource*>(context))(y, indeces);
+    };
+    get_row_context_ = &get_row;
+}
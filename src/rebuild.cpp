@@ -0,0 +1,140 @@
+#include "delta/DeltaReader.hpp"
+#include "bmp/BmpWriter.hpp"
+#include "png/PngWriter.hpp"
+#include "memory/BufferPool.hpp"
+
+#include <cstring>
+#include <iostream>
+
+template<typename ImageWriter>
+std::optional<const char*> SaveFrame(const DeltaReader& reader, ImageWriter& image_writer, const char* path) {
+    DeltaBounds bounds = reader.GetBounds();
+
+    for (uint8_t i = 0; i < reader.GetPaletteSize(); ++i) {
+        image_writer.SetColor(i, reader.GetPalette()[i]);
+    }
+
+    for (int32_t y = bounds.min_y; y <= bounds.max_y; ++y) {
+        for (int32_t x = bounds.min_x; x <= bounds.max_x; ++x) {
+            if (image_writer.SetPixel(x - bounds.min_x, y - bounds.min_y, reader.GetColorIndex(x, y)).has_value()) {
+                return "The frame contains an unknown color";
+            }
+        }
+    }
+
+    auto saving_result = image_writer.Save(path);
+
+    if (saving_result.has_value()) {
+        return saving_result.value().message;
+    }
+
+    return std::nullopt;
+}
+
+/** Saves the current frame of %reader% as <output directory><prefix><label><extension> */
+std::optional<const char*> SaveFrame(const DeltaReader& reader, const char* output_directory) {
+    const char* extension = reader.GetExtension();
+    DeltaBounds bounds = reader.GetBounds();
+
+    uint32_t width = static_cast<int32_t>(bounds.max_x) - bounds.min_x + 1;
+    uint32_t height = static_cast<int32_t>(bounds.max_y) - bounds.min_y + 1;
+
+    size_t path_length = std::strlen(output_directory) + std::strlen(reader.GetPrefix())
+        + std::strlen(reader.GetLabel()) + std::strlen(extension) + 1;
+    char* path = BufferPool::GetInstance().Allocate<char>(path_length);
+    std::sprintf(path, "%s%s%s%s", output_directory, reader.GetPrefix(), reader.GetLabel(), extension);
+
+    std::optional<const char*> saving_result;
+    size_t extension_length = std::strlen(extension);
+
+    if (extension_length >= 4 && std::strcmp(extension + extension_length - 4, ".png") == 0) {
+        PngWriter png_writer{width, height, reader.GetPaletteSize()};
+        saving_result = SaveFrame(reader, png_writer, path);
+    } else {
+        BmpWriter bmp_writer{width, height, reader.GetPaletteSize()};
+        saving_result = SaveFrame(reader, bmp_writer, path);
+    }
+
+    BufferPool::GetInstance().Release(path);
+    return saving_result;
+}
+
+/** Rebuilds full images from a delta snapshots file (see Sandpile::SetDeltaSnapshots) */
+int main(int argc, char** argv) {
+    if (argc < 3 || argc > 4) {
+        std::cout << "Usage: SandpileRebuild <delta file> <output directory> [label]" << std::endl
+            << "Saves the frame with the given label (e.g. 100 or final), or all frames if it's omitted, "
+            << "as <output directory><prefix><label><extension>" << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    const char* output_directory = argv[2];
+    const char* label = (argc == 4) ? argv[3] : nullptr;
+
+    DeltaReader reader;
+    std::optional<DeltaReaderError> opening_result = reader.Open(argv[1]);
+
+    if (opening_result.has_value()) {
+        std::cerr << opening_result.value().message << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    uint64_t first_frame_offset = reader.Tell();
+
+    if (label != nullptr) {
+        // only the frames since the last keyframe before the requested one are applied
+        uint64_t keyframe_offset = first_frame_offset;
+        bool is_found = false;
+
+        while (!is_found) {
+            uint64_t frame_offset = reader.Tell();
+            std::expected<bool, DeltaReaderError> skipping_result = reader.SkipFrame();
+
+            if (!skipping_result.has_value()) {
+                std::cerr << skipping_result.error().message << std::endl;
+                return EXIT_FAILURE;
+            } else if (!skipping_result.value()) {
+                std::cerr << "No frame with such label: " << label << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            if (reader.IsKeyframe()) {
+                keyframe_offset = frame_offset;
+            }
+
+            is_found = (std::strcmp(reader.GetLabel(), label) == 0);
+        }
+
+        reader.Seek(keyframe_offset);
+    }
+
+    while (true) {
+        std::expected<bool, DeltaReaderError> reading_result = reader.ReadFrame();
+
+        if (!reading_result.has_value()) {
+            std::cerr << reading_result.error().message << std::endl;
+            return EXIT_FAILURE;
+        } else if (!reading_result.value()) {
+            break;
+        }
+
+        if (label != nullptr && std::strcmp(reader.GetLabel(), label) != 0) {
+            continue;
+        }
+
+        std::optional<const char*> saving_result = SaveFrame(reader, output_directory);
+
+        if (saving_result.has_value()) {
+            std::cerr << saving_result.value() << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::cout << "Saved frame " << reader.GetLabel() << std::endl;
+
+        if (label != nullptr) {
+            break;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+#include "events/EventLogReader.hpp"
+#include "model/Sandpile.hpp"
+#include "parsing/utils.hpp"
+#include "memory/BufferPool.hpp"
+
+#include <cstring>
+#include <iostream>
+
+/** @return Offset of the last checkpoint not later than %iteration% */
+std::expected<uint64_t, const char*> FindCheckpoint(EventLogReader& reader, uint64_t first_record_offset, uint64_t iteration) {
+    reader.Seek(first_record_offset);
+
+    std::optional<uint64_t> checkpoint_offset;
+
+    while (true) {
+        uint64_t record_offset = reader.Tell();
+        std::expected<bool, EventLogReaderError> skipping_result = reader.SkipRecord();
+
+        if (!skipping_result.has_value()) {
+            return std::unexpected{skipping_result.error().message};
+        } else if (!skipping_result.value() || reader.GetIteration() > iteration) {
+            break;
+        }
+
+        if (reader.GetRecordType() == kCheckpointRecord) {
+            checkpoint_offset = record_offset;
+        }
+    }
+
+    if (!checkpoint_offset.has_value()) {
+        return std::unexpected{"The event log has no checkpoints"};
+    }
+
+    return checkpoint_offset.value();
+}
+
+/** Rebuilds the state after %iteration% iterations and saves it as <output directory><prefix><iteration><extension> */
+std::optional<const char*> ReplayIteration(
+    EventLogReader& reader,
+    uint64_t first_record_offset,
+    uint64_t iteration,
+    const char* output_directory)
+{
+    std::expected<uint64_t, const char*> checkpoint_offset = FindCheckpoint(reader, first_record_offset, iteration);
+
+    if (!checkpoint_offset.has_value()) {
+        return checkpoint_offset.error();
+    }
+
+    reader.Seek(checkpoint_offset.value());
+    std::expected<bool, EventLogReaderError> reading_result = reader.ReadRecord();
+
+    if (!reading_result.has_value()) {
+        return reading_result.error().message;
+    }
+
+    Grid grid;
+
+    if (!reader.IsCheckpointEmpty()) {
+        EventLogBounds bounds = reader.GetBounds();
+
+        if (reader.IsBounded()) {
+            grid.SetSinkBoundary(bounds.min_x, bounds.min_y, bounds.max_x, bounds.max_y);
+        } else {
+            grid.AddSand(bounds.min_x, bounds.min_y, 0);
+            grid.AddSand(bounds.max_x, bounds.max_y, 0);
+        }
+    }
+
+    std::optional<EventLogReaderError> applying_result = reader.ForEachCell([&grid](int16_t x, int16_t y, uint64_t sand) {
+        grid.SetSand(x, y, sand);
+    });
+
+    if (applying_result.has_value()) {
+        return applying_result.value().message;
+    }
+
+    Sandpile sandpile{grid};
+    sandpile.SetCriticalSandNumber(reader.GetCriticalSandNumber());
+    sandpile.SetOutputDirectory(output_directory);
+    sandpile.SetOutputFilePrefix(reader.GetPrefix());
+    sandpile.SetOutputFileExtension(reader.GetExtension());
+
+    uint64_t last_iteration = reader.GetIteration();
+
+    while (true) {
+        reading_result = reader.ReadRecord();
+
+        if (!reading_result.has_value()) {
+            return reading_result.error().message;
+        } else if (!reading_result.value() || reader.GetIteration() > iteration) {
+            break;
+        }
+
+        if (reader.GetRecordType() == kIterationRecord) {
+            applying_result = reader.ForEachToppling([&sandpile](int16_t x, int16_t y) {
+                sandpile.ToppleCell(x, y);
+            });
+        } else if (reader.GetRecordType() == kGrainsRecord) {
+            applying_result = reader.ForEachGrain([&grid](int16_t x, int16_t y, uint64_t amount) {
+                grid.AddSand(x, y, amount);
+            });
+        }
+
+        if (applying_result.has_value()) {
+            return applying_result.value().message;
+        }
+
+        last_iteration = reader.GetIteration();
+    }
+
+    if (last_iteration != iteration) {
+        return "The event log ends before the requested iteration";
+    }
+
+    // max length of uint64_t (decimal) is 20
+    size_t filename_length = std::strlen(reader.GetPrefix()) + 20 + std::strlen(reader.GetExtension()) + 1;
+    char* filename = BufferPool::GetInstance().Allocate<char>(filename_length);
+    std::sprintf(filename, "%s%llu%s", reader.GetPrefix(), static_cast<unsigned long long>(iteration), reader.GetExtension());
+
+    std::optional<SandpileError> saving_result = sandpile.SaveCurrentState(filename);
+    BufferPool::GetInstance().Release(filename);
+
+    if (saving_result.has_value()) {
+        return saving_result.value().message;
+    }
+
+    return std::nullopt;
+}
+
+/** Rebuilds states from a toppling event log (see Sandpile::SetEventLog) */
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::cout << "Usage: SandpileReplay <event log> <output directory> <iteration>..." << std::endl
+            << "Saves the state after each given amount of iterations "
+            << "as <output directory><prefix><iteration><extension>" << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    const char* output_directory = argv[2];
+
+    EventLogReader reader;
+    std::optional<EventLogReaderError> opening_result = reader.Open(argv[1]);
+
+    if (opening_result.has_value()) {
+        std::cerr << opening_result.value().message << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    uint64_t first_record_offset = reader.Tell();
+
+    for (int i = 3; i < argc; ++i) {
+        std::expected<uint64_t, const char*> iteration = ParseNumber<uint64_t>(argv[i]);
+
+        if (!iteration.has_value()) {
+            std::cerr << iteration.error() << ": " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::optional<const char*> replaying_result = ReplayIteration(reader, first_record_offset, iteration.value(), output_directory);
+
+        if (replaying_result.has_value()) {
+            std::cerr << replaying_result.value() << ": " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::cout << "Saved iteration " << iteration.value() << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
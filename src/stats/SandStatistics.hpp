@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// heights from 0 to kHistogramSize - 2 have their own bars, the last bar is for all higher cells
+const uint32_t kHistogramSize = 9;
+
+/**
+ * Statistics of a set of cells, gathered by the loops which already read the cells for saving a state.
+ * The radius is the distance of the farthest cell with sand from (0, 0)
+ */
+struct SandStatistics {
+    uint64_t histogram[kHistogramSize] = {};
+    uint64_t mass = 0;
+    uint32_t max_squared_radius = 0;
+
+    void AddCell(int32_t x, int32_t y, uint64_t sand);
+    void Add(const SandStatistics& other);
+};
+
+inline void SandStatistics::AddCell(int32_t x, int32_t y, uint64_t sand) {
+    ++histogram[std::min<uint64_t>(sand, kHistogramSize - 1)];
+    mass += sand;
+
+    if (sand != 0) {
+        max_squared_radius = std::max<uint32_t>(max_squared_radius, static_cast<uint32_t>(x * x) + static_cast<uint32_t>(y * y));
+    }
+}
+
+inline void SandStatistics::Add(const SandStatistics& other) {
+    for (uint32_t i = 0; i < kHistogramSize; ++i) {
+        histogram[i] += other.histogram[i];
+    }
+
+    mass += other.mass;
+    max_squared_radius = std::max(max_squared_radius, other.max_squared_radius);
+}
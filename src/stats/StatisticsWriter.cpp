@@ -0,0 +1,50 @@
+#include "stats/StatisticsWriter.hpp"
+
+#include <cmath>
+#include <iomanip>
+
+std::optional<StatisticsWriterError> StatisticsWriter::Open(const char* path) {
+    file_.open(path, std::ios::trunc);
+
+    if (!file_.good()) {
+        return StatisticsWriterError{"Unable to open the statistics file"};
+    }
+
+    file_ << "iteration,mass,active_cells,cells,radius";
+
+    for (uint32_t i = 0; i + 1 < kHistogramSize; ++i) {
+        file_ << ",height_" << i;
+    }
+
+    file_ << ",height_" << kHistogramSize - 1 << "+\n";
+    file_ << std::fixed << std::setprecision(2);
+
+    return std::nullopt;
+}
+
+bool StatisticsWriter::IsOpen() const {
+    return file_.is_open();
+}
+
+std::optional<StatisticsWriterError> StatisticsWriter::Write(
+    uint64_t iteration,
+    const SandStatistics& statistics,
+    uint64_t active_cells_count,
+    uint64_t cells_count)
+{
+    file_ << iteration << ',' << statistics.mass << ',' << active_cells_count << ',' << cells_count << ','
+        << std::sqrt(static_cast<double>(statistics.max_squared_radius));
+
+    for (uint32_t i = 0; i < kHistogramSize; ++i) {
+        file_ << ',' << statistics.histogram[i];
+    }
+
+    // a line per state, so the series can be watched while the model runs
+    file_ << std::endl;
+
+    if (!file_.good()) {
+        return StatisticsWriterError{"Unable to write to the statistics file"};
+    }
+
+    return std::nullopt;
+}
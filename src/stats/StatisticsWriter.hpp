@@ -0,0 +1,37 @@
+#pragma once
+
+#include "stats/SandStatistics.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+
+struct StatisticsWriterError {
+    const char* message = nullptr;
+};
+
+/**
+ * Writes statistics of the saved states as a CSV time series, one line per state:
+ * iteration,mass,active_cells,cells,radius,height_0,...,height_7,height_8+
+ * where active cells are the unstable ones and cells is the area of the grid
+ */
+class StatisticsWriter {
+public:
+    StatisticsWriter() = default;
+
+    StatisticsWriter(const StatisticsWriter& other) = delete;
+    StatisticsWriter& operator=(const StatisticsWriter& other) = delete;
+
+    /** Creates the file and writes the header */
+    std::optional<StatisticsWriterError> Open(const char* path);
+    bool IsOpen() const;
+
+    std::optional<StatisticsWriterError> Write(
+        uint64_t iteration,
+        const SandStatistics& statistics,
+        uint64_t active_cells_count,
+        uint64_t cells_count);
+
+private:
+    std::ofstream file_;
+};
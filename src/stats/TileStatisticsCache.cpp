@@ -0,0 +1,58 @@
+#include "stats/TileStatisticsCache.hpp"
+#include "memory/BufferPool.hpp"
+
+#include <algorithm>
+
+TileStatisticsCache::~TileStatisticsCache() {
+    BufferPool::GetInstance().Release(tiles_);
+}
+
+void TileStatisticsCache::Fit(uint32_t first_tile_x, uint32_t first_tile_y, uint32_t tiles_width, uint32_t tiles_height) {
+    if (first_tile_x == first_tile_x_ && first_tile_y == first_tile_y_
+        && tiles_width == tiles_width_ && tiles_height == tiles_height_) {
+        return;
+    }
+
+    uint64_t tiles_count = static_cast<uint64_t>(tiles_width) * tiles_height;
+    SandStatistics* tiles = BufferPool::GetInstance().Allocate<SandStatistics>(tiles_count);
+    std::fill(tiles, tiles + tiles_count, SandStatistics{});
+
+    // the grid never shrinks, so the old rectangle is inside the new one
+    for (uint32_t y = 0; y < tiles_height_; ++y) {
+        for (uint32_t x = 0; x < tiles_width_; ++x) {
+            uint64_t new_index = static_cast<uint64_t>(first_tile_y_ + y - first_tile_y) * tiles_width + (first_tile_x_ + x - first_tile_x);
+            tiles[new_index] = tiles_[static_cast<uint64_t>(y) * tiles_width_ + x];
+        }
+    }
+
+    BufferPool::GetInstance().Release(tiles_);
+
+    tiles_ = tiles;
+    first_tile_x_ = first_tile_x;
+    first_tile_y_ = first_tile_y;
+    tiles_width_ = tiles_width;
+    tiles_height_ = tiles_height;
+}
+
+SandStatistics& TileStatisticsCache::ResetTile(uint32_t tile_x, uint32_t tile_y) {
+    SandStatistics& tile = tiles_[static_cast<uint64_t>(tile_y - first_tile_y_) * tiles_width_ + (tile_x - first_tile_x_)];
+    tile = SandStatistics{};
+
+    return tile;
+}
+
+SandStatistics TileStatisticsCache::GetTotal(uint64_t cells_count) const {
+    SandStatistics total;
+
+    for (uint64_t i = 0; i < static_cast<uint64_t>(tiles_width_) * tiles_height_; ++i) {
+        total.Add(tiles_[i]);
+    }
+
+    total.histogram[0] = cells_count;
+
+    for (uint32_t i = 1; i < kHistogramSize; ++i) {
+        total.histogram[0] -= total.histogram[i];
+    }
+
+    return total;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "stats/SandStatistics.hpp"
+
+#include <cstdint>
+
+/**
+ * Statistics of each tile of a rectangle of tiles, for states saved by reading only the changed tiles (see DeltaWriter).
+ *
+ * Empty cells aren't counted in the tiles, since the tiles on the edge of a growing grid get new empty cells
+ * without being read again. The total of the empty cells is the area of the grid minus the other cells
+ */
+class TileStatisticsCache {
+public:
+    TileStatisticsCache() = default;
+    ~TileStatisticsCache();
+
+    TileStatisticsCache(const TileStatisticsCache& other) = delete;
+    TileStatisticsCache& operator=(const TileStatisticsCache& other) = delete;
+
+    /** Fits the cache to the rectangle of tiles, keeping the statistics of the tiles which were in the old one */
+    void Fit(uint32_t first_tile_x, uint32_t first_tile_y, uint32_t tiles_width, uint32_t tiles_height);
+
+    /** @return Statistics of the tile, which is being read again, cleared */
+    SandStatistics& ResetTile(uint32_t tile_x, uint32_t tile_y);
+
+    SandStatistics GetTotal(uint64_t cells_count) const;
+
+private:
+    SandStatistics* tiles_ = nullptr;
+
+    uint32_t first_tile_x_ = 0;
+    uint32_t first_tile_y_ = 0;
+    uint32_t tiles_width_ = 0;
+    uint32_t tiles_height_ = 0;
+};
@@ -0,0 +1,64 @@
+# Runs SANDPILE on INPUT_FILE saving every FREQUENCY-th state as images and then as deltas with every KEYFRAME_FREQUENCY-th
+# one in full, and checks that REBUILD restores every frame byte-identical to the image, both all at once and one by one
+
+file(REMOVE_RECURSE ${OUTPUT_DIRECTORY})
+file(MAKE_DIRECTORY ${OUTPUT_DIRECTORY}/images ${OUTPUT_DIRECTORY}/deltas ${OUTPUT_DIRECTORY}/all ${OUTPUT_DIRECTORY}/single)
+
+execute_process(
+    COMMAND ${SANDPILE} -i ${INPUT_FILE} -o ${OUTPUT_DIRECTORY}/images/ -e ${EXTENSION} -f ${FREQUENCY}
+    RESULT_VARIABLE exit_code
+    OUTPUT_QUIET)
+
+if(NOT exit_code EQUAL 0)
+    message(FATAL_ERROR "Sandpile exited with ${exit_code} saving images")
+endif()
+
+execute_process(
+    COMMAND ${SANDPILE} -i ${INPUT_FILE} -o ${OUTPUT_DIRECTORY}/deltas/ -e ${EXTENSION} -f ${FREQUENCY} -d ${KEYFRAME_FREQUENCY}
+    RESULT_VARIABLE exit_code
+    OUTPUT_QUIET)
+
+if(NOT exit_code EQUAL 0)
+    message(FATAL_ERROR "Sandpile exited with ${exit_code} saving deltas")
+endif()
+
+set(delta_file ${OUTPUT_DIRECTORY}/deltas/sandpile_frames.delta)
+
+execute_process(
+    COMMAND ${REBUILD} ${delta_file} ${OUTPUT_DIRECTORY}/all/
+    RESULT_VARIABLE exit_code
+    OUTPUT_QUIET)
+
+if(NOT exit_code EQUAL 0)
+    message(FATAL_ERROR "SandpileRebuild exited with ${exit_code} rebuilding all frames")
+endif()
+
+file(GLOB images RELATIVE ${OUTPUT_DIRECTORY}/images ${OUTPUT_DIRECTORY}/images/sandpile_*${EXTENSION})
+list(LENGTH images images_count)
+
+if(images_count LESS 2)
+    message(FATAL_ERROR "Only ${images_count} images are saved")
+endif()
+
+foreach(image ${images})
+    string(REGEX REPLACE "^sandpile_(.*)${EXTENSION}$" "\\1" label ${image})
+
+    execute_process(
+        COMMAND ${REBUILD} ${delta_file} ${OUTPUT_DIRECTORY}/single/ ${label}
+        RESULT_VARIABLE exit_code
+        OUTPUT_QUIET)
+
+    if(NOT exit_code EQUAL 0)
+        message(FATAL_ERROR "SandpileRebuild exited with ${exit_code} rebuilding frame ${label}")
+    endif()
+
+    foreach(rebuilt_directory all single)
+        execute_process(
+            COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT_DIRECTORY}/images/${image} ${OUTPUT_DIRECTORY}/${rebuilt_directory}/${image}
+            RESULT_VARIABLE comparison_result)
+
+        if(NOT comparison_result EQUAL 0)
+            message(FATAL_ERROR "${image} rebuilt (${rebuilt_directory}) differs from the saved one")
+        endif()
+    endforeach()
+endforeach()
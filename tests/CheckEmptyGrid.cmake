@@ -0,0 +1,36 @@
+# Runs SANDPILE on the empty grid from INPUT_FILE and checks the saved image:
+# it has to start with EXPECTED_MAGIC (hex) and, if EXPECTED_SIZE is set, to be that many bytes long
+
+file(REMOVE_RECURSE ${OUTPUT_DIRECTORY})
+file(MAKE_DIRECTORY ${OUTPUT_DIRECTORY})
+
+execute_process(
+    COMMAND ${SANDPILE} -i ${INPUT_FILE} -o ${OUTPUT_DIRECTORY}/ -e ${EXTENSION}
+    RESULT_VARIABLE exit_code)
+
+if(NOT exit_code EQUAL 0)
+    message(FATAL_ERROR "Sandpile exited with ${exit_code}")
+endif()
+
+set(image_path ${OUTPUT_DIRECTORY}/sandpile_final${EXTENSION})
+
+if(NOT EXISTS ${image_path})
+    message(FATAL_ERROR "${image_path} is not saved")
+endif()
+
+file(READ ${image_path} image HEX)
+string(LENGTH "${EXPECTED_MAGIC}" magic_length)
+string(SUBSTRING "${image}" 0 ${magic_length} magic)
+
+if(NOT magic STREQUAL EXPECTED_MAGIC)
+    message(FATAL_ERROR "${image_path} starts with ${magic} instead of ${EXPECTED_MAGIC}")
+endif()
+
+if(DEFINED EXPECTED_SIZE)
+    string(LENGTH "${image}" image_length)
+    math(EXPR image_size "${image_length} / 2")
+
+    if(NOT image_size EQUAL EXPECTED_SIZE)
+        message(FATAL_ERROR "${image_path} is ${image_size} bytes long instead of ${EXPECTED_SIZE}")
+    endif()
+endif()
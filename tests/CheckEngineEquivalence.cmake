@@ -0,0 +1,53 @@
+# Runs SANDPILE on INPUT_FILE saving every FREQUENCY-th state with ARGUMENTS and with REFERENCE_ARGUMENTS,
+# and checks that both runs save the same images byte for byte.
+# If FREQUENCY is zero, only the final state is compared, otherwise also the reported amount of iterations
+
+file(REMOVE_RECURSE ${OUTPUT_DIRECTORY})
+file(MAKE_DIRECTORY ${OUTPUT_DIRECTORY}/tested ${OUTPUT_DIRECTORY}/reference)
+
+separate_arguments(arguments UNIX_COMMAND "${ARGUMENTS}")
+separate_arguments(reference_arguments UNIX_COMMAND "${REFERENCE_ARGUMENTS}")
+
+execute_process(
+    COMMAND ${SANDPILE} -i ${INPUT_FILE} -o ${OUTPUT_DIRECTORY}/tested/ -f ${FREQUENCY} ${arguments}
+    RESULT_VARIABLE exit_code
+    OUTPUT_VARIABLE output)
+
+if(NOT exit_code EQUAL 0)
+    message(FATAL_ERROR "Sandpile exited with ${exit_code} with ${ARGUMENTS}")
+endif()
+
+execute_process(
+    COMMAND ${SANDPILE} -i ${INPUT_FILE} -o ${OUTPUT_DIRECTORY}/reference/ -f ${FREQUENCY} ${reference_arguments}
+    RESULT_VARIABLE exit_code
+    OUTPUT_VARIABLE reference_output)
+
+if(NOT exit_code EQUAL 0)
+    message(FATAL_ERROR "Sandpile exited with ${exit_code} with ${REFERENCE_ARGUMENTS}")
+endif()
+
+if(NOT FREQUENCY EQUAL 0)
+    string(REGEX MATCH "took [0-9]+ topplings" iterations "${output}")
+    string(REGEX MATCH "took [0-9]+ topplings" reference_iterations "${reference_output}")
+
+    if(NOT iterations STREQUAL reference_iterations)
+        message(FATAL_ERROR "The run ${iterations} instead of ${reference_iterations}")
+    endif()
+endif()
+
+file(GLOB images RELATIVE ${OUTPUT_DIRECTORY}/reference ${OUTPUT_DIRECTORY}/reference/*.bmp)
+file(GLOB tested_images RELATIVE ${OUTPUT_DIRECTORY}/tested ${OUTPUT_DIRECTORY}/tested/*.bmp)
+
+if(NOT images STREQUAL tested_images)
+    message(FATAL_ERROR "Saved images differ:\n${tested_images}\ninstead of\n${images}")
+endif()
+
+foreach(image ${images})
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT_DIRECTORY}/reference/${image} ${OUTPUT_DIRECTORY}/tested/${image}
+        RESULT_VARIABLE comparison_result)
+
+    if(NOT comparison_result EQUAL 0)
+        message(FATAL_ERROR "${image} differs from the reference one")
+    endif()
+endforeach()
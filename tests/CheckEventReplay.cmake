@@ -0,0 +1,72 @@
+# Runs SANDPILE on INPUT_FILE saving every FREQUENCY-th state as images and recording the event log with a checkpoint
+# every CHECKPOINT_FREQUENCY iterations, and checks that REPLAY restores every saved state byte-identical to the image.
+# The final image is compared with the state after the reported amount of iterations
+
+file(REMOVE_RECURSE ${OUTPUT_DIRECTORY})
+file(MAKE_DIRECTORY ${OUTPUT_DIRECTORY}/images ${OUTPUT_DIRECTORY}/log ${OUTPUT_DIRECTORY}/replayed)
+
+execute_process(
+    COMMAND ${SANDPILE} -i ${INPUT_FILE} -o ${OUTPUT_DIRECTORY}/images/ -e ${EXTENSION} -f ${FREQUENCY}
+    RESULT_VARIABLE exit_code
+    OUTPUT_VARIABLE output)
+
+if(NOT exit_code EQUAL 0)
+    message(FATAL_ERROR "Sandpile exited with ${exit_code} saving images")
+endif()
+
+if(NOT output MATCHES "took ([0-9]+) topplings")
+    message(FATAL_ERROR "No iterations count is reported:\n${output}")
+endif()
+
+set(final_iteration ${CMAKE_MATCH_1})
+
+execute_process(
+    COMMAND ${SANDPILE} -i ${INPUT_FILE} -o ${OUTPUT_DIRECTORY}/log/ -e ${EXTENSION} -f ${FREQUENCY} -j ${CHECKPOINT_FREQUENCY}
+    RESULT_VARIABLE exit_code
+    OUTPUT_QUIET)
+
+if(NOT exit_code EQUAL 0)
+    message(FATAL_ERROR "Sandpile exited with ${exit_code} recording the event log")
+endif()
+
+file(GLOB images RELATIVE ${OUTPUT_DIRECTORY}/images ${OUTPUT_DIRECTORY}/images/sandpile_*${EXTENSION})
+list(LENGTH images images_count)
+
+if(images_count LESS 2)
+    message(FATAL_ERROR "Only ${images_count} images are saved")
+endif()
+
+# the iterations go in the order of file names, so the replay also has to go back
+set(iterations)
+
+foreach(image ${images})
+    string(REGEX REPLACE "^sandpile_(.*)${EXTENSION}$" "\\1" iteration ${image})
+
+    if(iteration STREQUAL final)
+        set(iteration ${final_iteration})
+    endif()
+
+    list(APPEND iterations ${iteration})
+endforeach()
+
+execute_process(
+    COMMAND ${REPLAY} ${OUTPUT_DIRECTORY}/log/sandpile_events.log ${OUTPUT_DIRECTORY}/replayed/ ${iterations}
+    RESULT_VARIABLE exit_code
+    OUTPUT_QUIET)
+
+if(NOT exit_code EQUAL 0)
+    message(FATAL_ERROR "SandpileReplay exited with ${exit_code}")
+endif()
+
+foreach(image ${images})
+    list(FIND images ${image} index)
+    list(GET iterations ${index} iteration)
+
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT_DIRECTORY}/images/${image} ${OUTPUT_DIRECTORY}/replayed/sandpile_${iteration}${EXTENSION}
+        RESULT_VARIABLE comparison_result)
+
+    if(NOT comparison_result EQUAL 0)
+        message(FATAL_ERROR "${image} replayed to iteration ${iteration} differs from the saved one")
+    endif()
+endforeach()
@@ -0,0 +1,58 @@
+# Computes the identity of the sandpile group on DOMAIN (<width>x<height>) by SANDPILE from the empty EMPTY_FILE
+# and checks that it's the same as the stable configuration in IDENTITY_FILE, that adding it to itself gives it again,
+# and that --group=recurrent accepts it and rejects the empty configuration
+
+file(REMOVE_RECURSE ${OUTPUT_DIRECTORY})
+file(MAKE_DIRECTORY ${OUTPUT_DIRECTORY}/expected ${OUTPUT_DIRECTORY}/identity ${OUTPUT_DIRECTORY}/doubled)
+
+execute_process(
+    COMMAND ${SANDPILE} -i ${IDENTITY_FILE} -o ${OUTPUT_DIRECTORY}/expected/ -r ${DOMAIN}
+    RESULT_VARIABLE exit_code
+    OUTPUT_VARIABLE output)
+
+if(NOT exit_code EQUAL 0 OR NOT output MATCHES "took 0 topplings")
+    message(FATAL_ERROR "The configuration in ${IDENTITY_FILE} isn't stable:\n${output}")
+endif()
+
+execute_process(
+    COMMAND ${SANDPILE} -i ${EMPTY_FILE} -o ${OUTPUT_DIRECTORY}/identity/ -r ${DOMAIN} -y identity
+    RESULT_VARIABLE exit_code
+    OUTPUT_QUIET)
+
+if(NOT exit_code EQUAL 0)
+    message(FATAL_ERROR "Sandpile exited with ${exit_code} computing the identity")
+endif()
+
+execute_process(
+    COMMAND ${SANDPILE} -i ${IDENTITY_FILE} -o ${OUTPUT_DIRECTORY}/doubled/ -r ${DOMAIN} -y identity
+    RESULT_VARIABLE exit_code
+    OUTPUT_QUIET)
+
+if(NOT exit_code EQUAL 0)
+    message(FATAL_ERROR "Sandpile exited with ${exit_code} adding the identity to itself")
+endif()
+
+foreach(result identity doubled)
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT_DIRECTORY}/expected/sandpile_final.bmp ${OUTPUT_DIRECTORY}/${result}/sandpile_final.bmp
+        RESULT_VARIABLE comparison_result)
+
+    if(NOT comparison_result EQUAL 0)
+        message(FATAL_ERROR "${result}/sandpile_final.bmp differs from the configuration in ${IDENTITY_FILE}")
+    endif()
+endforeach()
+
+foreach(input ${IDENTITY_FILE} ${EMPTY_FILE})
+    execute_process(
+        COMMAND ${SANDPILE} -i ${input} -o ${OUTPUT_DIRECTORY}/expected/ -r ${DOMAIN} -y recurrent
+        RESULT_VARIABLE exit_code
+        OUTPUT_VARIABLE output)
+
+    if(NOT exit_code EQUAL 0)
+        message(FATAL_ERROR "Sandpile exited with ${exit_code} checking ${input}")
+    elseif(input STREQUAL IDENTITY_FILE AND NOT output MATCHES "final state is recurrent")
+        message(FATAL_ERROR "The identity isn't accepted as recurrent:\n${output}")
+    elseif(input STREQUAL EMPTY_FILE AND NOT output MATCHES "final state is not recurrent")
+        message(FATAL_ERROR "The empty configuration isn't rejected as recurrent:\n${output}")
+    endif()
+endforeach()
@@ -0,0 +1,91 @@
+# Starts SANDPILE as a job server on a socket in OUTPUT_DIRECTORY and sends it jobs with INPUT_FILE given by path,
+# with INPUT_FILE sent inline (input -), and with the checkerboard relaxation, saving every FREQUENCY-th state.
+# Checks that each job prints the same result and saves the same images as the same run without the server
+
+file(REMOVE_RECURSE ${OUTPUT_DIRECTORY})
+file(MAKE_DIRECTORY ${OUTPUT_DIRECTORY})
+
+set(socket ${OUTPUT_DIRECTORY}/jobs.sock)
+
+execute_process(
+    COMMAND sh -c "\"$0\" -l \"$1\" > \"$2\" 2>&1 & echo $!" ${SANDPILE} ${socket} ${OUTPUT_DIRECTORY}/server.log
+    OUTPUT_VARIABLE server_pid
+    OUTPUT_STRIP_TRAILING_WHITESPACE)
+
+macro(stop_server_and_fail message)
+    execute_process(COMMAND kill ${server_pid})
+    message(FATAL_ERROR "${message}")
+endmacro()
+
+foreach(attempt RANGE 50)
+    if(EXISTS ${socket})
+        break()
+    endif()
+
+    execute_process(COMMAND ${CMAKE_COMMAND} -E sleep 0.1)
+endforeach()
+
+if(NOT EXISTS ${socket})
+    stop_server_and_fail("The server didn't start listening")
+endif()
+
+foreach(job file inline checkerboard)
+    set(arguments -f ${FREQUENCY})
+    set(input ${INPUT_FILE})
+    set(served_input ${INPUT_FILE})
+    set(standard_input)
+
+    if(job STREQUAL inline)
+        set(served_input -)
+        set(standard_input INPUT_FILE ${INPUT_FILE})
+    elseif(job STREQUAL checkerboard)
+        set(arguments -c)
+    endif()
+
+    file(MAKE_DIRECTORY ${OUTPUT_DIRECTORY}/${job}/local ${OUTPUT_DIRECTORY}/${job}/served)
+
+    execute_process(
+        COMMAND ${SANDPILE} -i ${input} -o ${OUTPUT_DIRECTORY}/${job}/local/ ${arguments}
+        RESULT_VARIABLE exit_code
+        OUTPUT_VARIABLE local_output)
+
+    if(NOT exit_code EQUAL 0)
+        stop_server_and_fail("Sandpile exited with ${exit_code} running the ${job} job locally")
+    endif()
+
+    execute_process(
+        COMMAND ${SANDPILE} -n ${socket} -i ${served_input} -o ${OUTPUT_DIRECTORY}/${job}/served/ ${arguments}
+        ${standard_input}
+        RESULT_VARIABLE exit_code
+        OUTPUT_VARIABLE served_output)
+
+    if(NOT exit_code EQUAL 0)
+        stop_server_and_fail("The ${job} job exited with ${exit_code} on the server:\n${served_output}")
+    endif()
+
+    string(REGEX MATCH "Final grid size[^\n]*\nCalculation took [0-9]+ topplings" result "${local_output}")
+    string(REGEX MATCH "Final grid size[^\n]*\nCalculation took [0-9]+ topplings" served_result "${served_output}")
+
+    if(NOT result OR NOT result STREQUAL served_result)
+        stop_server_and_fail("The ${job} job printed\n${served_output}\ninstead of\n${local_output}")
+    endif()
+
+    file(GLOB images RELATIVE ${OUTPUT_DIRECTORY}/${job}/local ${OUTPUT_DIRECTORY}/${job}/local/*.bmp)
+    file(GLOB served_images RELATIVE ${OUTPUT_DIRECTORY}/${job}/served ${OUTPUT_DIRECTORY}/${job}/served/*.bmp)
+
+    if(NOT images STREQUAL served_images)
+        stop_server_and_fail("The ${job} job saved\n${served_images}\ninstead of\n${images}")
+    endif()
+
+    foreach(image ${images})
+        execute_process(
+            COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT_DIRECTORY}/${job}/local/${image} ${OUTPUT_DIRECTORY}/${job}/served/${image}
+            RESULT_VARIABLE comparison_result)
+
+        if(NOT comparison_result EQUAL 0)
+            stop_server_and_fail("${image} of the ${job} job differs from the local one")
+        endif()
+    endforeach()
+endforeach()
+
+execute_process(COMMAND kill ${server_pid})
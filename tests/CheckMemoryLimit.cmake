@@ -0,0 +1,51 @@
+# Runs SANDPILE on INPUT_FILE saving every FREQUENCY-th state with the memory limit of MEMORY_LIMIT MiB
+# and checks that the reported peak usage of buffers doesn't exceed the limit.
+# Bmp images have to be the same as the ones saved without the limit
+
+file(REMOVE_RECURSE ${OUTPUT_DIRECTORY})
+file(MAKE_DIRECTORY ${OUTPUT_DIRECTORY}/limited ${OUTPUT_DIRECTORY}/unlimited)
+
+execute_process(
+    COMMAND ${SANDPILE} -i ${INPUT_FILE} -o ${OUTPUT_DIRECTORY}/limited/ -e ${EXTENSION} -f ${FREQUENCY} -u ${MEMORY_LIMIT}
+    RESULT_VARIABLE exit_code
+    OUTPUT_VARIABLE output)
+
+if(NOT exit_code EQUAL 0)
+    message(FATAL_ERROR "Sandpile exited with ${exit_code}")
+endif()
+
+if(NOT output MATCHES "peak usage ([0-9]+) KiB \\(limit ([0-9]+) KiB")
+    message(FATAL_ERROR "No buffer usage is reported:\n${output}")
+endif()
+
+set(peak_usage ${CMAKE_MATCH_1})
+set(limit ${CMAKE_MATCH_2})
+
+if(peak_usage GREATER limit)
+    message(FATAL_ERROR "Peak usage of ${peak_usage} KiB exceeds the limit of ${limit} KiB")
+endif()
+
+if(NOT EXTENSION STREQUAL .bmp)
+    return()
+endif()
+
+execute_process(
+    COMMAND ${SANDPILE} -i ${INPUT_FILE} -o ${OUTPUT_DIRECTORY}/unlimited/ -e ${EXTENSION} -f ${FREQUENCY}
+    RESULT_VARIABLE exit_code
+    OUTPUT_QUIET)
+
+if(NOT exit_code EQUAL 0)
+    message(FATAL_ERROR "Sandpile exited with ${exit_code} without the limit")
+endif()
+
+file(GLOB images RELATIVE ${OUTPUT_DIRECTORY}/unlimited ${OUTPUT_DIRECTORY}/unlimited/*${EXTENSION})
+
+foreach(image ${images})
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT_DIRECTORY}/unlimited/${image} ${OUTPUT_DIRECTORY}/limited/${image}
+        RESULT_VARIABLE comparison_result)
+
+    if(NOT comparison_result EQUAL 0)
+        message(FATAL_ERROR "${image} differs from the one saved without the limit")
+    endif()
+endforeach()
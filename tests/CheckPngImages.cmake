@@ -0,0 +1,44 @@
+# Runs SANDPILE on INPUT_FILE saving every FREQUENCY-th state both as bmp and as png compressed with LEVEL
+# and checks with CHECKER that every png decodes by zlib to the pixels of the corresponding bmp.
+# EXTRA_ARGUMENTS are passed to both runs
+
+file(REMOVE_RECURSE ${OUTPUT_DIRECTORY})
+file(MAKE_DIRECTORY ${OUTPUT_DIRECTORY}/bmp ${OUTPUT_DIRECTORY}/png)
+
+separate_arguments(extra_arguments UNIX_COMMAND "${EXTRA_ARGUMENTS}")
+
+execute_process(
+    COMMAND ${SANDPILE} -i ${INPUT_FILE} -o ${OUTPUT_DIRECTORY}/bmp/ -e .bmp -f ${FREQUENCY} ${extra_arguments}
+    RESULT_VARIABLE exit_code
+    OUTPUT_QUIET)
+
+if(NOT exit_code EQUAL 0)
+    message(FATAL_ERROR "Sandpile exited with ${exit_code} saving bmp images")
+endif()
+
+execute_process(
+    COMMAND ${SANDPILE} -i ${INPUT_FILE} -o ${OUTPUT_DIRECTORY}/png/ -e .png -z ${LEVEL} -f ${FREQUENCY} ${extra_arguments}
+    RESULT_VARIABLE exit_code
+    OUTPUT_QUIET)
+
+if(NOT exit_code EQUAL 0)
+    message(FATAL_ERROR "Sandpile exited with ${exit_code} saving png images")
+endif()
+
+file(GLOB images RELATIVE ${OUTPUT_DIRECTORY}/bmp ${OUTPUT_DIRECTORY}/bmp/*.bmp)
+
+if(NOT images)
+    message(FATAL_ERROR "No images are saved")
+endif()
+
+foreach(image ${images})
+    string(REGEX REPLACE "\\.bmp$" ".png" png_image ${image})
+
+    execute_process(
+        COMMAND ${CHECKER} ${OUTPUT_DIRECTORY}/png/${png_image} ${OUTPUT_DIRECTORY}/bmp/${image}
+        RESULT_VARIABLE comparison_result)
+
+    if(NOT comparison_result EQUAL 0)
+        message(FATAL_ERROR "${png_image} doesn't match ${image}")
+    endif()
+endforeach()
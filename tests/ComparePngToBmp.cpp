@@ -0,0 +1,240 @@
+// Checks that a png file has the same pixels as a bmp file, both with a color table.
+// The png is decoded with zlib, so its chunk checksums and the zlib stream are verified independently of DeflateDecoder.
+// Usage: ComparePngToBmp <png path> <bmp path>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <zlib.h>
+
+struct Image {
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    // rgb colors of the pixels, row 0 is the top one
+    uint8_t* pixels = nullptr;
+};
+
+const uint8_t kPngSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+uint8_t* ReadFile(const char* path, uint64_t& size) {
+    FILE* file = std::fopen(path, "rb");
+
+    if (file == nullptr) {
+        return nullptr;
+    }
+
+    std::fseek(file, 0, SEEK_END);
+    size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+
+    uint8_t* data = new uint8_t[size];
+    bool is_read = std::fread(data, 1, size, file) == size;
+    std::fclose(file);
+
+    if (!is_read) {
+        delete[] data;
+        return nullptr;
+    }
+
+    return data;
+}
+
+uint32_t ReadBigEndian(const uint8_t* data) {
+    return (static_cast<uint32_t>(data[0]) << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+uint32_t ReadLittleEndian(const uint8_t* data, uint8_t byte_count) {
+    uint32_t result = 0;
+
+    for (uint8_t i = byte_count; i-- > 0;) {
+        result = (result << 8) | data[i];
+    }
+
+    return result;
+}
+
+uint8_t GetPackedIndex(const uint8_t* row, uint32_t x, uint8_t bit_depth) {
+    uint64_t bit_in_row = static_cast<uint64_t>(x) * bit_depth;
+    return (row[bit_in_row / 8] >> (8 - bit_depth - bit_in_row % 8)) & ((1 << bit_depth) - 1);
+}
+
+const char* DecodePng(const uint8_t* data, uint64_t size, Image& image) {
+    if (size < sizeof(kPngSignature) || std::memcmp(data, kPngSignature, sizeof(kPngSignature)) != 0) {
+        return "png signature is wrong";
+    }
+
+    uint8_t bit_depth = 0;
+    const uint8_t* palette = nullptr;
+    uint32_t palette_size = 0;
+
+    uint8_t* compressed = new uint8_t[size];
+    uint64_t compressed_size = 0;
+    bool has_end = false;
+
+    for (uint64_t position = sizeof(kPngSignature); position + 12 <= size && !has_end;) {
+        uint32_t length = ReadBigEndian(data + position);
+        const uint8_t* type = data + position + 4;
+        const uint8_t* body = type + 4;
+
+        if (position + 12 + length > size) {
+            delete[] compressed;
+            return "png chunk is truncated";
+        } else if (crc32(0, type, length + 4) != ReadBigEndian(body + length)) {
+            delete[] compressed;
+            return "png chunk checksum is wrong";
+        }
+
+        if (std::memcmp(type, "IHDR", 4) == 0) {
+            image.width = ReadBigEndian(body);
+            image.height = ReadBigEndian(body + 4);
+            bit_depth = body[8];
+
+            if (body[9] != 3 || body[12] != 0) {
+                delete[] compressed;
+                return "png is not an indexed image without interlacing";
+            }
+        } else if (std::memcmp(type, "PLTE", 4) == 0) {
+            palette = body;
+            palette_size = length / 3;
+        } else if (std::memcmp(type, "IDAT", 4) == 0) {
+            std::memcpy(compressed + compressed_size, body, length);
+            compressed_size += length;
+        } else if (std::memcmp(type, "IEND", 4) == 0) {
+            has_end = true;
+        }
+
+        position += 12 + length;
+    }
+
+    if (!has_end || palette == nullptr || bit_depth == 0) {
+        delete[] compressed;
+        return "png misses IHDR, PLTE or IEND";
+    }
+
+    uint64_t stride = (static_cast<uint64_t>(image.width) * bit_depth + 7) / 8 + 1;
+    uLongf raw_size = stride * image.height;
+    uint8_t* raw = new uint8_t[raw_size + 1];
+    uLongf decompressed_size = raw_size + 1;
+
+    // one spare byte detects data longer than the image
+    int result = uncompress(raw, &decompressed_size, compressed, compressed_size);
+    delete[] compressed;
+
+    if (result != Z_OK || decompressed_size != raw_size) {
+        delete[] raw;
+        return "png image data is not a valid zlib stream of the image size";
+    }
+
+    image.pixels = new uint8_t[static_cast<uint64_t>(image.width) * image.height * 3];
+
+    for (uint32_t y = 0; y < image.height; ++y) {
+        const uint8_t* row = raw + y * stride;
+
+        if (row[0] != 0) {
+            delete[] raw;
+            return "png row uses a filter other than None";
+        }
+
+        for (uint32_t x = 0; x < image.width; ++x) {
+            uint8_t index = GetPackedIndex(row + 1, x, bit_depth);
+
+            if (index >= palette_size) {
+                delete[] raw;
+                return "png pixel is out of the palette";
+            }
+
+            std::memcpy(image.pixels + (static_cast<uint64_t>(y) * image.width + x) * 3, palette + index * 3, 3);
+        }
+    }
+
+    delete[] raw;
+    return nullptr;
+}
+
+const char* DecodeBmp(const uint8_t* data, uint64_t size, Image& image) {
+    if (size < 54 || data[0] != 'B' || data[1] != 'M') {
+        return "bmp header is wrong";
+    }
+
+    uint32_t pixel_data_offset = ReadLittleEndian(data + 10, 4);
+    image.width = ReadLittleEndian(data + 18, 4);
+    image.height = ReadLittleEndian(data + 22, 4);
+    uint8_t bit_count = ReadLittleEndian(data + 28, 2);
+    uint32_t colors_count = ReadLittleEndian(data + 46, 4);
+
+    uint64_t row_byte_size = (static_cast<uint64_t>(image.width) * bit_count + 31) / 32 * 4;
+
+    if (pixel_data_offset + row_byte_size * image.height > size || 54 + colors_count * 4 > pixel_data_offset) {
+        return "bmp is truncated";
+    }
+
+    image.pixels = new uint8_t[static_cast<uint64_t>(image.width) * image.height * 3];
+
+    // bmp rows go from bottom to top, colors are stored as BGRA
+    for (uint32_t y = 0; y < image.height; ++y) {
+        const uint8_t* row = data + pixel_data_offset + (image.height - 1 - y) * row_byte_size;
+
+        for (uint32_t x = 0; x < image.width; ++x) {
+            uint8_t index = GetPackedIndex(row, x, bit_count);
+
+            if (index >= colors_count) {
+                return "bmp pixel is out of the color table";
+            }
+
+            const uint8_t* color = data + 54 + index * 4;
+            uint8_t* pixel = image.pixels + (static_cast<uint64_t>(y) * image.width + x) * 3;
+            pixel[0] = color[2];
+            pixel[1] = color[1];
+            pixel[2] = color[0];
+        }
+    }
+
+    return nullptr;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::fprintf(stderr, "Usage: %s <png path> <bmp path>\n", argv[0]);
+        return 2;
+    }
+
+    uint64_t png_size = 0;
+    uint64_t bmp_size = 0;
+    uint8_t* png_data = ReadFile(argv[1], png_size);
+    uint8_t* bmp_data = ReadFile(argv[2], bmp_size);
+
+    if (png_data == nullptr || bmp_data == nullptr) {
+        std::fprintf(stderr, "Unable to read the images\n");
+        return 1;
+    }
+
+    Image png_image;
+    Image bmp_image;
+    const char* error = DecodePng(png_data, png_size, png_image);
+
+    if (error == nullptr) {
+        error = DecodeBmp(bmp_data, bmp_size, bmp_image);
+    }
+
+    uint64_t pixels_byte_size = static_cast<uint64_t>(png_image.width) * png_image.height * 3;
+
+    if (error == nullptr && (png_image.width != bmp_image.width || png_image.height != bmp_image.height)) {
+        error = "images have different sizes";
+    } else if (error == nullptr && std::memcmp(png_image.pixels, bmp_image.pixels, pixels_byte_size) != 0) {
+        error = "images have different pixels";
+    }
+
+    delete[] png_data;
+    delete[] bmp_data;
+    delete[] png_image.pixels;
+    delete[] bmp_image.pixels;
+
+    if (error != nullptr) {
+        std::fprintf(stderr, "%s: %s\n", argv[1], error);
+        return 1;
+    }
+
+    return 0;
+}